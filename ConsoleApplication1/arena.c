@@ -0,0 +1,81 @@
+/**
+ * @file arena.c
+ * @brief Linear allocator for buffers that share one lifetime
+ */
+#include "arena.h"
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int arena_init(Arena* arena, size_t capacity) {
+    if (!arena) return 0;
+
+    // Over-allocate so the first piece can start on an aligned boundary
+    void* block = calloc(capacity + ARENA_ALIGN, 1);
+    if (!block) return 0;
+
+    arena->base = (unsigned char*)block;
+    arena->capacity = capacity;
+    arena->used = 0;
+    return 1;
+}
+
+void arena_release(Arena* arena) {
+    if (!arena) return;
+
+    free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
+
+void arena_reset(Arena* arena) {
+    if (!arena) return;
+
+    arena->used = 0;
+}
+
+// First aligned byte of the block
+static unsigned char* arena_start(const Arena* arena) {
+    uintptr_t base = (uintptr_t)arena->base;
+    return arena->base + (((base + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1)) - base);
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+    if (!arena || !arena->base) return NULL;
+
+    size_t aligned = arena_align(size);
+    if (aligned < size || aligned > arena->capacity - arena->used) return NULL;
+
+    void* piece = arena_start(arena) + arena->used;
+    arena->used += aligned;
+    return piece;
+}
+
+void* arena_calloc(Arena* arena, size_t count, size_t size) {
+    if (size && count > (size_t)-1 / size) return NULL;
+
+    void* piece = arena_alloc(arena, count * size);
+    if (piece) memset(piece, 0, count * size);
+    return piece;
+}
+
+char* arena_printf(Arena* arena, const char* format, ...) {
+    if (!arena || !arena->base || !format) return NULL;
+
+    // Format straight into the free space, then keep what was written
+    char* text = (char*)arena_start(arena) + arena->used;
+    size_t space = arena->capacity - arena->used;
+
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, space, format, args);
+    va_end(args);
+
+    if (length < 0 || (size_t)length >= space) return NULL;
+    arena->used += arena_align((size_t)length + 1);
+    if (arena->used > arena->capacity) arena->used = arena->capacity;
+    return text;
+}
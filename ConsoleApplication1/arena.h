@@ -0,0 +1,44 @@
+/**
+ * @file arena.h
+ * @brief Linear allocator for buffers that share one lifetime
+ *
+ * An arena takes one block from the heap up front and hands out pieces of
+ * it in order; nothing is freed on its own. Resetting the arena gives all
+ * of it back at once, so a world, a renderer or a frame allocates once and
+ * never fragments the heap however long it runs.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Every allocation starts on a cache line, which also suits SSE loads
+#define ARENA_ALIGN 64
+
+typedef struct {
+    unsigned char* base;      // Block owned by the arena (NULL before arena_init)
+    size_t capacity;          // Bytes in the block
+    size_t used;              // Bytes handed out since the last reset
+} Arena;
+
+// Round a size up to the arena alignment; arena_alloc(size) takes this much
+static inline size_t arena_align(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+// Take a zeroed block of capacity bytes from the heap (returns 0 on failure)
+int arena_init(Arena* arena, size_t capacity);
+void arena_release(Arena* arena);
+
+// Give back everything handed out; the block is kept
+void arena_reset(Arena* arena);
+
+// Next size bytes of the arena, or NULL when they do not fit. arena_calloc
+// zeroes them, since a reset arena hands out memory used before.
+void* arena_alloc(Arena* arena, size_t size);
+void* arena_calloc(Arena* arena, size_t count, size_t size);
+
+// Format a string into the arena; NULL when it does not fit
+char* arena_printf(Arena* arena, const char* format, ...);
+
+#endif /* ARENA_H */
@@ -0,0 +1,452 @@
+/**
+ * @file bench.c
+ * @brief Headless benchmark mode with scripted camera paths
+ */
+#include "bench.h"
+#include "config.h"
+#include "terminal.h"
+#include "world.h"
+#include "worldpage.h"
+#include "player.h"
+#include "renderer.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Timed stages of a frame
+enum {
+    BENCH_STAGE_PAGING,
+    BENCH_STAGE_CLEAR,
+    BENCH_STAGE_WORLD,
+    BENCH_STAGE_OVERLAY,
+    BENCH_STAGE_PRESENT,
+    BENCH_STAGE_FRAME,
+    BENCH_STAGE_COUNT
+};
+
+static const char* bench_stage_names[BENCH_STAGE_COUNT] = {
+    "paging", "clear", "render_world", "hud_minimap", "present", "frame"
+};
+
+// One camera keyframe
+typedef struct {
+    Vector3 position;
+    float pitch;
+    float yaw;
+} BenchKey;
+
+// Benchmark options
+typedef struct {
+    int frames;
+    int warmup;
+    int width;
+    int height;
+    int world_size;
+    unsigned int seed;
+    int threads;
+    int adaptive;
+    int render_options;
+    const char* path;
+    const char* path_file;
+    const char* output;
+    const char* paged;
+} BenchOptions;
+
+// Recorded camera path
+typedef struct {
+    BenchKey* keys;
+    int count;
+} BenchPath;
+
+// Parse the command line, returning 0 on bad input
+static int bench_parse_options(BenchOptions* options, int argc, char** argv) {
+    options->frames = 300;
+    options->warmup = 10;
+    options->width = SCREEN_WIDTH;
+    options->height = SCREEN_HEIGHT;
+    options->world_size = WORLD_WIDTH;
+    options->seed = 1;
+    options->threads = RENDER_THREADS;
+    options->adaptive = 0;
+    options->render_options = RENDER_DEFAULT_OPTIONS;
+    options->path = "orbit";
+    options->path_file = NULL;
+    options->output = NULL;
+    options->paged = NULL;
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            fprintf(stderr, "bench: missing value for %s\n", arg);
+            return 0;
+        }
+
+        if (strcmp(arg, "--frames") == 0) {
+            options->frames = atoi(value);
+        }
+        else if (strcmp(arg, "--warmup") == 0) {
+            options->warmup = atoi(value);
+        }
+        else if (strcmp(arg, "--size") == 0) {
+            if (sscanf(value, "%dx%d", &options->width, &options->height) != 2) {
+                fprintf(stderr, "bench: bad size '%s' (expected WxH)\n", value);
+                return 0;
+            }
+        }
+        else if (strcmp(arg, "--world") == 0) {
+            options->world_size = atoi(value);
+        }
+        else if (strcmp(arg, "--seed") == 0) {
+            options->seed = (unsigned int)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            options->threads = atoi(value);
+        }
+        else if (strcmp(arg, "--adaptive") == 0) {
+            options->adaptive = atoi(value);
+        }
+        else if (strcmp(arg, "--options") == 0) {
+            options->render_options = (int)strtol(value, NULL, 0);
+        }
+        else if (strcmp(arg, "--path") == 0) {
+            options->path = value;
+        }
+        else if (strcmp(arg, "--path-file") == 0) {
+            options->path_file = value;
+        }
+        else if (strcmp(arg, "--output") == 0) {
+            options->output = value;
+        }
+        else if (strcmp(arg, "--paged") == 0) {
+            options->paged = value;
+        }
+        else {
+            fprintf(stderr, "bench: unknown option %s\n", arg);
+            return 0;
+        }
+        i++;
+    }
+
+    if (options->frames < 1 || options->warmup < 0 ||
+        options->width < 1 || options->height < 1 || options->world_size < 1) {
+        fprintf(stderr, "bench: frames, size and world must be positive\n");
+        return 0;
+    }
+
+    if (!options->path_file &&
+        strcmp(options->path, "orbit") != 0 && strcmp(options->path, "flyover") != 0) {
+        fprintf(stderr, "bench: unknown path '%s'\n", options->path);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Load "x y z pitch yaw" keyframes, one per line ('#' starts a comment)
+static int bench_load_path(BenchPath* path, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) return 0;
+
+    int capacity = 0;
+    char line[256];
+    path->keys = NULL;
+    path->count = 0;
+
+    while (fgets(line, sizeof(line), file)) {
+        BenchKey key;
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%f %f %f %f %f", &key.position.x, &key.position.y,
+            &key.position.z, &key.pitch, &key.yaw) != 5) {
+            continue;
+        }
+
+        if (path->count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            BenchKey* keys = (BenchKey*)realloc(path->keys, capacity * sizeof(BenchKey));
+            if (!keys) {
+                fclose(file);
+                return 0;
+            }
+            path->keys = keys;
+        }
+        path->keys[path->count++] = key;
+    }
+
+    fclose(file);
+    return path->count > 0;
+}
+
+// Height of the first free cell above the terrain at a column
+static float bench_surface_height(World* world, int x, int y) {
+    x = max_int(0, min_int(world->width - 1, x));
+    y = max_int(0, min_int(world->height - 1, y));
+
+    for (int z = world->depth - 1; z >= 0; z--) {
+        if (world_is_solid(world, x, y, z)) {
+            return z + 1.0f;
+        }
+    }
+    return 0.0f;
+}
+
+// Camera for frame t in [0, 1)
+static BenchKey bench_path_key(World* world, const BenchOptions* options,
+                               const BenchPath* recorded, float t) {
+    BenchKey key;
+    float cx = world->width * 0.5f;
+    float cy = world->height * 0.5f;
+
+    // Recorded path: linear interpolation between keyframes
+    if (recorded->count > 0) {
+        float f = t * (recorded->count - 1);
+        int i = min_int((int)f, recorded->count - 1);
+        int j = min_int(i + 1, recorded->count - 1);
+        float s = f - i;
+        const BenchKey* a = &recorded->keys[i];
+        const BenchKey* b = &recorded->keys[j];
+
+        key.position = vec3_lerp(a->position, b->position, s);
+        key.pitch = lerp(a->pitch, b->pitch, s);
+        key.yaw = lerp(a->yaw, b->yaw, s);
+        return key;
+    }
+
+    if (strcmp(options->path, "flyover") == 0) {
+        // Corner to corner, just above the tallest terrain on the way
+        float margin = 2.0f;
+        float x0 = margin, y0 = margin;
+        float x1 = world->width - margin, y1 = world->height - margin;
+        key.position.x = lerp(x0, x1, t);
+        key.position.y = lerp(y0, y1, t);
+
+        float ground = 0.0f;
+        for (int i = 0; i <= 64; i++) {
+            float s = i / 64.0f;
+            ground = max_float(ground, bench_surface_height(world, (int)lerp(x0, x1, s), (int)lerp(y0, y1, s)));
+        }
+        key.position.z = min_float(ground + 3.0f, world->depth - 0.5f);
+        key.pitch = -0.35f;
+        key.yaw = atan2f(y1 - y0, x1 - x0);
+        return key;
+    }
+
+    // Orbit the world centre, looking along the tangent
+    float angle = t * 2.0f * (float)M_PI;
+    float radius = min_float(cx, cy) * 0.6f;
+    key.position.x = cx + cosf(angle) * radius;
+    key.position.y = cy + sinf(angle) * radius;
+    key.position.z = min_float(bench_surface_height(world, (int)key.position.x, (int)key.position.y) +
+        EYE_HEIGHT + 1.0f, world->depth - 0.5f);
+    key.pitch = -0.15f + 0.2f * sinf(angle * 3.0f);
+    key.yaw = angle + (float)M_PI * 0.5f;
+    return key;
+}
+
+// Fold a framebuffer into a running FNV-1a hash
+static unsigned int bench_hash_frame(unsigned int hash, const Framebuffer* fb) {
+    int size = fb->width * fb->height;
+    for (int i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)fb->char_buffer[i]) * 16777619u;
+        hash = (hash ^ (unsigned int)fb->attr_buffer[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// qsort comparator for stage samples
+static int bench_compare_samples(const void* a, const void* b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+// Print a JSON string literal, escaping quotes, backslashes and control characters
+static void bench_write_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const unsigned char* c = (const unsigned char*)text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+            fputc(*c, out);
+        }
+        else if (*c < 0x20) {
+            fprintf(out, "\\u%04x", *c);
+        }
+        else {
+            fputc(*c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+// Print min/median/p99/mean of one stage in milliseconds
+static void bench_write_stage(FILE* out, const char* name, unsigned long long* samples, int count, int last) {
+    double total = 0.0;
+    for (int i = 0; i < count; i++) {
+        total += (double)samples[i];
+    }
+
+    qsort(samples, count, sizeof(unsigned long long), bench_compare_samples);
+    int p99 = max_int(0, min_int(count - 1, (int)ceil(count * 0.99) - 1));
+    double median = (count & 1) ? (double)samples[count / 2] :
+        ((double)samples[count / 2 - 1] + (double)samples[count / 2]) * 0.5;
+
+    fprintf(out, "    \"%s\": { \"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f, \"mean_ms\": %.4f }%s\n",
+        name, samples[0] / 1000.0, median / 1000.0, samples[p99] / 1000.0,
+        total / count / 1000.0, last ? "" : ",");
+}
+
+// Run the benchmark
+int bench_run(int argc, char** argv) {
+    BenchOptions options;
+    BenchPath recorded = { NULL, 0 };
+    if (!bench_parse_options(&options, argc, argv)) return 1;
+
+    if (options.path_file && !bench_load_path(&recorded, options.path_file)) {
+        fprintf(stderr, "bench: cannot read path file %s\n", options.path_file);
+        free(recorded.keys);
+        return 1;
+    }
+
+    // Frames are assembled exactly as in the game but never written
+    terminal_set_headless(1);
+
+    unsigned long long gen_start = get_time_us();
+    World* world = options.paged ?
+        world_create_paged(options.world_size, options.world_size, WORLD_DEPTH, options.seed, options.paged, 0) :
+        world_create(options.world_size, options.world_size, WORLD_DEPTH);
+    if (!world) {
+        fprintf(stderr, "bench: failed to create world\n");
+        free(recorded.keys);
+        return 1;
+    }
+    world_init_block_types(world);
+    if (!options.paged) {
+        world_generate_terrain(world, options.seed);
+        world_generate_structures(world, options.seed + 100);
+    }
+    world_set_time(world, 0.5f);
+    unsigned long long gen_time = get_time_us() - gen_start;
+
+    Renderer* renderer = renderer_create(options.width, options.height);
+    Player* player = player_create();
+    unsigned long long* samples = (unsigned long long*)malloc(
+        (size_t)options.frames * BENCH_STAGE_COUNT * sizeof(unsigned long long));
+    if (!renderer || !player || !samples) {
+        fprintf(stderr, "bench: out of memory\n");
+        free(samples);
+        if (player) player_destroy(player);
+        if (renderer) renderer_destroy(renderer);
+        world_destroy(world);
+        free(recorded.keys);
+        return 1;
+    }
+    renderer_set_thread_count(renderer, options.threads);
+    renderer_set_adaptive_resolution(renderer, options.adaptive);
+    renderer_set_options(renderer, options.render_options);
+
+    unsigned long long present_total = 0;
+    int present_max = 0;
+    unsigned int hash = 2166136261u;
+    long long subsample_total = 0;
+    long long resident_total = 0;
+    int total_frames = options.warmup + options.frames;
+
+    for (int frame = 0; frame < total_frames; frame++) {
+        // Warmup frames walk the start of the path too, so caches see the same views
+        int measured = frame - options.warmup;
+        float t = measured >= 0 ? (float)measured / options.frames :
+            (float)frame / max_int(1, options.warmup) * (1.0f / options.frames);
+        BenchKey key = bench_path_key(world, &options, &recorded, t);
+
+        player->position = key.position;
+        player->rotation.x = key.pitch;
+        player->rotation.y = key.yaw;
+
+        // Keep the chunks around the camera resident, as the game does
+        unsigned long long tp = get_time_us();
+        world_update_paging(world, key.position.x, key.position.y, FAR_PLANE + CHUNK_SIZE);
+        unsigned long long t0 = get_time_us();
+        renderer_clear(renderer);
+        unsigned long long t1 = get_time_us();
+        renderer_render_world(renderer, world, player);
+        unsigned long long t2 = get_time_us();
+        renderer_render_hud(renderer, player, world);
+        renderer_render_debug(renderer, player);
+        renderer_render_minimap(renderer, world, player);
+        unsigned long long t3 = get_time_us();
+        renderer_present(renderer);
+        unsigned long long t4 = get_time_us();
+
+        if (measured < 0) continue;
+
+        unsigned long long* sample = samples + (size_t)BENCH_STAGE_COUNT * measured;
+        sample[BENCH_STAGE_PAGING] = t0 - tp;
+        sample[BENCH_STAGE_CLEAR] = t1 - t0;
+        sample[BENCH_STAGE_WORLD] = t2 - t1;
+        sample[BENCH_STAGE_OVERLAY] = t3 - t2;
+        sample[BENCH_STAGE_PRESENT] = t4 - t3;
+        sample[BENCH_STAGE_FRAME] = t4 - tp;
+
+        present_total += (unsigned long long)renderer->present_bytes;
+        present_max = max_int(present_max, renderer->present_bytes);
+        hash = bench_hash_frame(hash, renderer->framebuffer);
+        subsample_total += renderer->subsample_level;
+        resident_total += world_resident_pages(world);
+    }
+
+    FILE* out = options.output ? fopen(options.output, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "bench: cannot write %s\n", options.output);
+        out = stdout;
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"config\": { \"width\": %d, \"height\": %d, \"world\": [%d, %d, %d], \"seed\": %u, "
+        "\"threads\": %d, \"adaptive\": %d, \"options\": %d, \"path\": ",
+        options.width, options.height, world->width, world->height, world->depth, options.seed,
+        options.threads, options.adaptive, options.render_options);
+    bench_write_string(out, options.path_file ? options.path_file : options.path);
+    fprintf(out, ", \"paged\": ");
+    if (options.paged) {
+        bench_write_string(out, options.paged);
+    }
+    else {
+        fprintf(out, "null");
+    }
+    fprintf(out, ", \"frames\": %d, \"warmup\": %d },\n", options.frames, options.warmup);
+    fprintf(out, "  \"world_generation_ms\": %.3f,\n", gen_time / 1000.0);
+    fprintf(out, "  \"stages\": {\n");
+
+    // Stage samples are strided per frame; gather each stage before sorting
+    unsigned long long* stage = (unsigned long long*)malloc(options.frames * sizeof(unsigned long long));
+    if (stage) {
+        for (int s = 0; s < BENCH_STAGE_COUNT; s++) {
+            for (int i = 0; i < options.frames; i++) {
+                stage[i] = samples[(size_t)BENCH_STAGE_COUNT * i + s];
+            }
+            bench_write_stage(out, bench_stage_names[s], stage, options.frames, s == BENCH_STAGE_COUNT - 1);
+        }
+        free(stage);
+    }
+
+    fprintf(out, "  },\n");
+    fprintf(out, "  \"present_bytes\": { \"mean\": %.1f, \"max\": %d },\n",
+        (double)present_total / options.frames, present_max);
+    fprintf(out, "  \"subsample_level\": { \"mean\": %.2f },\n", (double)subsample_total / options.frames);
+    fprintf(out, "  \"resident_pages\": { \"mean\": %.1f },\n", (double)resident_total / options.frames);
+    fprintf(out, "  \"frame_hash\": \"%08x\"\n", hash);
+    fprintf(out, "}\n");
+
+    if (out != stdout) fclose(out);
+
+    free(samples);
+    player_destroy(player);
+    renderer_destroy(renderer);
+    world_destroy(world);
+    free(recorded.keys);
+    terminal_set_headless(0);
+    return 0;
+}
@@ -0,0 +1,26 @@
+/**
+ * @file bench.h
+ * @brief Headless benchmark mode with scripted camera paths
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+// Run the benchmark with the arguments that follow --bench and return the
+// process exit code. Options:
+//   --frames N        measured frames (default 300)
+//   --warmup N        frames rendered before measuring (default 10)
+//   --size WxH        screen size in cells (default SCREEN_WIDTH x SCREEN_HEIGHT)
+//   --world W         world width and height in blocks (default WORLD_WIDTH)
+//   --seed S          world seed (default 1)
+//   --threads N       render threads (0 = auto)
+//   --adaptive 0/1    adaptive resolution with reprojection (default 0)
+//   --options N       RENDER_OPTION_* flags, decimal or 0x hex (default RENDER_DEFAULT_OPTIONS)
+//   --path NAME       orbit | flyover (default orbit)
+//   --path-file FILE  recorded path, one "x y z pitch yaw" keyframe per line
+//   --output FILE     write the JSON report to FILE instead of stdout
+//   --paged FILE      page the world in and out of FILE instead of generating it
+//                     whole; frames draw the chunks resident, so the hash
+//                     depends on load timing
+int bench_run(int argc, char** argv);
+
+#endif /* BENCH_H */
@@ -19,6 +19,11 @@
 #define WORLD_HEIGHT 64
 #define WORLD_DEPTH 16
 #define GROUND_HEIGHT 3
+#define WORLD_GEN_THREADS 0     // World generation and load worker threads (0 = one per CPU)
+#define WORLD_PAGED 0           // Page chunks in and out of a temporary file (also --paged FILE)
+#define WORLD_PAGED_SIZE 2048   // Width and height of a new paged world
+#define WORLD_PAGE_BUDGET_MB 64 // Resident chunk memory of a paged world
+#define WORLD_PAGE_RETRY_FRAMES 32 // Frames before a failed page load is retried (doubles per failure)
 
 // View configuration
 #define FOV_HORIZONTAL 1.0f
@@ -28,13 +33,19 @@
 #define FAR_PLANE 20.0f
 #define EDGE_THRESHOLD 0.03f
 
-// Physics configuration
+// Physics configuration (speeds are per simulation step)
+#define PHYSICS_TICK_RATE 30       // Simulation steps per second
+#define PHYSICS_MAX_STEPS 5        // Steps run per frame at most; a slower frame drops time
 #define GRAVITY 0.05f
 #define JUMP_FORCE 0.4f
-#define PLAYER_SPEED 0.15f
+#define PLAYER_SPEED 0.05f
+#define PLAYER_AIR_CONTROL 0.1f    // Share of PLAYER_SPEED that steers in mid-air
+#define PLAYER_MAX_SPEED 1.0f
+#define PLAYER_REST_SPEED 0.001f   // Slower velocity components stop
 #define PLAYER_TURN_SPEED 0.05f
 #define PLAYER_HEIGHT 1.8f
 #define PLAYER_WIDTH 0.6f
+#define PLAYER_REACH 5.0f          // How far away blocks can be placed and broken
 
 // Game configuration
 #define MAX_ENTITIES 64
@@ -42,20 +53,62 @@
 #define MAX_BLOCK_TYPES 16
 #define SAVE_FILE "world.dat"
 
-// Rendering configuration
+// Rendering configuration (ENABLE_* are the default render options, which
+// can be switched while running)
 #define ENABLE_COLORS 1
 #define ENABLE_SHADING 1
 #define ENABLE_FOG 1
+#define ENABLE_EDGES 1
+#define ENABLE_WIREFRAME 0
 #define RENDER_DISTANCE 16
 #define FOG_START 10.0f
 #define FOG_END 15.0f
+#define RENDER_THREADS 0        // Render worker threads (0 = one per CPU)
+#define RENDER_BAND_ROWS 2      // Framebuffer rows per parallel render task
+#define RENDER_PRESENT_MAX_GAP 4 // Unchanged cells rewritten to avoid a cursor move
+#define RENDER_RAY_PACKETS 1     // Trace neighbouring cells as ray packets (0 = one ray at a time)
+#define RENDER_ADAPTIVE_RESOLUTION 1 // Trace fewer cells under load and reproject the rest
+#define RENDER_WORLD_BUDGET_MS 25    // World render time per frame before cells are skipped
+#define RENDER_SUBSAMPLE_MAX 2       // Most aggressive subsampling (1 = half, 2 = a quarter of cells)
+#define RENDER_DEPTH_16BIT 0         // Store depth as 16-bit fixed point instead of float
+#define RENDER_HIGHLIGHT_TARGET 1    // Mark the block under the crosshair
+#define RENDER_HIGHLIGHT_BG COLOR_MAGENTA // Background of the targeted block's cells
+#define RENDER_SCRATCH_BYTES 4096   // Per-frame scratch for HUD text
+#define RENDER_MINIMAP_SIZE 16      // Minimap cells along each side
+#define RENDER_MINIMAP_BUDGET_US 0   // Minimap resampling per frame; stale rows wait (0 = no limit)
+#define RENDER_LOD 1                 // Continue rays that pass FAR_PLANE across heightfield mips
+#define RENDER_LOD_DISTANCE 128.0f   // How far those rays reach
+#define RENDER_LOD_FOG_START 40.0f   // Fog range with the far field on (FOG_START/FOG_END without)
+#define RENDER_LOD_FOG_END 120.0f
+
+// Terminal output configuration
+#define TERMINAL_OUTPUT_BACKEND 0   // 0 = VT escape stream, 1 = console cell blit (Windows)
+#define TERMINAL_BYTES_PER_CELL 24  // Frame buffer bytes preallocated per screen cell
+#define TERMINAL_INPUT_EVENTS 128   // Key events kept per frame
+#define TERMINAL_KEY_HOLD_MS 550    // Without key-up events: a press counts as held until auto-repeat starts
+#define TERMINAL_KEY_REPEAT_MS 120  // ... and each repeat keeps it held this long
+
+// Server configuration (voxel --server)
+#define SERVER_PORT 2323            // TCP port viewers connect to with telnet
+#define SERVER_MAX_SESSIONS 32      // Connected viewers at most
+#define SERVER_DEFAULT_WIDTH 80     // Screen size until the client reports its window
+#define SERVER_DEFAULT_HEIGHT 24
+#define SERVER_MAX_WIDTH 320        // Largest window a client may report
+#define SERVER_MAX_HEIGHT 120
+#define SERVER_STALL_MS 10000       // A viewer that takes no output this long is dropped
 
 // Time configuration
 #define TARGET_FPS 30
 #define MS_PER_FRAME (1000 / TARGET_FPS)
+#define GAME_PIPELINE 0             // Simulate, render and present on separate threads (also --pipeline)
+#define GAME_COMMAND_QUEUE_SIZE 64  // World and renderer changes the pipelined loop holds between draws
+#define GAME_RENDER_ON_CHANGE 0     // Draw only frames that differ from the one on screen
+#define PACING_MAX_FPS 120          // Input never starts frames faster than this
+#define PACING_IDLE_MS 500          // Longest wait while nothing on screen changes
 
 // Debugging
 #define DEBUG_MODE 0
+#define PROFILER_TRACE_FILE "trace.json"  // Written by the trace key when DEBUG_MODE is on
 
 // Block type IDs
 #define BLOCK_AIR 0
@@ -67,6 +120,7 @@
 #define BLOCK_WATER 6
 #define BLOCK_SAND 7
 #define BLOCK_BRICK 8
+#define BLOCK_TORCH 9
 
 #define COLOR_BLACK 0
 #define COLOR_RED 1
@@ -5,9 +5,16 @@
 #include "config.h"
 #include "terminal.h"
 #include "world.h"
+#include "worldpage.h"
 #include "player.h"
+#include "physics.h"
 #include "renderer.h"
 #include "utils.h"
+#include "bench.h"
+#include "server.h"
+#include "profiler.h"
+#include "thread.h"
+#include "pacing.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,76 +27,402 @@ typedef struct {
     World* world;
     Player* player;
     Renderer* renderer;
-    unsigned long long last_frame_time;
+    unsigned long long last_frame_time; // Microseconds, like every game time stamp
     float frame_time;
     int frame_count;
     float fps;
     unsigned long long fps_time;
+    PhysicsClock physics_clock; // Fixed simulation steps owed to elapsed time
+    FramePacer pacer;
+    int input_events;           // Key events read this frame
+    int render_on_change;       // Skip frames that would look like the one on screen
+    int drawn;                  // Whether this frame is drawn
+    int drawn_paused;           // Pause state of the last drawn frame
+    unsigned long long drawn_time;
+    float world_time_owed;      // Simulated seconds the world clock has not caught up with
+    struct GamePipeline* pipeline; // Queue for world and renderer changes while the pipelined loop runs
+    int paged;                  // Page chunks around the player in and out of a backing file
+    const char* world_file;     // Backing file of a paged world (NULL = temporary file)
 } GameState;
 
+// Changes input makes to the world or the renderer. The serial loop applies
+// them at once; the pipelined loop queues them for the render thread, which
+// applies them between draws.
+typedef enum {
+    GAME_COMMAND_PLACE_BLOCK,   // Place block type arg at the target
+    GAME_COMMAND_BREAK_BLOCK,   // Break the targeted block
+    GAME_COMMAND_TOGGLE_HUD,
+    GAME_COMMAND_TOGGLE_DEBUG,
+    GAME_COMMAND_TOGGLE_MINIMAP,
+    GAME_COMMAND_CYCLE_MINIMAP_ZOOM,
+    GAME_COMMAND_TOGGLE_OPTION, // Toggle render option arg
+    GAME_COMMAND_TOGGLE_WIREFRAME
+} GameCommandType;
+
+typedef struct {
+    GameCommandType type;
+    int arg;
+} GameCommand;
+
+// State shared by the simulation (main), render and present threads
+typedef struct GamePipeline {
+    GameState* game;
+    Mutex lock;               // Held by a simulation step, and by the render thread applying queued changes
+    CondVar stepped;          // Signalled after every simulation step
+    unsigned int steps;       // Simulation steps so far
+    GameCommand commands[GAME_COMMAND_QUEUE_SIZE]; // Changes waiting for the render thread
+    int command_count;
+    int input_events;         // Key events since the render thread last took them
+    int settled;              // Whether the render thread skipped its last frame as unchanged
+    int present_bytes;        // Size of the last presented frame, for the debug overlay
+    int present_cells;
+    Player view;              // Player as of the frame being drawn (render thread only)
+    uint8_t view_inventory[MAX_BLOCK_TYPES];
+    Renderer* presenter;      // Terminal state for the present thread
+    FrameQueue* queue;        // Drawn frames waiting for the present thread
+} GamePipeline;
+
 // Function prototypes
 void game_init(GameState* game);
 void game_cleanup(GameState* game);
 void game_update(GameState* game);
+void game_update_world(GameState* game);
 void game_render(GameState* game);
+void game_draw(GameState* game, Player* player, int paused);
 void game_process_input(GameState* game);
+void game_run(GameState* game);
+void game_run_pipelined(GameState* game);
 void handle_resize(GameState* game);
 void show_title_screen(GameState* game);
 void show_pause_menu(GameState* game);
 
 // Entry point
-int main(void) {
-    // Seed random number generator
-    srand((unsigned int)time(NULL));
+int main(int argc, char** argv) {
+    // Headless benchmark: voxel --bench [options]
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        return bench_run(argc - 2, argv + 2);
+    }
+
+    // Telnet server for many viewers: voxel --server [options]
+    if (argc > 1 && strcmp(argv[1], "--server") == 0) {
+        return server_run(argc - 2, argv + 2);
+    }
 
     // Create game state
     GameState game = { 0 };
     game.running = 1;
     game.paused = 0;
+    game.paged = WORLD_PAGED;
+
+    // --pipeline runs simulation, rendering and output on their own threads;
+    // --paged FILE keeps only the chunks around the player in memory
+    int pipelined = GAME_PIPELINE;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pipeline") == 0) {
+            pipelined = 1;
+        }
+        else if (strcmp(argv[i], "--paged") == 0 && i + 1 < argc) {
+            game.paged = 1;
+            game.world_file = argv[++i];
+        }
+    }
+
+    // Seed random number generator
+    srand((unsigned int)time(NULL));
 
     // Initialize game
+    PROFILE_INIT();
     game_init(&game);
 
     // Show title screen
     show_title_screen(&game);
 
     // Main game loop
-    while (game.running) {
-        // Calculate frame time
-        unsigned long long current_time = get_time_ms();
-        game.frame_time = (current_time - game.last_frame_time) / 1000.0f;
-        game.last_frame_time = current_time;
-
-        // Update FPS counter every second
-        game.frame_count++;
-        if (current_time - game.fps_time >= 1000) {
-            game.fps = game.frame_count * 1000.0f / (current_time - game.fps_time);
-            game.frame_count = 0;
-            game.fps_time = current_time;
-        }
+    if (pipelined) {
+        game_run_pipelined(&game);
+    }
+    else {
+        game_run(&game);
+    }
 
-        // Process input
-        game_process_input(&game);
+    // Cleanup
+    game_cleanup(&game);
 
-        // Update game state if not paused
-        if (!game.paused) {
-            game_update(&game);
-        }
+    return 0;
+}
+
+// Time the frame, read input and advance the simulation; returns when the
+// frame started
+static unsigned long long game_step(GameState* game) {
+    // Calculate frame time
+    unsigned long long current_time = pacer_begin_frame(&game->pacer);
+    game->frame_time = (current_time - game->last_frame_time) / 1000000.0f;
+    game->last_frame_time = current_time;
+
+    // Process input
+    game_process_input(game);
+
+    // Update game state if not paused
+    if (!game->paused) {
+        PROFILE_BEGIN(PROFILE_UPDATE);
+        game_update(game);
+        PROFILE_END(PROFILE_UPDATE);
+    }
+
+    return current_time;
+}
+
+// Count a drawn frame and update the FPS shown every second
+static void game_count_frame(GameState* game, unsigned long long current_time) {
+    game->frame_count++;
+    if (current_time - game->fps_time >= 1000000) {
+        game->fps = game->frame_count * 1000000.0f / (current_time - game->fps_time);
+        game->frame_count = 0;
+        game->fps_time = current_time;
+    }
+}
+
+// Decide whether a frame of the player's view is drawn. With
+// render_on_change only frames that would differ from the one on screen
+// are: after input, while the camera, blocks or light change, and every
+// PACING_IDLE_MS for the clock in the HUD.
+static int game_want_frame(GameState* game, Player* player, int paused, int input_events,
+                           unsigned long long current_time) {
+    int drawn = !game->render_on_change || input_events > 0 ||
+        paused != game->drawn_paused ||
+        current_time - game->drawn_time >= PACING_IDLE_MS * 1000ULL ||
+        (!paused && !renderer_world_current(game->renderer, game->world, player));
+
+    if (drawn) {
+        game->drawn_paused = paused;
+        game->drawn_time = current_time;
+    }
+    return drawn;
+}
+
+// Apply a change to the world or the renderer
+static void game_apply_command(GameState* game, const GameCommand* command) {
+    switch (command->type) {
+    case GAME_COMMAND_PLACE_BLOCK:
+        player_place_block(game->player, game->world, (uint8_t)command->arg);
+        break;
+    case GAME_COMMAND_BREAK_BLOCK:
+        player_break_block(game->player, game->world);
+        break;
+    case GAME_COMMAND_TOGGLE_HUD:
+        renderer_toggle_hud(game->renderer);
+        break;
+    case GAME_COMMAND_TOGGLE_DEBUG:
+        renderer_toggle_debug(game->renderer);
+        break;
+    case GAME_COMMAND_TOGGLE_MINIMAP:
+        renderer_toggle_minimap(game->renderer);
+        break;
+    case GAME_COMMAND_CYCLE_MINIMAP_ZOOM:
+        renderer_cycle_minimap_zoom(game->renderer);
+        break;
+    case GAME_COMMAND_TOGGLE_OPTION:
+        renderer_toggle_option(game->renderer, command->arg);
+        break;
+    case GAME_COMMAND_TOGGLE_WIREFRAME:
+        renderer_toggle_wireframe(game->renderer);
+        break;
+    }
+}
+
+// Apply a change now, or queue it for the render thread while the
+// pipelined loop runs (the caller holds the pipeline lock). A full queue
+// drops the change, as if the key were never pressed.
+static void game_command(GameState* game, GameCommandType type, int arg) {
+    GameCommand command = { type, arg };
+    GamePipeline* pipeline = game->pipeline;
+
+    if (!pipeline) {
+        game_apply_command(game, &command);
+    }
+    else if (pipeline->command_count < GAME_COMMAND_QUEUE_SIZE) {
+        pipeline->commands[pipeline->command_count++] = command;
+    }
+}
+
+// Wait for the next frame: the next deadline, or while nothing changes the
+// next input or idle timeout
+static void game_wait_frame(GameState* game) {
+    pacer_wait(&game->pacer, game->render_on_change && !game->drawn);
+}
+
+// Run input, simulation, rendering and output one after another
+void game_run(GameState* game) {
+    while (game->running) {
+        PROFILE_BEGIN(PROFILE_FRAME);
+        unsigned long long current_time = game_step(game);
+
+        // Follow the terminal size
+        handle_resize(game);
 
         // Render
-        game_render(&game);
+        game->drawn = game_want_frame(game, game->player, game->paused, game->input_events, current_time);
+        if (game->drawn) {
+            game_count_frame(game, current_time);
+            game_render(game);
+        }
+        PROFILE_END(PROFILE_FRAME);
+        PROFILE_END_FRAME();
 
         // Cap frame rate
-        unsigned long long frame_time = get_time_ms() - current_time;
-        if (frame_time < MS_PER_FRAME) {
-            terminal_sleep(MS_PER_FRAME - frame_time);
+        game_wait_frame(game);
+    }
+}
+
+// Render thread: between draws, apply the changes the simulation queued
+// and copy the player; then draw that copy while the simulation goes on
+static void game_render_thread(void* arg) {
+    GamePipeline* pipeline = (GamePipeline*)arg;
+    GameState* game = pipeline->game;
+    Player* view = &pipeline->view;
+    unsigned int seen = 0;
+
+    mutex_lock(&pipeline->lock);
+    for (;;) {
+        while (game->running && pipeline->steps == seen) {
+            condvar_wait(&pipeline->stepped, &pipeline->lock);
         }
+        if (!game->running) break;
+        seen = pipeline->steps;
+
+        // Only this thread writes the world, and only here, so a draw never
+        // sees it change and a simulation step never waits for a draw
+        for (int i = 0; i < pipeline->command_count; i++) {
+            game_apply_command(game, &pipeline->commands[i]);
+        }
+        pipeline->command_count = 0;
+        game_update_world(game);
+
+        *view = *game->player;
+        memcpy(pipeline->view_inventory, game->player->inventory, MAX_BLOCK_TYPES);
+        view->inventory = pipeline->view_inventory;
+        int paused = game->paused;
+        int input_events = pipeline->input_events;
+        pipeline->input_events = 0;
+        game->renderer->present_bytes = pipeline->present_bytes;
+        game->renderer->present_cells = pipeline->present_cells;
+        mutex_unlock(&pipeline->lock);
+
+        // The renderer belongs to this thread; follow the terminal size
+        handle_resize(game);
+
+        // Edits applied above make the copied target stale
+        player_update_target(view, game->world);
+        unsigned long long current_time = get_time_us();
+        int drawn = game_want_frame(game, view, paused, input_events, current_time);
+        if (drawn) {
+            game_count_frame(game, current_time);
+            game_draw(game, view, paused);
+            frame_queue_publish(pipeline->queue, game->renderer->framebuffer);
+        }
+
+        mutex_lock(&pipeline->lock);
+        pipeline->settled = !drawn;
     }
+    mutex_unlock(&pipeline->lock);
+}
 
-    // Cleanup
-    game_cleanup(&game);
+// Present thread: write the newest drawn frame to the terminal
+static void game_present_thread(void* arg) {
+    GamePipeline* pipeline = (GamePipeline*)arg;
+    Renderer* presenter = pipeline->presenter;
+    const Framebuffer* frame;
+
+    while ((frame = frame_queue_acquire(pipeline->queue)) != NULL) {
+        // After a resize, frames of the new size are written out in full
+        if ((frame->width != presenter->width || frame->height != presenter->height) &&
+            !renderer_resize(presenter, frame->width, frame->height)) {
+            continue;
+        }
 
-    return 0;
+        PROFILE_BEGIN(PROFILE_PRESENT);
+        renderer_present_frame(presenter, frame);
+        PROFILE_END(PROFILE_PRESENT);
+
+        mutex_lock(&pipeline->lock);
+        pipeline->present_bytes = presenter->present_bytes;
+        pipeline->present_cells = presenter->present_cells;
+        mutex_unlock(&pipeline->lock);
+    }
+}
+
+// Run input and simulation on this thread, drawing and terminal output on
+// two others. Edits and other writes to the world wait in a queue the
+// render thread applies between draws, so a step never waits for a draw,
+// and a slow terminal delays neither; frames nobody can keep up with are
+// skipped. A paged world only attaches and evicts chunks in
+// game_update_world; simulation reads of chunks that are not resident yet
+// queue them and see a wall, so a draw never sees chunks come or go.
+void game_run_pipelined(GameState* game) {
+    GamePipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.game = game;
+    pipeline.queue = frame_queue_create(game->renderer->width, game->renderer->height);
+    pipeline.presenter = renderer_create_shared(game->renderer->width, game->renderer->height, NULL);
+    if (!pipeline.queue || !pipeline.presenter) {
+        frame_queue_destroy(pipeline.queue);
+        renderer_destroy(pipeline.presenter);
+        game_run(game);
+        return;
+    }
+    mutex_init(&pipeline.lock);
+    condvar_init(&pipeline.stepped);
+
+    // Input from now on goes through the queue
+    game->pipeline = &pipeline;
+    world_set_paging_deferred(game->world, 1);
+
+    Thread render_thread, present_thread;
+    int have_present = thread_create(&present_thread, game_present_thread, &pipeline);
+    int have_render = have_present && thread_create(&render_thread, game_render_thread, &pipeline);
+
+    if (have_render) {
+        while (game->running) {
+            PROFILE_BEGIN(PROFILE_FRAME);
+
+            // Waits at most for the render thread applying queued changes
+            mutex_lock(&pipeline.lock);
+            game_step(game);
+            pipeline.input_events += game->input_events;
+            pipeline.steps++;
+            condvar_signal(&pipeline.stepped);
+            game->drawn = !pipeline.settled;
+            mutex_unlock(&pipeline.lock);
+
+            PROFILE_END(PROFILE_FRAME);
+            PROFILE_END_FRAME();
+            game_wait_frame(game);
+        }
+
+        // Wake the render thread to see running cleared
+        mutex_lock(&pipeline.lock);
+        condvar_broadcast(&pipeline.stepped);
+        mutex_unlock(&pipeline.lock);
+        thread_join(render_thread);
+    }
+
+    frame_queue_close(pipeline.queue);
+    if (have_present) thread_join(present_thread);
+
+    // Changes queued after the last draw
+    world_set_paging_deferred(game->world, 0);
+    for (int i = 0; i < pipeline.command_count; i++) {
+        game_apply_command(game, &pipeline.commands[i]);
+    }
+    game->pipeline = NULL;
+
+    condvar_destroy(&pipeline.stepped);
+    mutex_destroy(&pipeline.lock);
+    renderer_destroy(pipeline.presenter);
+    frame_queue_destroy(pipeline.queue);
+
+    // Could not start the threads: fall back to one
+    if (!have_render) game_run(game);
 }
 
 // Initialize game
@@ -114,8 +447,15 @@ void game_init(GameState* game) {
         exit(1);
     }
 
-    // Create world
-    game->world = world_create(WORLD_WIDTH, WORLD_HEIGHT, WORLD_DEPTH);
+    // Create world; a paged one generates chunks as the player nears them
+    unsigned int seed = (unsigned int)time(NULL);
+    if (game->paged) {
+        game->world = world_create_paged(WORLD_PAGED_SIZE, WORLD_PAGED_SIZE, WORLD_DEPTH, seed,
+                                         game->world_file, 0);
+    }
+    else {
+        game->world = world_create(WORLD_WIDTH, WORLD_HEIGHT, WORLD_DEPTH);
+    }
     if (!game->world) {
         fprintf(stderr, "Failed to create world\n");
         renderer_destroy(game->renderer);
@@ -127,8 +467,10 @@ void game_init(GameState* game) {
     world_init_block_types(game->world);
 
     // Generate world
-    world_generate_terrain(game->world, (unsigned int)time(NULL));
-    world_generate_structures(game->world, (unsigned int)time(NULL) + 100);
+    if (!game->paged) {
+        world_generate_terrain(game->world, seed);
+        world_generate_structures(game->world, seed + 100);
+    }
 
     // Create player
     game->player = player_create();
@@ -140,30 +482,33 @@ void game_init(GameState* game) {
         exit(1);
     }
 
-    // Initialize player position
-    game->player->position.x = WORLD_WIDTH / 2.0f;
-    game->player->position.y = WORLD_HEIGHT / 2.0f;
+    // Initialize player position, centred on a column so the box fits in it
+    int x = game->world->width / 2;
+    int y = game->world->height / 2;
+    player_set_position(game->player, vec3_create(x + 0.5f, y + 0.5f, game->player->position.z));
 
     // Find a safe position on the ground
-    for (int z = WORLD_DEPTH - 1; z >= 0; z--) {
-        int x = (int)game->player->position.x;
-        int y = (int)game->player->position.y;
+    for (int z = game->world->depth - 1; z >= 0; z--) {
 
-        if (z < WORLD_DEPTH - 1 &&
+        if (z < game->world->depth - 1 &&
             world_is_solid(game->world, x, y, z) &&
             !world_is_solid(game->world, x, y, z + 1) &&
             !world_is_solid(game->world, x, y, z + 2)) {
 
-            game->player->position.z = z + 1.0f + EYE_HEIGHT;
+            player_set_position(game->player, vec3_create(x + 0.5f, y + 0.5f, z + 1.0f + game->player->height));
             break;
         }
     }
 
     // Initialize timing
-    game->last_frame_time = get_time_ms();
+    pacer_init(&game->pacer, TARGET_FPS);
+    game->last_frame_time = get_time_us();
     game->fps_time = game->last_frame_time;
     game->frame_count = 0;
     game->fps = 0.0f;
+    physics_clock_init(&game->physics_clock);
+    game->render_on_change = GAME_RENDER_ON_CHANGE;
+    game->drawn_time = game->last_frame_time;
 
     // Set world time
     world_set_time(game->world, 0.5f); // Start at noon
@@ -182,53 +527,88 @@ void game_cleanup(GameState* game) {
     terminal_cleanup();
 }
 
+// Advance the world clock and lighting by the time owed, and keep the
+// chunks around the player resident (paged worlds only)
+void game_update_world(GameState* game) {
+    float time_speed = 0.001f;
+    world_set_time(game->world, game->world->time_of_day + time_speed * game->world_time_owed);
+    game->world_time_owed = 0.0f;
+
+    // Update lighting
+    world_update_lighting(game->world);
+
+    world_update_paging(game->world, game->player->position.x, game->player->position.y,
+                        FAR_PLANE + CHUNK_SIZE);
+}
+
 // Update game state
 void game_update(GameState* game) {
     if (!game) return;
 
-    // Update world time
-    float time_speed = 0.001f;
-    world_set_time(game->world, game->world->time_of_day + time_speed * game->frame_time);
+    // The world clock catches up in game_update_world
+    game->world_time_owed += game->frame_time;
 
-    // Update lighting
-    world_update_lighting(game->world);
+    // Step the player at a fixed rate whatever the frame rate, and place
+    // the camera between the last two steps
+    int steps = physics_clock_advance(&game->physics_clock, game->frame_time);
+    for (int i = 0; i < steps; i++) {
+        player_update(game->player, game->world);
+    }
+    player_set_interpolation(game->player, game->physics_clock.alpha);
+
+    // The pipelined loop's render thread does this between draws
+    if (!game->pipeline) game_update_world(game);
 
-    // Update player
-    player_update(game->player, game->world, game->frame_time);
+    // Trace the targeted block once for interaction, the HUD and the highlight
+    player_update_target(game->player, game->world);
 }
 
 // Render game
 void game_render(GameState* game) {
     if (!game) return;
 
+    game_draw(game, game->player, game->paused);
+
+    // Present frame
+    PROFILE_BEGIN(PROFILE_PRESENT);
+    renderer_present(game->renderer);
+    PROFILE_END(PROFILE_PRESENT);
+}
+
+// Draw a frame of the player's view into the renderer's framebuffer
+void game_draw(GameState* game, Player* player, int paused) {
+    if (!game || !player) return;
+
     // Clear renderer
+    PROFILE_BEGIN(PROFILE_CLEAR);
     renderer_clear(game->renderer);
+    PROFILE_END(PROFILE_CLEAR);
 
-    if (game->paused) {
+    if (paused) {
         // Show pause menu
         show_pause_menu(game);
     }
     else {
         // Render world
-        renderer_render_world(game->renderer, game->world, game->player);
+        PROFILE_BEGIN(PROFILE_WORLD);
+        renderer_render_world(game->renderer, game->world, player);
+        PROFILE_END(PROFILE_WORLD);
 
         // Render HUD
-        renderer_render_hud(game->renderer, game->player, game->world);
+        PROFILE_BEGIN(PROFILE_OVERLAY);
+        renderer_render_hud(game->renderer, player, game->world);
 
         // Render debug info if enabled
-        renderer_render_debug(game->renderer, game->player);
+        renderer_render_debug(game->renderer, player);
 
         // Render minimap
-        renderer_render_minimap(game->renderer, game->world, game->player);
+        renderer_render_minimap(game->renderer, game->world, player);
 
         // Show FPS
-        char fps_text[32];
-        sprintf(fps_text, "FPS: %.1f", game->fps);
-        renderer_draw_text(game->renderer, game->renderer->width - 12, 2, fps_text, COLOR_WHITE, COLOR_BLACK);
+        renderer_draw_text(game->renderer, game->renderer->width - 12, 2,
+            arena_printf(&game->renderer->scratch, "FPS: %.1f", game->fps), COLOR_WHITE, COLOR_BLACK);
+        PROFILE_END(PROFILE_OVERLAY);
     }
-
-    // Present frame
-    renderer_present(game->renderer);
 }
 
 // Process input
@@ -236,7 +616,9 @@ void game_process_input(GameState* game) {
     if (!game) return;
 
     // Process input
-    terminal_process_input();
+    PROFILE_BEGIN(PROFILE_INPUT);
+    game->input_events = terminal_process_input();
+    PROFILE_END(PROFILE_INPUT);
 
     // Check for quit
     if (terminal_key_pressed('q')) {
@@ -268,7 +650,7 @@ void game_process_input(GameState* game) {
         if (terminal_key_held('l')) right += 1.0f;
         if (terminal_key_held('j')) right -= 1.0f;
 
-        player_move(game->player, game->world, forward, right, game->frame_time);
+        player_move(game->player, game->world, forward, right);
 
         // Player looking
         float turn_speed = PLAYER_TURN_SPEED;
@@ -283,8 +665,8 @@ void game_process_input(GameState* game) {
         if (terminal_key_pressed('f')) game->player->flying = !game->player->flying;
 
         // Block interaction
-        if (terminal_key_pressed('e')) player_place_block(game->player, game->world, game->player->selected_slot);
-        if (terminal_key_pressed('r')) player_break_block(game->player, game->world);
+        if (terminal_key_pressed('e')) game_command(game, GAME_COMMAND_PLACE_BLOCK, game->player->selected_slot);
+        if (terminal_key_pressed('r')) game_command(game, GAME_COMMAND_BREAK_BLOCK, 0);
 
         // Select inventory slot with number keys
         for (int i = 1; i <= 9; i++) {
@@ -295,13 +677,28 @@ void game_process_input(GameState* game) {
         }
 
         // Toggle HUD
-        if (terminal_key_pressed('h')) renderer_toggle_hud(game->renderer);
+        if (terminal_key_pressed('h')) game_command(game, GAME_COMMAND_TOGGLE_HUD, 0);
 
         // Toggle debug info
-        if (terminal_key_pressed('o')) renderer_toggle_debug(game->renderer);
+        if (terminal_key_pressed('o')) game_command(game, GAME_COMMAND_TOGGLE_DEBUG, 0);
+
+#if DEBUG_MODE
+        // Dump the recorded frames as a Chrome trace
+        if (terminal_key_pressed('t')) profiler_dump_trace(PROFILER_TRACE_FILE);
+#endif
 
         // Toggle minimap
-        if (terminal_key_pressed('m')) renderer_toggle_minimap(game->renderer);
+        if (terminal_key_pressed('m')) game_command(game, GAME_COMMAND_TOGGLE_MINIMAP, 0);
+
+        // Zoom the minimap out (wraps back in)
+        if (terminal_key_pressed('n')) game_command(game, GAME_COMMAND_CYCLE_MINIMAP_ZOOM, 0);
+
+        // Render options: fog, shading, colors, outlines, wireframe
+        if (terminal_key_pressed('g')) game_command(game, GAME_COMMAND_TOGGLE_OPTION, RENDER_OPTION_FOG);
+        if (terminal_key_pressed('b')) game_command(game, GAME_COMMAND_TOGGLE_OPTION, RENDER_OPTION_SHADING);
+        if (terminal_key_pressed('c')) game_command(game, GAME_COMMAND_TOGGLE_OPTION, RENDER_OPTION_COLORS);
+        if (terminal_key_pressed('x')) game_command(game, GAME_COMMAND_TOGGLE_OPTION, RENDER_OPTION_EDGES);
+        if (terminal_key_pressed('v')) game_command(game, GAME_COMMAND_TOGGLE_WIREFRAME, 0);
     }
 }
 
@@ -313,16 +710,17 @@ void handle_resize(GameState* game) {
     int width, height;
     terminal_get_size(&width, &height);
 
-    // Recreate renderer
-    renderer_destroy(game->renderer);
-    game->renderer = renderer_create(width, height);
+    // Resize the renderer in place; it keeps its options and workers
+    if (width == game->renderer->width && height == game->renderer->height) return;
+    renderer_resize(game->renderer, width, height);
 }
 
 // Show title screen
 void show_title_screen(GameState* game) {
     if (!game) return;
 
-    // Clear screen
+    // Assemble the whole screen before writing it
+    terminal_begin_frame();
     terminal_clear();
 
     // Get screen dimensions
@@ -355,6 +753,7 @@ void show_title_screen(GameState* game) {
         "E - Place block",
         "R - Break block",
         "1-9 - Select block type",
+        "G/B/C/X/V - Fog, shading, colors, outlines, wireframe",
         "P - Pause game",
         "Q - Quit",
         "",
@@ -373,19 +772,22 @@ void show_title_screen(GameState* game) {
     }
 
     // Present screen
-    terminal_flush();
+    terminal_end_frame();
 
     // Wait for keypress
     while (1) {
         terminal_process_input();
 
-        for (int i = 0; i < 256; i++) {
-            if (terminal_key_pressed(i)) {
+        TerminalKeyEvent event;
+        while (terminal_poll_event(&event)) {
+            if (event.down) {
+                // The title text is still on screen; redraw everything
+                renderer_invalidate(game->renderer);
                 return;
             }
         }
 
-        terminal_sleep(50);
+        terminal_wait_input(PACING_IDLE_MS * 1000LL);
     }
 }
 
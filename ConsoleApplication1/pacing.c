@@ -0,0 +1,60 @@
+/**
+ * @file pacing.c
+ * @brief Frame pacing: microsecond deadlines and waits that end early on input
+ */
+#include "pacing.h"
+#include "terminal.h"
+#include "utils.h"
+
+void pacer_init(FramePacer* pacer, int fps) {
+    if (!pacer) return;
+
+    if (fps < 1) fps = 1;
+    pacer->period_us = 1000000ULL / (unsigned long long)fps;
+    pacer->min_period_us = 1000000ULL / (unsigned long long)max_int(PACING_MAX_FPS, fps);
+    pacer->frame_start_us = get_time_us();
+    pacer->deadline_us = pacer->frame_start_us + pacer->period_us;
+    pacer->woken_by_input = 0;
+}
+
+unsigned long long pacer_begin_frame(FramePacer* pacer) {
+    unsigned long long now = get_time_us();
+    if (!pacer) return now;
+
+    // On time: keep to the grid. Early (input) or too late to catch up:
+    // start a new grid from this frame
+    if (now >= pacer->deadline_us && now < pacer->deadline_us + pacer->period_us) {
+        pacer->deadline_us += pacer->period_us;
+    }
+    else {
+        pacer->deadline_us = now + pacer->period_us;
+    }
+
+    pacer->frame_start_us = now;
+    return now;
+}
+
+int pacer_wait(FramePacer* pacer, int idle) {
+    if (!pacer) return 0;
+
+    unsigned long long deadline = idle ? pacer->frame_start_us + PACING_IDLE_MS * 1000ULL : pacer->deadline_us;
+    unsigned long long earliest = pacer->frame_start_us + pacer->min_period_us;
+    unsigned long long now = get_time_us();
+    pacer->woken_by_input = 0;
+
+    // Input may start a frame early, but not sooner than PACING_MAX_FPS allows
+    if (now < earliest && earliest < deadline) {
+        terminal_sleep_us((long long)(earliest - now));
+        now = get_time_us();
+    }
+
+    while (now < deadline) {
+        if (terminal_wait_input((long long)(deadline - now))) {
+            pacer->woken_by_input = 1;
+            return 1;
+        }
+        now = get_time_us();
+    }
+
+    return 0;
+}
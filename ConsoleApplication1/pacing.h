@@ -0,0 +1,33 @@
+/**
+ * @file pacing.h
+ * @brief Frame pacing: microsecond deadlines and waits that end early on input
+ *
+ * Frames start on a fixed grid of deadlines PACING period apart. Waiting
+ * for the next deadline returns as soon as a key arrives, so input is
+ * handled without waiting out the rest of the frame; the grid then restarts
+ * from that frame. An idle wait (nothing on screen is changing) only ends
+ * on input or after PACING_IDLE_MS.
+ */
+#ifndef PACING_H
+#define PACING_H
+
+#include "config.h"
+
+typedef struct {
+    unsigned long long period_us;      // Time between frames at the target rate
+    unsigned long long min_period_us;  // Shortest time between frames started by input
+    unsigned long long frame_start_us; // When the current frame started
+    unsigned long long deadline_us;    // When the next frame is due
+    int woken_by_input;                // Whether the last wait ended on input
+} FramePacer;
+
+void pacer_init(FramePacer* pacer, int fps);
+
+// Mark the start of a frame and return the time (get_time_us)
+unsigned long long pacer_begin_frame(FramePacer* pacer);
+
+// Wait until the next frame is due or input arrives; idle waits up to
+// PACING_IDLE_MS instead of one period. Returns 1 when woken by input.
+int pacer_wait(FramePacer* pacer, int idle);
+
+#endif /* PACING_H */
@@ -0,0 +1,179 @@
+/**
+ * @file physics.c
+ * @brief Fixed-timestep simulation and swept box collision against the voxel grid
+ */
+#include "physics.h"
+#include "worldpage.h"
+#include "utils.h"
+#include <math.h>
+
+// Gap kept between a box and the blocks it rests against, so resting
+// contact never reads as overlap
+#define PHYSICS_SKIN 0.001f
+
+void physics_clock_init(PhysicsClock* clock) {
+    if (!clock) return;
+
+    clock->accumulator = 0.0f;
+    clock->alpha = 1.0f;
+}
+
+int physics_clock_advance(PhysicsClock* clock, float seconds) {
+    if (!clock) return 0;
+
+    if (seconds > 0.0f) clock->accumulator += seconds;
+
+    int steps = 0;
+    while (clock->accumulator >= PHYSICS_STEP && steps < PHYSICS_MAX_STEPS) {
+        clock->accumulator -= PHYSICS_STEP;
+        steps++;
+    }
+
+    // After a stall, resume from now instead of fast-forwarding
+    if (clock->accumulator >= PHYSICS_STEP) {
+        clock->accumulator = fmodf(clock->accumulator, PHYSICS_STEP);
+    }
+
+    clock->alpha = clock->accumulator / PHYSICS_STEP;
+    return steps;
+}
+
+// Whether a block stops boxes; the world's sides and floor are walls
+static int physics_block_solid(World* world, int x, int y, int z) {
+    if (x < 0 || y < 0 || z < 0 || x >= world->width || y >= world->height) return 1;
+    if (z >= world->depth) return 0;
+
+    return world_block_flags(world, world_get_block_fast(world, x, y, z)) & BLOCK_FLAG_SOLID;
+}
+
+// Page in the chunk columns a range of blocks (inclusive) overlaps so the
+// blocks can be read; 0 when a column of a paged world is not resident
+static int physics_region_resident(World* world, const int lo[3], const int hi[3]) {
+    if (!world->pager) return 1;
+
+    int x0 = max_int(lo[0], 0), x1 = min_int(hi[0], world->width - 1);
+    int y0 = max_int(lo[1], 0), y1 = min_int(hi[1], world->height - 1);
+    for (int cy = y0 >> CHUNK_SHIFT; cy <= y1 >> CHUNK_SHIFT; cy++) {
+        for (int cx = x0 >> CHUNK_SHIFT; cx <= x1 >> CHUNK_SHIFT; cx++) {
+            if (!world_pager_require(world, cx, cy, 0)) return 0;
+        }
+    }
+    return 1;
+}
+
+// Whether every brick overlapping a range of blocks (inclusive) is empty
+static int physics_region_empty(World* world, const int lo[3], const int hi[3]) {
+    int x0 = max_int(lo[0], 0), x1 = min_int(hi[0], world->width - 1);
+    int y0 = max_int(lo[1], 0), y1 = min_int(hi[1], world->height - 1);
+    int z0 = max_int(lo[2], 0), z1 = min_int(hi[2], world->depth - 1);
+
+    // The region reaches a wall or the floor
+    if (lo[0] < 0 || lo[1] < 0 || lo[2] < 0 || hi[0] >= world->width || hi[1] >= world->height) return 0;
+
+    for (int z = z0 >> BRICK_SHIFT; z <= z1 >> BRICK_SHIFT; z++) {
+        for (int y = y0 >> BRICK_SHIFT; y <= y1 >> BRICK_SHIFT; y++) {
+            for (int x = x0 >> BRICK_SHIFT; x <= x1 >> BRICK_SHIFT; x++) {
+                int bx = x << BRICK_SHIFT, by = y << BRICK_SHIFT, bz = z << BRICK_SHIFT;
+                uint64_t occupancy = world->chunk_occupancy[world_chunk_index(world, bx, by, bz)];
+                if (occupancy & ((uint64_t)1 << world_brick_index(bx, by, bz))) return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+// Block ranges a box overlaps on each axis (inclusive)
+static void physics_box_cells(const float box[3], const float size[3], int lo[3], int hi[3]) {
+    for (int axis = 0; axis < 3; axis++) {
+        lo[axis] = (int)floorf(box[axis]);
+        hi[axis] = (int)ceilf(box[axis] + size[axis]) - 1;
+    }
+}
+
+// How far a box can move along one axis, up to delta
+static float physics_sweep_axis(World* world, const float box[3], const float size[3], int axis, float delta) {
+    int lo[3], hi[3];
+    physics_box_cells(box, size, lo, hi);
+
+    // Layers of blocks the leading face enters
+    float lead = delta > 0.0f ? box[axis] + size[axis] : box[axis];
+    int step = delta > 0.0f ? 1 : -1;
+    int first = delta > 0.0f ? (int)ceilf(lead) : (int)floorf(lead) - 1;
+    int last = delta > 0.0f ? (int)ceilf(lead + delta) - 1 : (int)floorf(lead + delta);
+    if ((last - first) * step < 0) return delta;
+
+    // Broad phase: nothing solid anywhere in the swept region
+    lo[axis] = min_int(first, last);
+    hi[axis] = max_int(first, last);
+
+    // A column that has not paged in yet stops the box like a wall
+    if (!physics_region_resident(world, lo, hi)) return 0.0f;
+    if (physics_region_empty(world, lo, hi)) return delta;
+
+    // Stop in front of the first layer with a solid block
+    int a = (axis + 1) % 3;
+    int b = (axis + 2) % 3;
+    int cell[3];
+    for (int layer = first; layer != last + step; layer += step) {
+        cell[axis] = layer;
+        for (cell[a] = lo[a]; cell[a] <= hi[a]; cell[a]++) {
+            for (cell[b] = lo[b]; cell[b] <= hi[b]; cell[b]++) {
+                if (!physics_block_solid(world, cell[0], cell[1], cell[2])) continue;
+
+                // Never pull back from a face the box already rests against
+                if (delta > 0.0f) {
+                    return max_float((float)layer - lead - PHYSICS_SKIN, 0.0f);
+                }
+                return min_float((float)(layer + 1) - lead + PHYSICS_SKIN, 0.0f);
+            }
+        }
+    }
+
+    return delta;
+}
+
+int physics_move_box(World* world, Vector3* min, Vector3 size, Vector3* motion) {
+    if (!world || !min || !motion) return 0;
+
+    float box[3] = { min->x, min->y, min->z };
+    float extent[3] = { size.x, size.y, size.z };
+    float delta[3] = { motion->x, motion->y, motion->z };
+    int hits = 0;
+
+    // Vertical first, so a box that lands slides along the ground
+    static const int order[3] = { 2, 0, 1 };
+    for (int i = 0; i < 3; i++) {
+        int axis = order[i];
+        if (delta[axis] == 0.0f) continue;
+
+        float moved = physics_sweep_axis(world, box, extent, axis, delta[axis]);
+        if (moved != delta[axis]) hits |= 1 << axis;
+        box[axis] += moved;
+        delta[axis] = moved;
+    }
+
+    *min = vec3_create(box[0], box[1], box[2]);
+    *motion = vec3_create(delta[0], delta[1], delta[2]);
+    return hits;
+}
+
+int physics_box_blocked(World* world, Vector3 min, Vector3 size) {
+    if (!world) return 0;
+
+    float box[3] = { min.x, min.y, min.z };
+    float extent[3] = { size.x, size.y, size.z };
+    int lo[3], hi[3];
+    physics_box_cells(box, extent, lo, hi);
+    if (!physics_region_resident(world, lo, hi)) return 1;
+    if (physics_region_empty(world, lo, hi)) return 0;
+
+    for (int z = lo[2]; z <= hi[2]; z++) {
+        for (int y = lo[1]; y <= hi[1]; y++) {
+            for (int x = lo[0]; x <= hi[0]; x++) {
+                if (physics_block_solid(world, x, y, z)) return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file physics.h
+ * @brief Fixed-timestep simulation and swept box collision against the voxel grid
+ *
+ * Simulation advances in steps of PHYSICS_STEP seconds regardless of the
+ * frame rate, so motion constants (GRAVITY, JUMP_FORCE, PLAYER_SPEED) are
+ * per step and the result does not depend on how fast frames render.
+ * Rendering interpolates between the last two steps.
+ */
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include "config.h"
+#include "vector.h"
+#include "world.h"
+
+// Length of one simulation step in seconds
+#define PHYSICS_STEP (1.0f / PHYSICS_TICK_RATE)
+
+// Axes on which physics_move_box was stopped by a solid block
+#define PHYSICS_HIT_X 0x01
+#define PHYSICS_HIT_Y 0x02
+#define PHYSICS_HIT_Z 0x04
+
+// Turns frame time into a whole number of simulation steps
+typedef struct {
+    float accumulator;       // Time not yet simulated, in seconds
+    float alpha;             // How far rendering is between the last two steps (0-1)
+} PhysicsClock;
+
+void physics_clock_init(PhysicsClock* clock);
+
+// Add elapsed time and return how many steps to run (at most
+// PHYSICS_MAX_STEPS; time beyond that is dropped rather than caught up)
+int physics_clock_advance(PhysicsClock* clock, float seconds);
+
+// Move a box (min corner and size) by motion, sliding along solid blocks.
+// Blocks outside the world's sides and below its floor count as solid.
+// motion is reduced to the distance actually moved; returns PHYSICS_HIT_*
+// for the axes that were stopped. Regions whose bricks are all empty are
+// crossed without looking at single blocks.
+int physics_move_box(World* world, Vector3* min, Vector3 size, Vector3* motion);
+
+// Whether a box overlaps any solid block
+int physics_box_blocked(World* world, Vector3 min, Vector3 size);
+
+#endif /* PHYSICS_H */
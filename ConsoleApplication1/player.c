@@ -5,6 +5,7 @@
 #include "player.h"
 #include "config.h"
 #include "raycaster.h"
+#include "physics.h"
 #include "utils.h"
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +29,10 @@ Player* player_create(void) {
     player->health = 100.0f;
     player->stamina = 100.0f;
     player->selected_slot = 1;
+    memset(&player->target, 0, sizeof(PlayerTarget));
+    player->move_input = vec3_create(0.0f, 0.0f, 0.0f);
+    player->previous_position = player->position;
+    player->interpolation = 1.0f;
 
     // Initialize inventory
     player->inventory = (uint8_t*)malloc(MAX_BLOCK_TYPES * sizeof(uint8_t));
@@ -43,6 +48,7 @@ Player* player_create(void) {
     player->inventory[BLOCK_GRASS] = 64;
     player->inventory[BLOCK_WOOD] = 16;
     player->inventory[BLOCK_BRICK] = 16;
+    player->inventory[BLOCK_TORCH] = 16;
 
     return player;
 }
@@ -55,74 +61,67 @@ void player_destroy(Player* player) {
     free(player);
 }
 
-// Update player state
-void player_update(Player* player, World* world, float delta_time) {
-    if (!player || !world) return;
-
-    // Apply gravity if not flying
-    if (!player->flying) {
-        player->velocity.z -= GRAVITY * delta_time;
-    }
-    else {
-        // Slow down in flying mode
-        player->velocity.z *= 0.9f;
-    }
-
-    // Update position
-    Vector3 new_pos = vec3_add(player->position, vec3_mul(player->velocity, delta_time));
+// Collision box: the camera sits at the top, the feet height below it
+static void player_get_box(const Player* player, Vector3* min, Vector3* size) {
+    float half_width = player->width * 0.5f;
+    *min = vec3_create(player->position.x - half_width, player->position.y - half_width,
+                       player->position.z - player->height);
+    *size = vec3_create(player->width, player->width, player->height);
+}
 
-    // Check for collision with ground
-    int ground_x = (int)floorf(new_pos.x);
-    int ground_y = (int)floorf(new_pos.y);
-    int ground_z = (int)floorf(new_pos.z - player->height);
+// Stop velocity components too small to move the player visibly, so a
+// player at rest stays bit-for-bit still
+static float player_settle(float speed) {
+    return fabsf(speed) < PLAYER_REST_SPEED ? 0.0f : speed;
+}
 
-    player->grounded = 0;
+// Advance the player by one simulation step
+void player_update(Player* player, World* world) {
+    if (!player || !world) return;
 
-    // Check if we hit the ground
-    if (ground_z >= 0 && ground_z < world->depth) {
-        if (world_is_solid(world, ground_x, ground_y, ground_z)) {
-            new_pos.z = ground_z + 1.0f + player->height;
-            player->velocity.z = 0.0f;
-            player->grounded = 1;
-        }
-    }
+    player->previous_position = player->position;
 
-    // Check for collision with walls
-    int wall_x = (int)floorf(new_pos.x);
-    int wall_y = (int)floorf(new_pos.y);
-    int wall_z = (int)floorf(new_pos.z);
+    // Walking input; steering in mid-air is weaker
+    int moving = player->move_input.x != 0.0f || player->move_input.y != 0.0f;
+    float control = (player->grounded || player->flying) ? 1.0f : PLAYER_AIR_CONTROL;
+    player->velocity.x += player->move_input.x * control;
+    player->velocity.y += player->move_input.y * control;
 
-    // Check collision in the X direction
-    if (world_is_solid(world, wall_x, (int)floorf(player->position.y), wall_z)) {
-        new_pos.x = player->position.x;
-        player->velocity.x = 0.0f;
+    // Running uses stamina
+    if (moving && player->grounded && player->stamina > 0.0f) {
+        player->stamina -= 0.2f;
+        if (player->stamina < 0.0f) player->stamina = 0.0f;
     }
 
-    // Check collision in the Y direction
-    if (world_is_solid(world, (int)floorf(new_pos.x), wall_y, wall_z)) {
-        new_pos.y = player->position.y;
-        player->velocity.y = 0.0f;
+    // Apply gravity if not flying
+    if (!player->flying) {
+        player->velocity.z -= GRAVITY;
     }
-
-    // Check collision with ceiling
-    int ceiling_z = (int)floorf(new_pos.z);
-    if (ceiling_z < world->depth && world_is_solid(world, wall_x, wall_y, ceiling_z)) {
-        new_pos.z = player->position.z;
-        player->velocity.z = 0.0f;
+    else {
+        // Slow down in flying mode
+        player->velocity.z *= 0.9f;
     }
 
-    // Update position
-    player->position = new_pos;
-
     // Limit max movement speed
-    float speed_limit = 10.0f;
     float current_speed = vec3_length(player->velocity);
-    if (current_speed > speed_limit) {
-        player->velocity = vec3_mul(vec3_normalize(player->velocity), speed_limit);
+    if (current_speed > PLAYER_MAX_SPEED) {
+        player->velocity = vec3_mul(vec3_normalize(player->velocity), PLAYER_MAX_SPEED);
     }
 
+    // Sweep the collision box through the world, sliding along what it hits
+    Vector3 box_min, box_size;
+    player_get_box(player, &box_min, &box_size);
+    Vector3 motion = player->velocity;
+    int hits = physics_move_box(world, &box_min, box_size, &motion);
+    player->position = vec3_add(player->position, motion);
+
+    player->grounded = (hits & PHYSICS_HIT_Z) && player->velocity.z < 0.0f;
+    if (hits & PHYSICS_HIT_X) player->velocity.x = 0.0f;
+    if (hits & PHYSICS_HIT_Y) player->velocity.y = 0.0f;
+    if (hits & PHYSICS_HIT_Z) player->velocity.z = 0.0f;
+
     // Apply friction
-    if (player->grounded) {
+    if (player->grounded || player->flying) {
         player->velocity.x *= 0.8f;
         player->velocity.y *= 0.8f;
     }
@@ -130,19 +129,32 @@ void player_update(Player* player, World* world, float delta_time) {
         player->velocity.x *= 0.98f;
         player->velocity.y *= 0.98f;
     }
-
-    // Make sure player stays within world bounds
-    if (player->position.x < 1.0f) player->position.x = 1.0f;
-    if (player->position.y < 1.0f) player->position.y = 1.0f;
-    if (player->position.x > world->width - 1.0f) player->position.x = world->width - 1.0f;
-    if (player->position.y > world->height - 1.0f) player->position.y = world->height - 1.0f;
+    player->velocity.x = player_settle(player->velocity.x);
+    player->velocity.y = player_settle(player->velocity.y);
+    if (player->flying) player->velocity.z = player_settle(player->velocity.z);
 
     // Recover stamina slowly
     player->stamina = min_float(player->stamina + 0.1f, 100.0f);
 }
 
+// Move the player to a position without interpolating from the old one
+void player_set_position(Player* player, Vector3 position) {
+    if (!player) return;
+
+    player->position = position;
+    player->previous_position = position;
+    player->velocity = vec3_create(0.0f, 0.0f, 0.0f);
+}
+
+// Set how far the camera is between the last two simulation steps
+void player_set_interpolation(Player* player, float alpha) {
+    if (!player) return;
+
+    player->interpolation = clamp(alpha, 0.0f, 1.0f);
+}
+
 // Move player
-void player_move(Player* player, World* world, float forward, float right, float delta_time) {
+void player_move(Player* player, World* world, float forward, float right) {
     if (!player) return;
 
     // Get forward and right vectors
@@ -173,21 +185,9 @@ void player_move(Player* player, World* world, float forward, float right, float
         move_dir = vec3_normalize(move_dir);
     }
 
-    // Apply movement
+    // Applied to velocity by every simulation step until the next call
     float speed = player->flying ? PLAYER_SPEED * 2.0f : PLAYER_SPEED;
-
-    // Running uses stamina
-    if (delta_time > 0.0f && vec3_length(move_dir) > 0.0f) {
-        if (player->grounded && player->stamina > 0.0f) {
-            // Use stamina when running
-            player->stamina -= 0.2f;
-            if (player->stamina < 0.0f) player->stamina = 0.0f;
-        }
-    }
-
-    // Apply movement to velocity
-    player->velocity.x += move_dir.x * speed;
-    player->velocity.y += move_dir.y * speed;
+    player->move_input = vec3_create(move_dir.x * speed, move_dir.y * speed, 0.0f);
 }
 
 // Make player jump
@@ -229,20 +229,19 @@ void player_rotate(Player* player, float pitch, float yaw) {
 int player_is_colliding(Player* player, World* world) {
     if (!player || !world) return 0;
 
-    // Check if inside a block
-    int x = (int)floorf(player->position.x);
-    int y = (int)floorf(player->position.y);
-    int z = (int)floorf(player->position.z);
-
-    return world_is_solid(world, x, y, z);
+    // Check if the collision box overlaps a block
+    Vector3 box_min, box_size;
+    player_get_box(player, &box_min, &box_size);
+    return physics_box_blocked(world, box_min, box_size);
 }
 
 // Get player camera position
 Vector3 player_get_camera_position(Player* player) {
     if (!player) return vec3_create(0.0f, 0.0f, 0.0f);
 
-    // Camera is at player's eye level
-    return player->position;
+    // Camera is at player's eye level, between the last two simulation steps
+    if (player->interpolation >= 1.0f) return player->position;
+    return vec3_lerp(player->previous_position, player->position, player->interpolation);
 }
 
 // Get player view direction
@@ -277,96 +276,113 @@ Vector3 player_get_up_vector(Player* player) {
     return vec3_create(0.0f, 0.0f, 1.0f);
 }
 
-// Interact with the world
-void player_interact(Player* player, World* world) {
-    if (!player || !world) return;
+// Whether the cached target was traced for the current view and world
+static int player_target_current(const Player* player, const World* world) {
+    const PlayerTarget* target = &player->target;
+    Vector3 camera = player_get_camera_position((Player*)player);
+    return target->valid && target->world == world && target->generation == world->generation &&
+        target->origin.x == camera.x && target->origin.y == camera.y && target->origin.z == camera.z &&
+        target->rotation.x == player->rotation.x && target->rotation.y == player->rotation.y;
+}
+
+// Find the targeted block unless the cached one is current
+void player_update_target(Player* player, World* world) {
+    if (!player || !world || player_target_current(player, world)) return;
 
-    // Cast a ray from player
+    PlayerTarget* target = &player->target;
     Vector3 pos = player_get_camera_position(player);
     Vector3 dir = player_get_view_direction(player);
+    RayHit hit = cast_ray(world, pos, dir, PLAYER_REACH);
 
-    RayHit hit = cast_ray(world, pos, dir, 5.0f);
-
+    target->hit = hit.hit;
     if (hit.hit) {
-        // Do something with the hit
-        // For example, print block info
-        BlockType block_type = world_get_block_type(world, hit.block_type);
-        // Interaction logic here
+        // The hit point lies on the face; step half a block in or out of it
+        target->x = (int)floorf(hit.position.x - hit.normal.x * 0.5f);
+        target->y = (int)floorf(hit.position.y - hit.normal.y * 0.5f);
+        target->z = (int)floorf(hit.position.z - hit.normal.z * 0.5f);
+        target->place_x = (int)floorf(hit.position.x + hit.normal.x * 0.5f);
+        target->place_y = (int)floorf(hit.position.y + hit.normal.y * 0.5f);
+        target->place_z = (int)floorf(hit.position.z + hit.normal.z * 0.5f);
+        target->face = hit.face;
+        target->block_type = hit.block_type;
+        target->position = hit.position;
+        target->normal = hit.normal;
     }
+
+    target->world = world;
+    target->generation = world->generation;
+    target->origin = pos;
+    target->rotation = player->rotation;
+    target->valid = 1;
 }
 
-// Place a block in the world
-void player_place_block(Player* player, World* world, uint8_t block_type) {
-    if (!player || !world) return;
+// Get the targeted block, tracing it only if the view or world changed
+const PlayerTarget* player_get_target(Player* player, World* world) {
+    if (!player || !world) return NULL;
 
-    // Cast a ray from player
-    Vector3 pos = player_get_camera_position(player);
-    Vector3 dir = player_get_view_direction(player);
+    player_update_target(player, world);
+    return &player->target;
+}
 
-    RayHit hit = cast_ray(world, pos, dir, 5.0f);
+// Interact with the world
+void player_interact(Player* player, World* world) {
+    const PlayerTarget* target = player_get_target(player, world);
+    if (!target || !target->hit) return;
 
-    if (hit.hit) {
-        // Place block adjacent to hit position
-        int x = (int)floorf(hit.position.x + hit.normal.x * 0.5f);
-        int y = (int)floorf(hit.position.y + hit.normal.y * 0.5f);
-        int z = (int)floorf(hit.position.z + hit.normal.z * 0.5f);
-
-        // Check if the position is valid
-        if (world_is_valid_position(world, x, y, z)) {
-            // Check if player has enough blocks
-            if (player->inventory[block_type] > 0) {
-                // Place block
-                world_set_block(world, x, y, z, block_type);
-
-                // Reduce inventory
-                player->inventory[block_type]--;
-            }
+    // Interaction logic here
+}
+
+// Place a block in the world
+void player_place_block(Player* player, World* world, uint8_t block_type) {
+    const PlayerTarget* target = player_get_target(player, world);
+    if (!target || !target->hit || block_type >= MAX_BLOCK_TYPES) return;
+
+    // Place block adjacent to the targeted face
+    int x = target->place_x;
+    int y = target->place_y;
+    int z = target->place_z;
+
+    // Check if the position is valid and clear of the player
+    Vector3 box_min, box_size;
+    player_get_box(player, &box_min, &box_size);
+    int inside_player = x + 1 > box_min.x && x < box_min.x + box_size.x &&
+        y + 1 > box_min.y && y < box_min.y + box_size.y &&
+        z + 1 > box_min.z && z < box_min.z + box_size.z;
+    if (world_is_valid_position(world, x, y, z) && !inside_player) {
+        // Check if player has enough blocks
+        if (player->inventory[block_type] > 0) {
+            // Place block
+            world_set_block(world, x, y, z, block_type);
+
+            // Reduce inventory
+            player->inventory[block_type]--;
         }
     }
 }
 
 // Break a block in the world
 void player_break_block(Player* player, World* world) {
-    if (!player || !world) return;
-
-    // Cast a ray from player
-    Vector3 pos = player_get_camera_position(player);
-    Vector3 dir = player_get_view_direction(player);
-
-    RayHit hit = cast_ray(world, pos, dir, 5.0f);
+    const PlayerTarget* target = player_get_target(player, world);
+    if (!target || !target->hit) return;
 
-    if (hit.hit) {
-        // Get block position
-        int x = (int)floorf(hit.position.x);
-        int y = (int)floorf(hit.position.y);
-        int z = (int)floorf(hit.position.z);
-
-        // Add block to inventory
-        uint8_t block_type = world_get_block(world, x, y, z);
+    // Add block to inventory
+    uint8_t block_type = target->block_type;
+    if (block_type < MAX_BLOCK_TYPES) {
         player->inventory[block_type]++;
-
-        // Remove block
-        world_set_block(world, x, y, z, BLOCK_AIR);
     }
+
+    // Remove block
+    world_set_block(world, target->x, target->y, target->z, BLOCK_AIR);
 }
 
 // Cast a ray and get the block position and normal
 int player_raycast_block(Player* player, World* world, Vector3* out_position, Vector3* out_normal) {
-    if (!player || !world) return 0;
-
-    // Cast a ray from player
-    Vector3 pos = player_get_camera_position(player);
-    Vector3 dir = player_get_view_direction(player);
-
-    RayHit hit = cast_ray(world, pos, dir, 5.0f);
-
-    if (hit.hit) {
-        if (out_position) *out_position = hit.position;
-        if (out_normal) *out_normal = hit.normal;
-        return 1;
-    }
+    const PlayerTarget* target = player_get_target(player, world);
+    if (!target || !target->hit) return 0;
 
-    return 0;
+    if (out_position) *out_position = target->position;
+    if (out_normal) *out_normal = target->normal;
+    return 1;
 }
 
 // Select an inventory slot
@@ -8,6 +8,25 @@
 #include "vector.h"
 #include "world.h"
 
+// Block under the crosshair within PLAYER_REACH, traced once per frame
+// and shared by block interaction, the HUD and the renderer
+typedef struct {
+    int valid;           // Whether the fields below are up to date
+    int hit;             // Whether a block is within reach
+    int x, y, z;         // Targeted block
+    int place_x, place_y, place_z; // Cell in front of the targeted face
+    int face;            // Face the view ray entered
+    uint8_t block_type;  // Type of the targeted block
+    Vector3 position;    // Point the view ray hit
+    Vector3 normal;      // Normal of the hit face
+
+    // What the target was traced for; a change to any of these makes it stale
+    const World* world;
+    unsigned int generation;
+    Vector3 origin;
+    Vector2 rotation;
+} PlayerTarget;
+
  // Player structure
 typedef struct {
     Vector3 position;    // Position in the world
@@ -21,15 +40,22 @@ typedef struct {
     float stamina;       // Player stamina
     int selected_slot;   // Currently selected inventory slot
     uint8_t* inventory;  // Player inventory
+    PlayerTarget target; // Targeted block, see player_get_target
+    Vector3 move_input;  // Walking acceleration per step, set by player_move
+    Vector3 previous_position; // Position before the last simulation step
+    float interpolation; // Camera position between previous_position (0) and position (1)
 } Player;
 
 // Player creation and destruction
 Player* player_create(void);
 void player_destroy(Player* player);
 
-// Movement and physics
-void player_update(Player* player, World* world, float delta_time);
-void player_move(Player* player, World* world, float forward, float right, float delta_time);
+// Movement and physics. player_update advances one PHYSICS_STEP; the
+// camera is interpolated between steps by player_set_interpolation.
+void player_update(Player* player, World* world);
+void player_move(Player* player, World* world, float forward, float right);
+void player_set_position(Player* player, Vector3 position);
+void player_set_interpolation(Player* player, float alpha);
 void player_jump(Player* player);
 void player_rotate(Player* player, float pitch, float yaw);
 int player_is_colliding(Player* player, World* world);
@@ -41,6 +67,12 @@ Vector3 player_get_forward_vector(Player* player);
 Vector3 player_get_right_vector(Player* player);
 Vector3 player_get_up_vector(Player* player);
 
+// Targeting: trace the view ray unless the cached target still matches the
+// camera and the world (any block change makes it stale). Call
+// player_update_target once per frame after player_update.
+void player_update_target(Player* player, World* world);
+const PlayerTarget* player_get_target(Player* player, World* world);
+
 // Interaction
 void player_interact(Player* player, World* world);
 void player_place_block(Player* player, World* world, uint8_t block_type);
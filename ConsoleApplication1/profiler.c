@@ -0,0 +1,247 @@
+/**
+ * @file profiler.c
+ * @brief Frame-time profiler and hot-path counters
+ */
+#include "profiler.h"
+
+#if DEBUG_MODE
+
+#include "thread.h"
+#include "utils.h"
+#include <stdio.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PROFILER_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILER_RDTSC 1
+#else
+#define PROFILER_RDTSC 0
+#endif
+
+// Timer spans kept for the trace (about PROFILER_FRAMES frames of stages)
+#define PROFILER_SPANS (PROFILER_FRAMES * PROFILE_SCOPE_COUNT)
+
+typedef struct {
+    unsigned long long start;
+    unsigned long long ticks;
+    int scope;
+} ProfileSpan;
+
+typedef struct {
+    unsigned long long start;
+    float scope_ms[PROFILE_SCOPE_COUNT];
+    long long counters[PROFILE_COUNTER_COUNT];
+} ProfileFrame;
+
+static struct {
+    int initialized;
+    Mutex lock;               // Guards everything below against other threads' stages
+    unsigned long long base_ticks;
+    unsigned long long base_us;
+    double ticks_per_us;
+
+    // Current frame
+    unsigned long long frame_start;
+    unsigned long long scope_start[PROFILE_SCOPE_COUNT];
+    unsigned long long scope_ticks[PROFILE_SCOPE_COUNT];
+    volatile long long counters[PROFILE_COUNTER_COUNT];
+
+    // Rings of finished frames and spans
+    ProfileFrame frames[PROFILER_FRAMES];
+    int frame_count;
+    int frame_next;
+    ProfileSpan spans[PROFILER_SPANS];
+    int span_count;
+    int span_next;
+} profiler;
+
+static const char* scope_names[PROFILE_SCOPE_COUNT] = {
+    "frame", "input", "update", "clear", "world", "overlay", "present"
+};
+
+static const char* counter_names[PROFILE_COUNTER_COUNT] = {
+    "rays", "dda_steps", "brightness", "present_bytes"
+};
+
+static unsigned long long profiler_ticks(void) {
+#if PROFILER_RDTSC
+    return __rdtsc();
+#else
+    return get_time_us();
+#endif
+}
+
+void profiler_init(void) {
+    if (profiler.initialized) return;
+
+    mutex_init(&profiler.lock);
+    profiler.base_ticks = profiler_ticks();
+    profiler.base_us = get_time_us();
+    profiler.ticks_per_us = 1.0;
+    profiler.frame_start = profiler.base_ticks;
+    profiler.initialized = 1;
+}
+
+// Refine the timestamp counter rate against the wall clock; the estimate
+// sharpens as the baseline grows
+static void profiler_calibrate(void) {
+#if PROFILER_RDTSC
+    unsigned long long elapsed_us = get_time_us() - profiler.base_us;
+    if (elapsed_us > 0) {
+        profiler.ticks_per_us = (double)(profiler_ticks() - profiler.base_ticks) / (double)elapsed_us;
+    }
+#endif
+}
+
+static double profiler_ticks_to_us(unsigned long long ticks) {
+    return (double)ticks / profiler.ticks_per_us;
+}
+
+void profiler_begin(ProfileScope scope) {
+    if (!profiler.initialized) profiler_init();
+    unsigned long long now = profiler_ticks();
+    profiler.scope_start[scope] = now;
+    if (scope == PROFILE_FRAME) profiler.frame_start = now;
+}
+
+void profiler_end(ProfileScope scope) {
+    if (!profiler.initialized) return;
+    unsigned long long now = profiler_ticks();
+    unsigned long long ticks = now - profiler.scope_start[scope];
+
+    mutex_lock(&profiler.lock);
+    profiler.scope_ticks[scope] += ticks;
+
+    ProfileSpan* span = &profiler.spans[profiler.span_next];
+    span->start = profiler.scope_start[scope];
+    span->ticks = ticks;
+    span->scope = scope;
+    profiler.span_next = (profiler.span_next + 1) % PROFILER_SPANS;
+    if (profiler.span_count < PROFILER_SPANS) profiler.span_count++;
+    mutex_unlock(&profiler.lock);
+}
+
+void profiler_count(ProfileCounter counter, long long amount) {
+    atomic_add(&profiler.counters[counter], amount);
+}
+
+void profiler_end_frame(void) {
+    if (!profiler.initialized) return;
+
+    mutex_lock(&profiler.lock);
+    profiler_calibrate();
+
+    ProfileFrame* frame = &profiler.frames[profiler.frame_next];
+    frame->start = profiler.frame_start;
+    for (int i = 0; i < PROFILE_SCOPE_COUNT; i++) {
+        frame->scope_ms[i] = (float)(profiler_ticks_to_us(profiler.scope_ticks[i]) / 1000.0);
+        profiler.scope_ticks[i] = 0;
+    }
+    for (int i = 0; i < PROFILE_COUNTER_COUNT; i++) {
+        // Take what has been counted so far; adds racing with this stay for the next frame
+        long long value = profiler.counters[i];
+        atomic_add(&profiler.counters[i], -value);
+        frame->counters[i] = value;
+    }
+    profiler.frame_next = (profiler.frame_next + 1) % PROFILER_FRAMES;
+    if (profiler.frame_count < PROFILER_FRAMES) profiler.frame_count++;
+    mutex_unlock(&profiler.lock);
+}
+
+// The i-th most recent frame (0 = newest)
+static const ProfileFrame* profiler_recent(int i) {
+    return &profiler.frames[(profiler.frame_next - 1 - i + PROFILER_FRAMES) % PROFILER_FRAMES];
+}
+
+static int profiler_average_count(void) {
+    return profiler.frame_count < PROFILER_AVERAGE_FRAMES ? profiler.frame_count : PROFILER_AVERAGE_FRAMES;
+}
+
+float profiler_scope_ms(ProfileScope scope) {
+    if (!profiler.initialized) return 0.0f;
+
+    mutex_lock(&profiler.lock);
+    int count = profiler_average_count();
+    float total = 0.0f;
+    for (int i = 0; i < count; i++) total += profiler_recent(i)->scope_ms[scope];
+    mutex_unlock(&profiler.lock);
+    return count ? total / (float)count : 0.0f;
+}
+
+double profiler_counter_average(ProfileCounter counter) {
+    if (!profiler.initialized) return 0.0;
+
+    mutex_lock(&profiler.lock);
+    int count = profiler_average_count();
+    double total = 0.0;
+    for (int i = 0; i < count; i++) total += (double)profiler_recent(i)->counters[counter];
+    mutex_unlock(&profiler.lock);
+    return count ? total / (double)count : 0.0;
+}
+
+int profiler_frame_history(float* ms, int count) {
+    if (!ms || count <= 0 || !profiler.initialized) return 0;
+
+    mutex_lock(&profiler.lock);
+    if (count > profiler.frame_count) count = profiler.frame_count;
+    for (int i = 0; i < count; i++) {
+        ms[i] = profiler_recent(count - 1 - i)->scope_ms[PROFILE_FRAME];
+    }
+    mutex_unlock(&profiler.lock);
+    return count;
+}
+
+const char* profiler_scope_name(ProfileScope scope) {
+    return scope_names[scope];
+}
+
+int profiler_dump_trace(const char* filename) {
+    if (!filename || !profiler.initialized) return 0;
+    FILE* file = fopen(filename, "w");
+    if (!file) return 0;
+
+    mutex_lock(&profiler.lock);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    int first = 1;
+
+    // Stage spans, oldest first
+    int start = (profiler.span_next - profiler.span_count + PROFILER_SPANS) % PROFILER_SPANS;
+    for (int i = 0; i < profiler.span_count; i++) {
+        const ProfileSpan* span = &profiler.spans[(start + i) % PROFILER_SPANS];
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", scope_names[span->scope],
+                profiler_ticks_to_us(span->start - profiler.base_ticks),
+                profiler_ticks_to_us(span->ticks));
+        first = 0;
+    }
+
+    // Per-frame counters as counter tracks
+    for (int i = profiler.frame_count - 1; i >= 0; i--) {
+        const ProfileFrame* frame = profiler_recent(i);
+        fprintf(file, "%s{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{",
+                first ? "" : ",\n", profiler_ticks_to_us(frame->start - profiler.base_ticks));
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+            fprintf(file, "%s\"%s\":%lld", c ? "," : "", counter_names[c], frame->counters[c]);
+        }
+        fprintf(file, "}}");
+        first = 0;
+    }
+
+    fprintf(file, "\n]}\n");
+    int frame_count = profiler.frame_count;
+    mutex_unlock(&profiler.lock);
+
+    int ok = !ferror(file);
+    fclose(file);
+    if (ok) log_message(LOG_INFO, "profiler: wrote %d frames to %s", frame_count, filename);
+    return ok;
+}
+
+#else
+
+// Nothing to compile without DEBUG_MODE
+typedef int profiler_disabled;
+
+#endif
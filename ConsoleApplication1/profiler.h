@@ -0,0 +1,88 @@
+/**
+ * @file profiler.h
+ * @brief Frame-time profiler and hot-path counters
+ *
+ * Stage timers read the CPU timestamp counter (the high resolution clock
+ * where there is none) and counters are bumped from the hot paths. The last
+ * PROFILER_FRAMES frames are kept for rolling averages, the overlay
+ * sparkline and a Chrome trace dump (chrome://tracing, ui.perfetto.dev).
+ *
+ * Everything compiles to nothing when DEBUG_MODE is 0.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "config.h"
+
+// Timed stages of a frame
+typedef enum {
+    PROFILE_FRAME,
+    PROFILE_INPUT,
+    PROFILE_UPDATE,
+    PROFILE_CLEAR,
+    PROFILE_WORLD,
+    PROFILE_OVERLAY,
+    PROFILE_PRESENT,
+    PROFILE_SCOPE_COUNT
+} ProfileScope;
+
+// Per-frame event counts
+typedef enum {
+    PROFILE_RAYS,            // Rays cast
+    PROFILE_DDA_STEPS,       // Grid cells visited by all rays
+    PROFILE_BRIGHTNESS,      // Lighting lookups for hits
+    PROFILE_PRESENT_BYTES,   // Bytes written by present
+    PROFILE_COUNTER_COUNT
+} ProfileCounter;
+
+// Frames kept for averages and traces, and frames averaged in the overlay
+#define PROFILER_FRAMES 1024
+#define PROFILER_AVERAGE_FRAMES 60
+
+#if DEBUG_MODE
+
+// Set up the profiler; call before other threads record anything (the
+// first profiler_begin does it for single-threaded use)
+void profiler_init(void);
+
+// Time a stage; begin and end pair up on one thread, and each stage
+// belongs to a single thread
+void profiler_begin(ProfileScope scope);
+void profiler_end(ProfileScope scope);
+
+// Add to a counter (thread-safe)
+void profiler_count(ProfileCounter counter, long long amount);
+
+// Close the frame: store its timings and counts and reset them
+void profiler_end_frame(void);
+
+// Rolling averages over the last PROFILER_AVERAGE_FRAMES frames
+float profiler_scope_ms(ProfileScope scope);
+double profiler_counter_average(ProfileCounter counter);
+
+// Frame times in ms, oldest first; returns how many were written
+int profiler_frame_history(float* ms, int count);
+
+// Write the recorded frames as Chrome trace JSON (returns 0 on failure)
+int profiler_dump_trace(const char* filename);
+
+const char* profiler_scope_name(ProfileScope scope);
+
+#define PROFILE_INIT() profiler_init()
+#define PROFILE_BEGIN(scope) profiler_begin(scope)
+#define PROFILE_END(scope) profiler_end(scope)
+#define PROFILE_COUNT(counter, amount) profiler_count((counter), (amount))
+#define PROFILE_END_FRAME() profiler_end_frame()
+
+#else
+
+// The amount is still evaluated so locals that only feed a counter stay used
+#define PROFILE_INIT() ((void)0)
+#define PROFILE_BEGIN(scope) ((void)0)
+#define PROFILE_END(scope) ((void)0)
+#define PROFILE_COUNT(counter, amount) ((void)(amount))
+#define PROFILE_END_FRAME() ((void)0)
+
+#endif
+
+#endif /* PROFILER_H */
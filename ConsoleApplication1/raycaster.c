@@ -5,8 +5,17 @@
 #include "raycaster.h"
 #include "config.h"
 #include "utils.h"
+#include "profiler.h"
 #include <math.h>
 
+// SSE2 is part of every x64 target and the MSVC x86 default
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAYCASTER_SSE2 1
+#include <emmintrin.h>
+#else
+#define RAYCASTER_SSE2 0
+#endif
+
 // Face normals for each direction
 static const Vector3 face_normals[6] = {
     {1.0f, 0.0f, 0.0f},    // +X
@@ -27,13 +36,62 @@ static const float face_brightness[6] = {
     0.7f    // -Z
 };
 
+// Advance one axis of the DDA to the last boundary it crosses before t,
+// without leaving the aligned cell of the given size. Written without
+// branches: skips are short and their directions unpredictable.
+static inline void skip_axis(int size, float t, int* map, int step, float* t_max, float t_delta) {
+    int local = *map & (size - 1);
+    int limit = step > 0 ? size - 1 - local : local;
+    int count = (int)floorf((t - *t_max) / t_delta) + 1;
+    count = count < 0 ? 0 : count;
+    count = count > limit ? limit : count;
+    count = step != 0 ? count : 0;
+
+    *map += step * count;
+    *t_max += t_delta * (float)count;
+}
+
+// Distance at which one axis of the DDA leaves the aligned cell
+static inline float cell_exit_time(int size, int map, int step, float t_max, float t_delta) {
+    int local = map & (size - 1);
+    int crossings = step > 0 ? size - 1 - local : local;
+    return step != 0 ? t_max + (float)crossings * t_delta : 1e30f;
+}
+
+// Lighting for a hit on the given face of a block: the light of the block
+// the face looks into
+static float ray_hit_brightness(World* world, int x, int y, int z, int face) {
+    PROFILE_COUNT(PROFILE_BRIGHTNESS, 1);
+    float brightness = world_get_brightness(world,
+        x + (int)face_normals[face].x, y + (int)face_normals[face].y, z + (int)face_normals[face].z);
+    brightness *= face_brightness[face];
+
+    // Fog is left to shading, so views can switch it without relighting
+    return clamp(brightness, 0.2f, 1.0f);
+}
+
 // Cast a ray and find what it hits
 RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_distance) {
+    Vector3 ray_dir = vec3_normalize(direction);
+    return cast_ray_unit(world, position, ray_dir, ray_inverse(ray_dir), max_distance);
+}
+
+// Per-axis reciprocals of a direction's magnitude (1e30 where it is zero)
+Vector3 ray_inverse(Vector3 direction) {
+    Vector3 inverse;
+    inverse.x = direction.x != 0.0f ? 1.0f / fabsf(direction.x) : 1e30f;
+    inverse.y = direction.y != 0.0f ? 1.0f / fabsf(direction.y) : 1e30f;
+    inverse.z = direction.z != 0.0f ? 1.0f / fabsf(direction.z) : 1e30f;
+    return inverse;
+}
+
+// Cast a ray along a unit direction with precomputed reciprocals
+RayHit cast_ray_unit(World* world, Vector3 position, Vector3 direction, Vector3 inverse, float max_distance) {
     RayHit result = { 0 };
 
     // Initialize ray
     Vector3 ray_pos = position;
-    Vector3 ray_dir = vec3_normalize(direction);
+    Vector3 ray_dir = direction;
 
     // Initialize result
     result.hit = 0;
@@ -58,12 +116,12 @@ RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_dis
     }
     else if (ray_dir.x > 0.0f) {
         step_x = 1;
-        t_delta_x = 1.0f / ray_dir.x;
+        t_delta_x = inverse.x;
         t_max_x = t_delta_x * ((float)(map_x + 1) - ray_pos.x);
     }
     else {
         step_x = -1;
-        t_delta_x = 1.0f / -ray_dir.x;
+        t_delta_x = inverse.x;
         t_max_x = t_delta_x * (ray_pos.x - (float)map_x);
     }
 
@@ -74,12 +132,12 @@ RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_dis
     }
     else if (ray_dir.y > 0.0f) {
         step_y = 1;
-        t_delta_y = 1.0f / ray_dir.y;
+        t_delta_y = inverse.y;
         t_max_y = t_delta_y * ((float)(map_y + 1) - ray_pos.y);
     }
     else {
         step_y = -1;
-        t_delta_y = 1.0f / -ray_dir.y;
+        t_delta_y = inverse.y;
         t_max_y = t_delta_y * (ray_pos.y - (float)map_y);
     }
 
@@ -90,20 +148,23 @@ RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_dis
     }
     else if (ray_dir.z > 0.0f) {
         step_z = 1;
-        t_delta_z = 1.0f / ray_dir.z;
+        t_delta_z = inverse.z;
         t_max_z = t_delta_z * ((float)(map_z + 1) - ray_pos.z);
     }
     else {
         step_z = -1;
-        t_delta_z = 1.0f / -ray_dir.z;
+        t_delta_z = inverse.z;
         t_max_z = t_delta_z * (ray_pos.z - (float)map_z);
     }
 
     // DDA algorithm for raycasting
     float distance = 0.0f;
     int face = 0;
+    int steps = 0;
 
     while (distance < max_distance) {
+        steps++;
+
         // Find the closest axis to step along
         if (t_max_x < t_max_y && t_max_x < t_max_z) {
             distance = t_max_x;
@@ -130,8 +191,33 @@ RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_dis
             break; // Out of bounds
         }
 
+        // Skip empty chunks and bricks in one jump each. Testing every
+        // step is cheaper than tracking brick changes: the branch stays
+        // predictable and shares the chunk lookup with the block fetch.
+        int chunk = world_chunk_index(world, map_x, map_y, map_z);
+        uint64_t occupancy = world->chunk_occupancy[chunk];
+        if (!(occupancy & ((uint64_t)1 << world_brick_index(map_x, map_y, map_z)))) {
+            int skip_size = occupancy ? BRICK_SIZE : CHUNK_SIZE;
+
+            // The first axis to leave the empty cell decides where we exit
+            float t_exit = cell_exit_time(skip_size, map_x, step_x, t_max_x, t_delta_x);
+            float t_exit_y = cell_exit_time(skip_size, map_y, step_y, t_max_y, t_delta_y);
+            float t_exit_z = cell_exit_time(skip_size, map_z, step_z, t_max_z, t_delta_z);
+            t_exit = t_exit_y < t_exit ? t_exit_y : t_exit;
+            t_exit = t_exit_z < t_exit ? t_exit_z : t_exit;
+
+            // Stop on the last voxel inside the cell (or the last one
+            // short of max_distance), so the next regular step continues
+            // exactly as the per-voxel walk would have
+            t_exit = t_exit < max_distance ? t_exit : max_distance;
+            skip_axis(skip_size, t_exit, &map_x, step_x, &t_max_x, t_delta_x);
+            skip_axis(skip_size, t_exit, &map_y, step_y, &t_max_y, t_delta_y);
+            skip_axis(skip_size, t_exit, &map_z, step_z, &t_max_z, t_delta_z);
+            continue;
+        }
+
         // Check hit
-        uint8_t block_type = world_get_block(world, map_x, map_y, map_z);
+        uint8_t block_type = world->chunks[chunk][world_chunk_offset(map_x, map_y, map_z)];
         if (block_type != BLOCK_AIR) {
             // We hit something!
             result.hit = 1;
@@ -140,77 +226,525 @@ RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_dis
             result.position = vec3_add(ray_pos, vec3_mul(ray_dir, distance));
             result.normal = face_normals[face];
             result.face = face;
+            result.brightness = ray_hit_brightness(world, map_x, map_y, map_z, face);
+            break;
+        }
+    }
+
+    PROFILE_COUNT(PROFILE_RAYS, 1);
+    PROFILE_COUNT(PROFILE_DDA_STEPS, steps);
+    return result;
+}
+
+// Start of the 2D walk of one axis across cells of the given size
+static inline float far_axis_setup(float origin, float dir, float inverse, float t, int level,
+                                   int* map, int* step, float* t_delta) {
+    float point = origin + dir * t;
+    float size = (float)(1 << level);
+    *map = (int)floorf(point) >> level;
+    *t_delta = size * inverse;
+
+    if (dir > 0.0f) {
+        *step = 1;
+        return t + ((float)(*map + 1) * size - point) * inverse;
+    }
+    if (dir < 0.0f) {
+        *step = -1;
+        return t + (point - (float)*map * size) * inverse;
+    }
+    *step = 0;
+    return 1e30f;
+}
+
+// March the heightfield mips: walk the cells the ray crosses in the xy
+// plane and stop at the first whose top the ray passes below
+RayHit cast_ray_far(World* world, Vector3 position, Vector3 direction, float start, float max_distance) {
+    RayHit result = { 0 };
+    result.distance = max_distance;
+    if (!world || start >= max_distance) return result;
+
+    float inverse_x = direction.x != 0.0f ? 1.0f / fabsf(direction.x) : 1e30f;
+    float inverse_y = direction.y != 0.0f ? 1.0f / fabsf(direction.y) : 1e30f;
+
+    // Face of the first cell: the one the ray would enter along its main axis
+    int face = fabsf(direction.x) > fabsf(direction.y) ? (direction.x > 0.0f ? 1 : 0)
+                                                       : (direction.y > 0.0f ? 3 : 2);
+    float t = start;
+    int level = 0;
+    int steps = 0;
 
-            // Calculate lighting
-            float brightness = world_get_brightness(world, map_x, map_y, map_z);
-            brightness *= face_brightness[face];
+    while (t < max_distance) {
+        // Coarser levels take over as the distance doubles
+        while (level < WORLD_LOD_LEVELS - 1 && t >= start * (float)(2 << level)) {
+            level++;
+        }
+        float t_level_end = level < WORLD_LOD_LEVELS - 1 ? start * (float)(2 << level) : max_distance;
+        t_level_end = t_level_end < max_distance ? t_level_end : max_distance;
+
+        int map_x, map_y, step_x, step_y;
+        float t_delta_x, t_delta_y;
+        float t_max_x = far_axis_setup(position.x, direction.x, inverse_x, t, level, &map_x, &step_x, &t_delta_x);
+        float t_max_y = far_axis_setup(position.y, direction.y, inverse_y, t, level, &map_y, &step_y, &t_delta_y);
 
-            // Apply fog based on distance
-            if (ENABLE_FOG) {
-                float fog_factor = clamp((distance - FOG_START) / (FOG_END - FOG_START), 0.0f, 1.0f);
-                brightness *= (1.0f - fog_factor * 0.8f);
+        const WorldLodCell* cells = world->lod[level];
+        int width = world_lod_width(world, level);
+        int height = world_lod_height(world, level);
+
+        while (t < t_level_end) {
+            // Nothing left to hit past the sides, below the floor or
+            // above the top of the world
+            float z = position.z + direction.z * t;
+            if (map_x < 0 || map_y < 0 || map_x >= width || map_y >= height ||
+                z < 0.0f || (z >= (float)world->depth && direction.z >= 0.0f)) {
+                PROFILE_COUNT(PROFILE_DDA_STEPS, steps);
+                return result;
             }
+            steps++;
 
-            result.brightness = clamp(brightness, 0.2f, 1.0f);
-            break;
+            float t_exit = t_max_x < t_max_y ? t_max_x : t_max_y;
+            const WorldLodCell* cell = &cells[(size_t)map_y * width + map_x];
+            if (cell->top >= 0) {
+                // The ray enters below the top through a side, or comes
+                // down onto the top before it leaves the cell
+                float top = (float)cell->top + 1.0f;
+                float t_hit = -1.0f;
+                if (z < top) {
+                    t_hit = t;
+                }
+                else if (direction.z < 0.0f && position.z + direction.z * t_exit < top) {
+                    t_hit = (top - position.z) / direction.z;
+                    face = 4;
+                }
+
+                if (t_hit >= 0.0f && t_hit < max_distance) {
+                    result.hit = 1;
+                    result.coarse = 1;
+                    result.block_type = cell->type;
+                    result.distance = t_hit;
+                    result.position = vec3_add(position, vec3_mul(direction, t_hit));
+                    result.normal = face_normals[face];
+                    result.face = face;
+                    ray_hit_relight(world, &result);
+                    PROFILE_COUNT(PROFILE_DDA_STEPS, steps);
+                    return result;
+                }
+            }
+
+            // Step into the next cell
+            if (t_max_x < t_max_y) {
+                t = t_max_x;
+                t_max_x += t_delta_x;
+                map_x += step_x;
+                face = step_x > 0 ? 1 : 0;
+            }
+            else {
+                t = t_max_y;
+                t_max_y += t_delta_y;
+                map_y += step_y;
+                face = step_y > 0 ? 3 : 2;
+            }
         }
     }
 
+    PROFILE_COUNT(PROFILE_DDA_STEPS, steps);
     return result;
 }
 
-// Get character to display for a hit
-char get_hit_display_char(RayHit hit) {
-    if (!hit.hit) {
-        return ' ';
+#if RAYCASTER_SSE2
+
+// Lane views of SSE registers
+typedef union {
+    __m128 v;
+    float f[RAY_PACKET_SIZE];
+} PacketFloats;
+
+typedef union {
+    __m128i v;
+    int i[RAY_PACKET_SIZE];
+} PacketInts;
+
+// Select b where mask is set, otherwise a
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a));
+}
+
+static inline __m128i select_epi32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
+// 32-bit multiply (SSE2 only has the unsigned 32x32->64 form)
+static inline __m128i mullo_epi32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Per-axis DDA setup for four lanes, matching the scalar branches exactly
+static inline void packet_axis_setup(__m128 dir, __m128 inverse, float origin, int map,
+    __m128* t_max, __m128* t_delta, __m128i* step) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 far_away = _mm_set1_ps(1e30f);
+    __m128 positive = _mm_cmpgt_ps(dir, zero);
+    __m128 negative = _mm_cmplt_ps(dir, zero);
+    __m128 moving = _mm_or_ps(positive, negative);
+
+    __m128 delta = inverse;
+    __m128 to_boundary = select_ps(positive,
+        _mm_set1_ps(origin - (float)map), _mm_set1_ps((float)(map + 1) - origin));
+
+    *t_delta = select_ps(moving, far_away, delta);
+    *t_max = select_ps(moving, far_away, _mm_mul_ps(delta, to_boundary));
+
+    // +1 where positive, -1 where negative, 0 otherwise
+    *step = _mm_sub_epi32(_mm_castps_si128(negative), _mm_castps_si128(positive));
+}
+
+// Normalize four directions as cast_ray does and prepare them
+void cast_ray_packet4(World* world, Vector3 position, const Vector3* directions, float max_distance, RayHitPacket* hits) {
+    RayPacketDirs rays;
+    __m128 dir_x = _mm_setr_ps(directions[0].x, directions[1].x, directions[2].x, directions[3].x);
+    __m128 dir_y = _mm_setr_ps(directions[0].y, directions[1].y, directions[2].y, directions[3].y);
+    __m128 dir_z = _mm_setr_ps(directions[0].z, directions[1].z, directions[2].z, directions[3].z);
+    __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dir_x, dir_x),
+        _mm_mul_ps(dir_y, dir_y)), _mm_mul_ps(dir_z, dir_z)));
+    __m128 usable = _mm_cmpge_ps(length, _mm_set1_ps(0.0001f));
+    _mm_storeu_ps(rays.dir_x, _mm_and_ps(usable, _mm_div_ps(dir_x, length)));
+    _mm_storeu_ps(rays.dir_y, _mm_and_ps(usable, _mm_div_ps(dir_y, length)));
+    _mm_storeu_ps(rays.dir_z, _mm_and_ps(usable, _mm_div_ps(dir_z, length)));
+
+    ray_packet_prepare(&rays);
+    cast_ray_packet4_prepared(world, position, &rays, max_distance, hits);
+}
+
+// Reciprocals of one axis; 1 / |dir| is bit-identical to 1 / -dir on the
+// negative lanes. Zero lanes get 1e30, which the axis setup ignores.
+static inline __m128 packet_inverse(__m128 dir) {
+    __m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.0f), dir);
+    __m128 moving = _mm_cmpneq_ps(dir, _mm_setzero_ps());
+    return select_ps(moving, _mm_set1_ps(1e30f), _mm_div_ps(_mm_set1_ps(1.0f), magnitude));
+}
+
+// Compute the reciprocals of a packet's unit directions
+void ray_packet_prepare(RayPacketDirs* rays) {
+    _mm_storeu_ps(rays->inv_x, packet_inverse(_mm_loadu_ps(rays->dir_x)));
+    _mm_storeu_ps(rays->inv_y, packet_inverse(_mm_loadu_ps(rays->dir_y)));
+    _mm_storeu_ps(rays->inv_z, packet_inverse(_mm_loadu_ps(rays->dir_z)));
+}
+
+// Cast four prepared rays from one position. Lanes step through the grid
+// together: axis selection, stepping, bounds and addressing run in SSE
+// registers without branches; only skips and hits drop into per-lane code.
+void cast_ray_packet4_prepared(World* world, Vector3 position, const RayPacketDirs* rays,
+                               float max_distance, RayHitPacket* hits) {
+    // Lane masks indexed by a 4-bit active set
+    static const int lane_masks[16][4] = {
+        { 0, 0, 0, 0 }, { -1, 0, 0, 0 }, { 0, -1, 0, 0 }, { -1, -1, 0, 0 },
+        { 0, 0, -1, 0 }, { -1, 0, -1, 0 }, { 0, -1, -1, 0 }, { -1, -1, -1, 0 },
+        { 0, 0, 0, -1 }, { -1, 0, 0, -1 }, { 0, -1, 0, -1 }, { -1, -1, 0, -1 },
+        { 0, 0, -1, -1 }, { -1, 0, -1, -1 }, { 0, -1, -1, -1 }, { -1, -1, -1, -1 }
+    };
+
+    __m128 dir_x = _mm_loadu_ps(rays->dir_x);
+    __m128 dir_y = _mm_loadu_ps(rays->dir_y);
+    __m128 dir_z = _mm_loadu_ps(rays->dir_z);
+
+    // All lanes start in the same cell
+    int start_x = (int)floorf(position.x);
+    int start_y = (int)floorf(position.y);
+    int start_z = (int)floorf(position.z);
+
+    __m128 t_max_x, t_max_y, t_max_z;
+    __m128 t_delta_x, t_delta_y, t_delta_z;
+    __m128i step_x, step_y, step_z;
+    packet_axis_setup(dir_x, _mm_loadu_ps(rays->inv_x), position.x, start_x, &t_max_x, &t_delta_x, &step_x);
+    packet_axis_setup(dir_y, _mm_loadu_ps(rays->inv_y), position.y, start_y, &t_max_y, &t_delta_y, &step_y);
+    packet_axis_setup(dir_z, _mm_loadu_ps(rays->inv_z), position.z, start_z, &t_max_z, &t_delta_z, &step_z);
+
+    __m128i map_x = _mm_set1_epi32(start_x);
+    __m128i map_y = _mm_set1_epi32(start_y);
+    __m128i map_z = _mm_set1_epi32(start_z);
+
+    // Face entered on each axis (-X/+X, -Y/+Y, -Z/+Z)
+    const __m128i zero_i = _mm_setzero_si128();
+    __m128i face_x = _mm_sub_epi32(_mm_set1_epi32(0), _mm_cmpgt_epi32(step_x, zero_i));
+    __m128i face_y = _mm_sub_epi32(_mm_set1_epi32(2), _mm_cmpgt_epi32(step_y, zero_i));
+    __m128i face_z = _mm_sub_epi32(_mm_set1_epi32(4), _mm_cmpgt_epi32(step_z, zero_i));
+
+    // Chunk table layout
+    const __m128i chunk_mask = _mm_set1_epi32(CHUNK_MASK);
+    const __m128i chunks_x = _mm_set1_epi32(world->chunks_x);
+    const __m128i chunks_y = _mm_set1_epi32(world->chunks_y);
+    const __m128i bricks_per_axis = _mm_set1_epi32(BRICKS_PER_AXIS);
+
+    // Last valid cell on each axis
+    const __m128i last_x = _mm_set1_epi32(world->width - 1);
+    const __m128i last_y = _mm_set1_epi32(world->height - 1);
+    const __m128i last_z = _mm_set1_epi32(world->depth - 1);
+
+    __m128 distance = _mm_setzero_ps();
+    __m128i face = zero_i;
+    __m128 far_plane = _mm_set1_ps(max_distance);
+
+    // Per-lane views of the vectors for the scalar tests
+    PacketFloats lane_dir[3], lane_t_max[3], lane_t_delta[3], lane_distance;
+    PacketInts lane_step[3], lane_map[3], lane_face;
+    PacketInts lane_chunk, lane_offset, lane_brick;
+    lane_dir[0].v = dir_x; lane_dir[1].v = dir_y; lane_dir[2].v = dir_z;
+    lane_t_delta[0].v = t_delta_x; lane_t_delta[1].v = t_delta_y; lane_t_delta[2].v = t_delta_z;
+    lane_step[0].v = step_x; lane_step[1].v = step_y; lane_step[2].v = step_z;
+
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        hits->hit[lane] = 0;
+        hits->distance[lane] = max_distance;
     }
 
-    // Get block type display character
-    BlockType block_type = world_get_block_type(NULL, hit.block_type);
+    int active = _mm_movemask_ps(_mm_cmplt_ps(distance, far_plane));
+    int steps = 0;
+
+    while (active) {
+        steps += (active & 1) + ((active >> 1) & 1) + ((active >> 2) & 1) + (active >> 3);
+        __m128 active_mask = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)lane_masks[active]));
+
+        // Find the closest axis to step along (ties resolve as in cast_ray)
+        __m128 take_x = _mm_and_ps(_mm_cmplt_ps(t_max_x, t_max_y), _mm_cmplt_ps(t_max_x, t_max_z));
+        __m128 take_y = _mm_andnot_ps(take_x, _mm_cmplt_ps(t_max_y, t_max_z));
+        __m128 take_z = _mm_andnot_ps(_mm_or_ps(take_x, take_y), active_mask);
+        take_x = _mm_and_ps(take_x, active_mask);
+        take_y = _mm_and_ps(take_y, active_mask);
+
+        distance = select_ps(take_x, distance, t_max_x);
+        distance = select_ps(take_y, distance, t_max_y);
+        distance = select_ps(take_z, distance, t_max_z);
+        t_max_x = _mm_add_ps(t_max_x, _mm_and_ps(take_x, t_delta_x));
+        t_max_y = _mm_add_ps(t_max_y, _mm_and_ps(take_y, t_delta_y));
+        t_max_z = _mm_add_ps(t_max_z, _mm_and_ps(take_z, t_delta_z));
+
+        __m128i step_mask_x = _mm_castps_si128(take_x);
+        __m128i step_mask_y = _mm_castps_si128(take_y);
+        __m128i step_mask_z = _mm_castps_si128(take_z);
+        map_x = _mm_add_epi32(map_x, _mm_and_si128(step_mask_x, step_x));
+        map_y = _mm_add_epi32(map_y, _mm_and_si128(step_mask_y, step_y));
+        map_z = _mm_add_epi32(map_z, _mm_and_si128(step_mask_z, step_z));
+        face = select_epi32(step_mask_x, face, face_x);
+        face = select_epi32(step_mask_y, face, face_y);
+        face = select_epi32(step_mask_z, face, face_z);
+
+        // Lanes that left the world are done
+        __m128i outside = _mm_or_si128(
+            _mm_or_si128(_mm_cmplt_epi32(map_x, zero_i), _mm_cmpgt_epi32(map_x, last_x)),
+            _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(map_y, zero_i), _mm_cmpgt_epi32(map_y, last_y)),
+                _mm_or_si128(_mm_cmplt_epi32(map_z, zero_i), _mm_cmpgt_epi32(map_z, last_z))));
+        active &= ~_mm_movemask_ps(_mm_castsi128_ps(outside));
+
+        lane_map[0].v = map_x;
+        lane_map[1].v = map_y;
+        lane_map[2].v = map_z;
+        int skipped = 0;
+
+        // Chunk, brick and block addressing for all lanes at once
+        __m128i local_x = _mm_and_si128(map_x, chunk_mask);
+        __m128i local_y = _mm_and_si128(map_y, chunk_mask);
+        __m128i local_z = _mm_and_si128(map_z, chunk_mask);
+        lane_chunk.v = _mm_add_epi32(mullo_epi32(_mm_add_epi32(
+            mullo_epi32(_mm_srai_epi32(map_z, CHUNK_SHIFT), chunks_y), _mm_srai_epi32(map_y, CHUNK_SHIFT)),
+            chunks_x), _mm_srai_epi32(map_x, CHUNK_SHIFT));
+        lane_offset.v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(local_z, 2 * CHUNK_SHIFT),
+            _mm_slli_epi32(local_y, CHUNK_SHIFT)), local_x);
+        lane_brick.v = _mm_add_epi32(_mm_mullo_epi16(_mm_add_epi32(
+            _mm_mullo_epi16(_mm_srli_epi32(local_z, BRICK_SHIFT), bricks_per_axis), _mm_srli_epi32(local_y, BRICK_SHIFT)),
+            bricks_per_axis), _mm_srli_epi32(local_x, BRICK_SHIFT));
+
+        // Park finished lanes on a valid cell so the loads below are safe
+        __m128i live = _mm_loadu_si128((const __m128i*)lane_masks[active]);
+        lane_chunk.v = _mm_and_si128(lane_chunk.v, live);
+        lane_offset.v = _mm_and_si128(lane_offset.v, live);
+
+        // Most steps land in occupied air: test all lanes without branching
+        // and only fall into per-lane work for skips and hits
+        uint64_t lane_occupancy[RAY_PACKET_SIZE];
+        int events = 0;
+        for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+            int chunk = lane_chunk.i[lane];
+            uint64_t occupancy = world->chunk_occupancy[chunk];
+            int empty = !((occupancy >> lane_brick.i[lane]) & 1);
+            int solid = world->chunks[chunk][lane_offset.i[lane]] != BLOCK_AIR;
+            lane_occupancy[lane] = occupancy;
+            events |= (empty | solid) << lane;
+        }
+        events &= active;
+
+        for (int lane = 0; events && lane < RAY_PACKET_SIZE; lane++) {
+            if (!(events & (1 << lane))) continue;
+            events &= ~(1 << lane);
+
+            // Lanes in an empty brick or chunk skip it on their own
+            int chunk = lane_chunk.i[lane];
+            uint64_t occupancy = lane_occupancy[lane];
+            if (!(occupancy & ((uint64_t)1 << lane_brick.i[lane]))) {
+                int skip_size = occupancy ? BRICK_SIZE : CHUNK_SIZE;
+
+                if (!skipped) {
+                    lane_t_max[0].v = t_max_x;
+                    lane_t_max[1].v = t_max_y;
+                    lane_t_max[2].v = t_max_z;
+                }
+                skipped = 1;
+
+                float t_exit = 1e30f;
+                for (int axis = 0; axis < 3; axis++) {
+                    float t_axis = cell_exit_time(skip_size, lane_map[axis].i[lane], lane_step[axis].i[lane],
+                        lane_t_max[axis].f[lane], lane_t_delta[axis].f[lane]);
+                    t_exit = t_axis < t_exit ? t_axis : t_exit;
+                }
+
+                t_exit = t_exit < max_distance ? t_exit : max_distance;
+                for (int axis = 0; axis < 3; axis++) {
+                    skip_axis(skip_size, t_exit, &lane_map[axis].i[lane], lane_step[axis].i[lane],
+                        &lane_t_max[axis].f[lane], lane_t_delta[axis].f[lane]);
+                }
+                continue;
+            }
+
+            // Anything else is a hit
+            lane_distance.v = distance;
+            lane_face.v = face;
+            float hit_distance = lane_distance.f[lane];
+            int hit_face = lane_face.i[lane];
 
-    // Edge detection for better visual definition
-    Vector3 local_pos = hit.position;
-    local_pos.x -= floorf(local_pos.x);
-    local_pos.y -= floorf(local_pos.y);
-    local_pos.z -= floorf(local_pos.z);
+            hits->hit[lane] = 1;
+            hits->block_type[lane] = world->chunks[chunk][lane_offset.i[lane]];
+            hits->distance[lane] = hit_distance;
+            hits->position_x[lane] = position.x + lane_dir[0].f[lane] * hit_distance;
+            hits->position_y[lane] = position.y + lane_dir[1].f[lane] * hit_distance;
+            hits->position_z[lane] = position.z + lane_dir[2].f[lane] * hit_distance;
+            hits->face[lane] = hit_face;
+            hits->brightness[lane] = ray_hit_brightness(world,
+                lane_map[0].i[lane], lane_map[1].i[lane], lane_map[2].i[lane], hit_face);
+            active &= ~(1 << lane);
+        }
+
+        // Pick up the lanes that skipped
+        if (skipped) {
+            t_max_x = lane_t_max[0].v;
+            t_max_y = lane_t_max[1].v;
+            t_max_z = lane_t_max[2].v;
+            map_x = lane_map[0].v;
+            map_y = lane_map[1].v;
+            map_z = lane_map[2].v;
+        }
+
+        active &= _mm_movemask_ps(_mm_cmplt_ps(distance, far_plane));
+    }
+
+    PROFILE_COUNT(PROFILE_RAYS, RAY_PACKET_SIZE);
+    PROFILE_COUNT(PROFILE_DDA_STEPS, steps);
+}
+
+#else
 
-    // Detect edges
-    int on_edge = 0;
-    if (hit.face == 0 || hit.face == 1) { // X faces
-        on_edge = (local_pos.y < EDGE_THRESHOLD || local_pos.y > 1.0f - EDGE_THRESHOLD ||
-            local_pos.z < EDGE_THRESHOLD || local_pos.z > 1.0f - EDGE_THRESHOLD);
+// Scalar fallback: trace the lanes one at a time
+void cast_ray_packet4(World* world, Vector3 position, const Vector3* directions, float max_distance, RayHitPacket* hits) {
+    RayPacketDirs rays;
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        Vector3 dir = vec3_normalize(directions[lane]);
+        rays.dir_x[lane] = dir.x;
+        rays.dir_y[lane] = dir.y;
+        rays.dir_z[lane] = dir.z;
     }
-    else if (hit.face == 2 || hit.face == 3) { // Y faces
-        on_edge = (local_pos.x < EDGE_THRESHOLD || local_pos.x > 1.0f - EDGE_THRESHOLD ||
-            local_pos.z < EDGE_THRESHOLD || local_pos.z > 1.0f - EDGE_THRESHOLD);
+
+    ray_packet_prepare(&rays);
+    cast_ray_packet4_prepared(world, position, &rays, max_distance, hits);
+}
+
+void ray_packet_prepare(RayPacketDirs* rays) {
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        Vector3 inverse = ray_inverse(vec3_create(rays->dir_x[lane], rays->dir_y[lane], rays->dir_z[lane]));
+        rays->inv_x[lane] = inverse.x;
+        rays->inv_y[lane] = inverse.y;
+        rays->inv_z[lane] = inverse.z;
+    }
+}
+
+void cast_ray_packet4_prepared(World* world, Vector3 position, const RayPacketDirs* rays,
+                               float max_distance, RayHitPacket* hits) {
+    for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+        RayHit hit = cast_ray_unit(world, position,
+            vec3_create(rays->dir_x[lane], rays->dir_y[lane], rays->dir_z[lane]),
+            vec3_create(rays->inv_x[lane], rays->inv_y[lane], rays->inv_z[lane]), max_distance);
+        hits->hit[lane] = hit.hit;
+        hits->block_type[lane] = hit.block_type;
+        hits->distance[lane] = hit.distance;
+        hits->position_x[lane] = hit.position.x;
+        hits->position_y[lane] = hit.position.y;
+        hits->position_z[lane] = hit.position.z;
+        hits->face[lane] = hit.face;
+        hits->brightness[lane] = hit.brightness;
+    }
+}
+
+#endif
+
+// Unpack one lane of a packet into a RayHit
+RayHit ray_packet_get_hit(const RayHitPacket* hits, int lane) {
+    RayHit result = { 0 };
+
+    result.hit = hits->hit[lane];
+    result.distance = hits->distance[lane];
+    if (result.hit) {
+        result.block_type = hits->block_type[lane];
+        result.position = vec3_create(hits->position_x[lane], hits->position_y[lane], hits->position_z[lane]);
+        result.normal = face_normals[hits->face[lane]];
+        result.face = hits->face[lane];
+        result.brightness = hits->brightness[lane];
     }
-    else { // Z faces
-        on_edge = (local_pos.x < EDGE_THRESHOLD || local_pos.x > 1.0f - EDGE_THRESHOLD ||
-            local_pos.y < EDGE_THRESHOLD || local_pos.y > 1.0f - EDGE_THRESHOLD);
+
+    return result;
+}
+
+// Recompute the lighting of a stored hit, e.g. after the sky brightness changed
+void ray_hit_relight(World* world, RayHit* hit) {
+    if (!world || !hit || !hit->hit) return;
+
+    // The hit point lies on the face the normal points out of
+    int x = (int)floorf(hit->position.x - hit->normal.x * 0.5f);
+    int y = (int)floorf(hit->position.y - hit->normal.y * 0.5f);
+    int z = (int)floorf(hit->position.z - hit->normal.z * 0.5f);
+    hit->brightness = ray_hit_brightness(world, x, y, z, hit->face);
+}
+
+// Get character to display for a hit
+char get_hit_display_char(const World* world, const RayHit* hit) {
+    if (!hit->hit) {
+        return ' ';
     }
 
+    // Get block type display character
+    char glyph = world ? world_block_glyph(world, hit->block_type)
+                       : world_get_block_type(NULL, hit->block_type).display_char;
+
     // Return either block character or edge character
-    return on_edge ? '#' : block_type.display_char;
+    return ENABLE_EDGES && ray_hit_on_edge(hit) ? '#' : glyph;
 }
 
 // Get color for a hit
-int get_hit_color(RayHit hit) {
-    if (!hit.hit) {
+int get_hit_color(const World* world, const RayHit* hit) {
+    if (!hit->hit) {
         return COLOR_BLACK;
     }
 
-    // Get block type
-    BlockType block_type = world_get_block_type(NULL, hit.block_type);
-
     // Determine color based on brightness
-    int color = block_type.fg_color;
+    int color = world ? world_block_color(world, hit->block_type)
+                      : world_get_block_type(NULL, hit->block_type).fg_color;
 
     // Adjust color based on brightness if shading is enabled
     if (ENABLE_SHADING) {
-        if (hit.brightness < 0.4f) {
+        float brightness = ENABLE_FOG ? clamp(hit->brightness * ray_fog_factor(hit->distance), 0.2f, 1.0f)
+                                      : hit->brightness;
+        if (brightness < 0.4f) {
             color &= ~COLOR_BRIGHT; // Remove brightness
         }
-        else if (hit.brightness > 0.8f) {
+        else if (brightness > 0.8f) {
             color |= COLOR_BRIGHT;  // Add brightness
         }
     }
@@ -7,6 +7,16 @@
 
 #include "vector.h"
 #include "world.h"
+#include <math.h>
+
+// Fog hides the end of the far field when it is on, FAR_PLANE otherwise
+#if RENDER_LOD
+#define RAY_FOG_START RENDER_LOD_FOG_START
+#define RAY_FOG_END RENDER_LOD_FOG_END
+#else
+#define RAY_FOG_START FOG_START
+#define RAY_FOG_END FOG_END
+#endif
 
  // Ray hit information
 typedef struct {
@@ -16,16 +26,98 @@ typedef struct {
     Vector3 position;    // Position of the hit
     Vector3 normal;      // Surface normal at the hit
     int face;            // Face hit (0-5: +x, -x, +y, -y, +z, -z)
-    float brightness;    // Lighting at hit point (0.0-1.0)
+    float brightness;    // Lighting at hit point (0.2-1.0), before fog
+    int coarse;          // Found by cast_ray_far on the heightfield mips
 } RayHit;
 
 // Cast a ray from position in direction
 RayHit cast_ray(World* world, Vector3 position, Vector3 direction, float max_distance);
 
-// Get the character to display for a hit
-char get_hit_display_char(RayHit hit);
+// Cast along a unit direction whose reciprocals (ray_inverse) are already known
+RayHit cast_ray_unit(World* world, Vector3 position, Vector3 direction, Vector3 inverse, float max_distance);
+
+// Continue a unit-direction ray that found nothing up to start across the
+// world's heightfield mips, up to max_distance. Each mip level covers twice
+// the distance of the one before: columns from start, 2x2 groups from twice
+// start and so on. Overhangs and caves are filled in, so use it only past
+// the distance the voxels are traced to.
+RayHit cast_ray_far(World* world, Vector3 position, Vector3 direction, float start, float max_distance);
+
+// Reciprocal of each component's magnitude, 1e30 for a zero component
+Vector3 ray_inverse(Vector3 direction);
+
+// Number of rays traced together by cast_ray_packet4
+#define RAY_PACKET_SIZE 4
+
+// Hits for a packet of rays, one array entry per lane
+typedef struct {
+    int hit[RAY_PACKET_SIZE];
+    int block_type[RAY_PACKET_SIZE];
+    float distance[RAY_PACKET_SIZE];
+    float position_x[RAY_PACKET_SIZE];
+    float position_y[RAY_PACKET_SIZE];
+    float position_z[RAY_PACKET_SIZE];
+    int face[RAY_PACKET_SIZE];
+    float brightness[RAY_PACKET_SIZE];
+} RayHitPacket;
+
+// Cast RAY_PACKET_SIZE rays from one position (SSE2 where available).
+// Every lane produces exactly what cast_ray would for its direction.
+void cast_ray_packet4(World* world, Vector3 position, const Vector3* directions, float max_distance, RayHitPacket* hits);
+
+// Unit directions of a packet with the reciprocal of each component's
+// magnitude (1e30 for a zero component), so casting skips normalization
+// and division. Lanes are stored per axis for the SSE loads.
+typedef struct {
+    float dir_x[RAY_PACKET_SIZE];
+    float dir_y[RAY_PACKET_SIZE];
+    float dir_z[RAY_PACKET_SIZE];
+    float inv_x[RAY_PACKET_SIZE];
+    float inv_y[RAY_PACKET_SIZE];
+    float inv_z[RAY_PACKET_SIZE];
+} RayPacketDirs;
+
+// Fill in the reciprocals of a packet whose unit directions are set
+void ray_packet_prepare(RayPacketDirs* rays);
+
+// Cast a prepared packet; the same hits cast_ray_packet4 gives for the same unit directions
+void cast_ray_packet4_prepared(World* world, Vector3 position, const RayPacketDirs* rays,
+                               float max_distance, RayHitPacket* hits);
+
+// Unpack one lane of a packet
+RayHit ray_packet_get_hit(const RayHitPacket* hits, int lane);
+
+// Recompute the lighting of a stored hit from the world's current light
+void ray_hit_relight(World* world, RayHit* hit);
+
+// Share of a hit's brightness left by fog at a distance
+static inline float ray_fog_factor(float distance) {
+    float fog = fminf(fmaxf((distance - RAY_FOG_START) / (RAY_FOG_END - RAY_FOG_START), 0.0f), 1.0f);
+    return 1.0f - fog * 0.8f;
+}
+
+// Whether a hit lies within EDGE_THRESHOLD of its face's outline; never
+// for far-field hits, whose cells are smaller than their outlines
+static inline int ray_hit_on_edge(const RayHit* hit) {
+    // The two axes across each face's axis
+    static const int across[3][2] = { { 1, 2 }, { 0, 2 }, { 0, 1 } };
+    float local[3] = {
+        hit->position.x - floorf(hit->position.x),
+        hit->position.y - floorf(hit->position.y),
+        hit->position.z - floorf(hit->position.z)
+    };
+    float u = local[across[hit->face >> 1][0]];
+    float v = local[across[hit->face >> 1][1]];
+
+    return ((u < EDGE_THRESHOLD) | (u > 1.0f - EDGE_THRESHOLD) |
+        (v < EDGE_THRESHOLD) | (v > 1.0f - EDGE_THRESHOLD)) & !hit->coarse;
+}
+
+// Get the character to display for a hit with the default options (see
+// ENABLE_EDGES), from the world's block types (the defaults when world is NULL)
+char get_hit_display_char(const World* world, const RayHit* hit);
 
-// Get the color code for a hit
-int get_hit_color(RayHit hit);
+// Get the color code for a hit with the default options (see ENABLE_SHADING and ENABLE_FOG)
+int get_hit_color(const World* world, const RayHit* hit);
 
 #endif /* RAYCASTER_H */
@@ -15,72 +15,307 @@
 #include "config.h"
 #include "terminal.h"
 #include "raycaster.h"
+#include "profiler.h"
+#include "thread.h"
+#include "utils.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
 
-// Create a new renderer
-Renderer* renderer_create(int width, int height) {
-    Renderer* renderer = (Renderer*)malloc(sizeof(Renderer));
-    if (!renderer) return NULL;
+// SSE2 is part of every x64 target and the MSVC x86 default
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RENDERER_SSE2 1
+#include <emmintrin.h>
+#else
+#define RENDERER_SSE2 0
+#endif
 
-    // Set dimensions
-    renderer->width = width;
-    renderer->height = height;
+typedef struct RenderPass RenderPass;
+
+// Shading kernel: writes one cell from a ray hit, or the sky when it missed
+typedef void (*RenderShadeKernel)(const RenderPass* pass, int x, int y, const RayHit* hit);
+
+// Per-frame state shared by all render tasks
+struct RenderPass {
+    Renderer* renderer;
+    World* world;
+    RenderCamera camera;
+    float aspect_ratio;
+    RenderShadeKernel shade;  // Kernel for the frame's options
+    int sky_upper;            // Sky background above and below the middle row
+    int sky_lower;
+    int subsample_level;      // Which cells are traced this frame, see renderer_cell_traced
+    int subsample_phase;
+    int reuse;                // Camera is still: trace only cells whose cached hit is not current
+    int highlight;            // Whether the player's targeted block is highlighted
+    int highlight_x, highlight_y, highlight_z;
+    uint8_t highlight_type;
+};
+
+// Cached hit state of a cell
+enum {
+    RENDER_CELL_STALE,        // Not traced since the camera last moved
+    RENDER_CELL_CACHED,       // hit_cache holds what a ray would hit now
+    RENDER_CELL_DIRTY         // A block change may show here; trace this frame
+};
+
+// Order in which the cells of a 2x2 block are traced at quarter resolution,
+// so consecutive frames sample diagonally opposite cells
+static const int renderer_quarter_order[4] = { 0, 3, 1, 2 };
+
+// Resolve a requested thread count (0 = one per CPU)
+static int renderer_resolve_thread_count(int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = thread_cpu_count();
+    }
+    return thread_count < 1 ? 1 : thread_count;
+}
+
+// Round a plane size up to the framebuffer alignment
+static size_t framebuffer_plane_size(int cells) {
+    return ((size_t)cells + FRAMEBUFFER_ALIGN - 1) & ~(size_t)(FRAMEBUFFER_ALIGN - 1);
+}
+
+// Create a framebuffer
+static Framebuffer* framebuffer_create(int width, int height) {
+    Framebuffer* fb = (Framebuffer*)malloc(sizeof(Framebuffer));
+    if (!fb) return NULL;
 
-    // Create framebuffer
-    renderer->framebuffer = (Framebuffer*)malloc(sizeof(Framebuffer));
-    if (!renderer->framebuffer) {
-        free(renderer);
+    fb->width = width;
+    fb->height = height;
+
+    // Both planes share one allocation, each starting on an aligned boundary
+    size_t plane = framebuffer_plane_size(width * height);
+    fb->storage = malloc(2 * plane + FRAMEBUFFER_ALIGN - 1);
+    if (!fb->storage) {
+        free(fb);
         return NULL;
     }
 
-    // Initialize framebuffer
-    renderer->framebuffer->width = width;
-    renderer->framebuffer->height = height;
-    renderer->framebuffer->char_buffer = (char*)malloc(width * height * sizeof(char));
-    renderer->framebuffer->fg_color_buffer = (int*)malloc(width * height * sizeof(int));
-    renderer->framebuffer->bg_color_buffer = (int*)malloc(width * height * sizeof(int));
+    uintptr_t base = ((uintptr_t)fb->storage + FRAMEBUFFER_ALIGN - 1) & ~(uintptr_t)(FRAMEBUFFER_ALIGN - 1);
+    fb->char_buffer = (char*)base;
+    fb->attr_buffer = (uint8_t*)(base + plane);
 
-    // Check allocations
-    if (!renderer->framebuffer->char_buffer ||
-        !renderer->framebuffer->fg_color_buffer ||
-        !renderer->framebuffer->bg_color_buffer) {
-        renderer_destroy(renderer);
-        return NULL;
+    return fb;
+}
+
+// Destroy a framebuffer
+static void framebuffer_destroy(Framebuffer* fb) {
+    if (!fb) return;
+
+    free(fb->storage);
+    free(fb);
+}
+
+// Copy both planes of a framebuffer of the same size
+static void framebuffer_copy(Framebuffer* dst, const Framebuffer* src) {
+    size_t cells = (size_t)src->width * src->height;
+    memcpy(dst->char_buffer, src->char_buffer, cells);
+    memcpy(dst->attr_buffer, src->attr_buffer, cells);
+}
+
+// Fill a depth plane with RENDER_DEPTH_FAR
+static void renderer_fill_depth(RenderDepth* depth, int count) {
+#if RENDER_DEPTH_16BIT
+    // 0xFFFF is all one bytes
+    memset(depth, 0xFF, count * sizeof(RenderDepth));
+#elif RENDERER_SSE2
+    __m128 far_plane = _mm_set1_ps(INFINITY);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        _mm_storeu_ps(depth + i, far_plane);
+        _mm_storeu_ps(depth + i + 4, far_plane);
+        _mm_storeu_ps(depth + i + 8, far_plane);
+        _mm_storeu_ps(depth + i + 12, far_plane);
+    }
+    for (; i < count; i++) {
+        depth[i] = INFINITY;
     }
+#else
+    for (int i = 0; i < count; i++) {
+        depth[i] = INFINITY;
+    }
+#endif
+}
+
+// Fill the camera-space ray table: the unit view ray through every cell as
+// forward, right and up components. It only depends on the screen size, so
+// a frame rotates it into the world instead of building and normalizing rays.
+static void renderer_build_ray_table(Renderer* renderer) {
+    int width = renderer->width;
+    int height = renderer->height;
+    int cells = width * height;
+    float aspect_ratio = (float)width / height;
+    float* forward = renderer->ray_table;
+    float* right = forward + cells;
+    float* up = right + cells;
+
+    for (int y = 0; y < height; y++) {
+        float screen_y = (1.0f - 2.0f * y / height) * FOV_VERTICAL;
+        for (int x = 0; x < width; x++) {
+            float screen_x = (2.0f * x / width - 1.0f) * aspect_ratio * FOV_HORIZONTAL;
+            float inverse_length = 1.0f / sqrtf(1.0f + screen_x * screen_x + screen_y * screen_y);
+
+            int index = y * width + x;
+            forward[index] = inverse_length;
+            right[index] = screen_x * inverse_length;
+            up[index] = screen_y * inverse_length;
+        }
+    }
+}
+
+// Carve a framebuffer and its planes out of an arena
+static Framebuffer* framebuffer_carve(Arena* arena, int width, int height) {
+    Framebuffer* fb = (Framebuffer*)arena_alloc(arena, sizeof(Framebuffer));
+    if (!fb) return NULL;
+
+    // Arena pieces start on (and are padded to) FRAMEBUFFER_ALIGN as well
+    size_t plane = framebuffer_plane_size(width * height);
+    fb->width = width;
+    fb->height = height;
+    fb->char_buffer = (char*)arena_alloc(arena, plane);
+    fb->attr_buffer = (uint8_t*)arena_alloc(arena, plane);
+    fb->storage = NULL;
+    return fb->char_buffer && fb->attr_buffer ? fb : NULL;
+}
+
+// Arena bytes renderer_carve_buffers takes for a screen size
+static size_t renderer_arena_bytes(int width, int height) {
+    size_t cells = (size_t)width * height;
+    size_t framebuffer = arena_align(sizeof(Framebuffer)) + 2 * arena_align(framebuffer_plane_size(width * height));
+    return 3 * framebuffer +
+        2 * arena_align(cells * sizeof(RenderDepth)) +
+        arena_align(cells * sizeof(RayHit)) +
+        arena_align(cells * sizeof(uint8_t)) +
+        arena_align(3 * cells * sizeof(float));
+}
 
-    // Create depth buffer
-    renderer->depth_buffer = (float*)malloc(width * height * sizeof(float));
-    if (!renderer->depth_buffer) {
+// Lay out every per-cell buffer in the renderer's arena (returns 0 when it
+// is too small)
+static int renderer_carve_buffers(Renderer* renderer, int width, int height) {
+    Arena* arena = &renderer->arena;
+    size_t cells = (size_t)width * height;
+    arena_reset(arena);
+
+    // Frame being drawn, copy of the presented frame for diffing, and the
+    // history for reprojection
+    renderer->framebuffer = framebuffer_carve(arena, width, height);
+    renderer->presented = framebuffer_carve(arena, width, height);
+    renderer->history = framebuffer_carve(arena, width, height);
+
+    // Depth buffers
+    renderer->depth_buffer = (RenderDepth*)arena_alloc(arena, cells * sizeof(RenderDepth));
+    renderer->history_depth = (RenderDepth*)arena_alloc(arena, cells * sizeof(RenderDepth));
+
+    // Per-cell hit cache
+    renderer->hit_cache = (RayHit*)arena_alloc(arena, cells * sizeof(RayHit));
+    renderer->cell_state = (uint8_t*)arena_alloc(arena, cells * sizeof(uint8_t));
+
+    // Camera-space ray table
+    renderer->ray_table = (float*)arena_alloc(arena, 3 * cells * sizeof(float));
+
+    return renderer->framebuffer && renderer->presented && renderer->history &&
+        renderer->depth_buffer && renderer->history_depth && renderer->hit_cache &&
+        renderer->cell_state && renderer->ray_table;
+}
+
+// Allocate a renderer with its buffers and default options, without workers
+static Renderer* renderer_alloc(int width, int height) {
+    Renderer* renderer = (Renderer*)calloc(1, sizeof(Renderer));
+    if (!renderer) return NULL;
+
+    // Per-cell buffers and per-frame text
+    if (!arena_init(&renderer->scratch, RENDER_SCRATCH_BYTES) || !renderer_resize(renderer, width, height)) {
         renderer_destroy(renderer);
         return NULL;
     }
 
+    renderer->present_bytes = 0;
+    renderer->present_cells = 0;
+    renderer->adaptive_resolution = RENDER_ADAPTIVE_RESOLUTION;
+    renderer->subsample_level = 0;
+    renderer->frame_index = 0;
+    renderer->ray_cost_us = 0.0f;
+    renderer->reproject_cost_us = 0.0f;
+
     // Set default options
     renderer->draw_hud = 1;
     renderer->draw_debug = 0;
-    renderer->wireframe_mode = 0;
+    renderer->options = RENDER_DEFAULT_OPTIONS;
     renderer->show_minimap = 1;
+    renderer->minimap.zoom = 0;
+    renderer->minimap.valid = 0;
+    renderer->thread_count = RENDER_THREADS;
+
+    return renderer;
+}
+
+// Create a new renderer
+Renderer* renderer_create(int width, int height) {
+    Renderer* renderer = renderer_alloc(width, height);
+    if (!renderer) return NULL;
+
+    // Start render workers (a failed pool just means serial rendering)
+    renderer->owns_thread_pool = 1;
+    if (renderer_resolve_thread_count(renderer->thread_count) > 1) {
+        renderer->thread_pool = threadpool_create(renderer_resolve_thread_count(renderer->thread_count));
+    }
 
     return renderer;
 }
 
+// Create a renderer that draws with a pool the caller owns (NULL = serial)
+Renderer* renderer_create_shared(int width, int height, ThreadPool* pool) {
+    Renderer* renderer = renderer_alloc(width, height);
+    if (!renderer) return NULL;
+
+    renderer->thread_pool = pool;
+    renderer->owns_thread_pool = 0;
+    return renderer;
+}
+
+// Change the screen size. Shrinking, or growing back within the largest
+// size so far, reuses the arena; only a larger size allocates.
+int renderer_resize(Renderer* renderer, int width, int height) {
+    if (!renderer || width <= 0 || height <= 0) return 0;
+
+    size_t bytes = renderer_arena_bytes(width, height);
+    if (bytes > renderer->arena.capacity) {
+        // Keep the current buffers if the larger arena cannot be had
+        Arena grown;
+        if (!arena_init(&grown, bytes)) return 0;
+        arena_release(&renderer->arena);
+        renderer->arena = grown;
+    }
+
+    if (!renderer_carve_buffers(renderer, width, height)) return 0;
+    renderer->width = width;
+    renderer->height = height;
+    renderer_build_ray_table(renderer);
+
+    // Nothing drawn at the old size carries over
+    renderer->presented_valid = 0;
+    renderer->history_valid = 0;
+    renderer->world_settled = 0;
+    renderer->cache_world = NULL;
+    renderer->cache_generation = 0;
+    renderer->cache_light_epoch = 0;
+    renderer->cache_options = renderer->options;
+    renderer->highlight_valid = 0;
+    return 1;
+}
+
 // Destroy a renderer
 void renderer_destroy(Renderer* renderer) {
     if (!renderer) return;
 
-    // Free framebuffer
-    if (renderer->framebuffer) {
-        free(renderer->framebuffer->char_buffer);
-        free(renderer->framebuffer->fg_color_buffer);
-        free(renderer->framebuffer->bg_color_buffer);
-        free(renderer->framebuffer);
-    }
+    // Stop render workers
+    if (renderer->owns_thread_pool) threadpool_destroy(renderer->thread_pool);
 
-    // Free depth buffer
-    free(renderer->depth_buffer);
+    // Free the per-cell buffers and the frame scratch
+    arena_release(&renderer->arena);
+    arena_release(&renderer->scratch);
 
     // Free renderer
     free(renderer);
@@ -90,21 +325,511 @@ void renderer_destroy(Renderer* renderer) {
 void renderer_clear(Renderer* renderer) {
     if (!renderer) return;
 
+    // Last frame's text is no longer shown
+    arena_reset(&renderer->scratch);
+
     // Clear framebuffer
     Framebuffer* fb = renderer->framebuffer;
     memset(fb->char_buffer, ' ', fb->width * fb->height * sizeof(char));
-    memset(fb->fg_color_buffer, COLOR_WHITE, fb->width * fb->height * sizeof(int));
-    memset(fb->bg_color_buffer, COLOR_BLACK, fb->width * fb->height * sizeof(int));
+    memset(fb->attr_buffer, COLOR_ATTR(COLOR_WHITE, COLOR_BLACK), fb->width * fb->height * sizeof(uint8_t));
 
     // Clear depth buffer
-    for (int i = 0; i < renderer->width * renderer->height; i++) {
-        renderer->depth_buffer[i] = INFINITY;
+    renderer_fill_depth(renderer->depth_buffer, renderer->width * renderer->height);
+}
+
+// Whether a hit lies on the highlighted block
+static inline int renderer_hit_highlighted(const RenderPass* pass, const RayHit* hit) {
+    if (!pass->highlight || hit->block_type != pass->highlight_type) return 0;
+
+    // The hit point lies on the face the normal points out of
+    return (int)floorf(hit->position.x - hit->normal.x * 0.5f) == pass->highlight_x &&
+        (int)floorf(hit->position.y - hit->normal.y * 0.5f) == pass->highlight_y &&
+        (int)floorf(hit->position.z - hit->normal.z * 0.5f) == pass->highlight_z;
+}
+
+// Write one cell from a ray hit (or the sky when it missed). Always called
+// with constant options, so each kernel below keeps only its own path.
+static inline void renderer_shade_cell(const RenderPass* pass, int x, int y, const RayHit* hit, const int options) {
+    Renderer* renderer = pass->renderer;
+    int index = y * renderer->width + x;
+
+    // Sky gradient (colors picked for the frame)
+    if (!hit->hit) {
+        renderer->framebuffer->char_buffer[index] = ' ';
+        renderer->framebuffer->attr_buffer[index] =
+            COLOR_ATTR(COLOR_BLACK, 2 * y < renderer->height ? pass->sky_upper : pass->sky_lower);
+        return;
+    }
+
+    // Check depth buffer
+    RenderDepth depth = render_depth_encode(hit->distance);
+    if (depth >= renderer->depth_buffer[index]) return;
+    renderer->depth_buffer[index] = depth;
+
+    // Block glyph, outlined, or only the outline
+    char glyph = world_block_glyph(pass->world, (uint8_t)hit->block_type);
+    if (options & (RENDER_OPTION_EDGES | RENDER_OPTION_WIREFRAME)) {
+        char face = (options & RENDER_OPTION_WIREFRAME) && !hit->coarse ? ' ' : glyph;
+        glyph = ray_hit_on_edge(hit) ? '#' : face;
     }
+
+    // Block color, brightened or darkened by the light (and the fog)
+    int fg_color = (options & RENDER_OPTION_COLORS) ? world_block_color(pass->world, (uint8_t)hit->block_type)
+                                                    : COLOR_WHITE;
+    if (options & RENDER_OPTION_SHADING) {
+        float brightness = hit->brightness;
+        if (options & RENDER_OPTION_FOG) {
+            brightness = clamp(brightness * ray_fog_factor(hit->distance), 0.2f, 1.0f);
+        }
+        fg_color = brightness < 0.4f ? fg_color & ~COLOR_BRIGHT :
+            brightness > 0.8f ? fg_color | COLOR_BRIGHT : fg_color;
+    }
+
+    int bg_color = renderer_hit_highlighted(pass, hit) ? RENDER_HIGHLIGHT_BG : COLOR_BLACK;
+    renderer->framebuffer->char_buffer[index] = glyph;
+    renderer->framebuffer->attr_buffer[index] = COLOR_ATTR(fg_color, bg_color);
 }
 
-// Render the world
-void renderer_render_world(Renderer* renderer, World* world, Player* player) {
-    if (!renderer || !world || !player) return;
+// One kernel per combination of options. RENDER_KERNELS(M) expands M(name,
+// options) for every combination in order, building each name from the
+// options' bits (renderer_shade_01101 has options 0x0D).
+#define RENDER_KERNELS_1(M, name, value) M(name##0, (value) * 2) M(name##1, (value) * 2 + 1)
+#define RENDER_KERNELS_2(M, name, value) RENDER_KERNELS_1(M, name##0, (value) * 2) RENDER_KERNELS_1(M, name##1, (value) * 2 + 1)
+#define RENDER_KERNELS_3(M, name, value) RENDER_KERNELS_2(M, name##0, (value) * 2) RENDER_KERNELS_2(M, name##1, (value) * 2 + 1)
+#define RENDER_KERNELS_4(M, name, value) RENDER_KERNELS_3(M, name##0, (value) * 2) RENDER_KERNELS_3(M, name##1, (value) * 2 + 1)
+#define RENDER_KERNELS_5(M, name, value) RENDER_KERNELS_4(M, name##0, (value) * 2) RENDER_KERNELS_4(M, name##1, (value) * 2 + 1)
+#define RENDER_KERNELS(M) RENDER_KERNELS_5(M, renderer_shade_, 0)
+
+#define RENDER_DEFINE_KERNEL(name, options) \
+    static void name(const RenderPass* pass, int x, int y, const RayHit* hit) { \
+        renderer_shade_cell(pass, x, y, hit, options); \
+    }
+#define RENDER_KERNEL_ENTRY(name, options) name,
+
+RENDER_KERNELS(RENDER_DEFINE_KERNEL)
+
+static const RenderShadeKernel renderer_shade_kernels[1 << RENDER_OPTION_BITS] = {
+    RENDER_KERNELS(RENDER_KERNEL_ENTRY)
+};
+
+// Whether a cell is ray traced this frame; the others are reprojected
+static inline int renderer_cell_traced(const RenderPass* pass, int x, int y) {
+    switch (pass->subsample_level) {
+    case 0:
+        return 1;
+    case 1:
+        // Checkerboard, alternating every frame
+        return ((x + y + pass->subsample_phase) & 1) == 0;
+    default:
+        // One cell of every 2x2 block, cycling over four frames
+        return ((x & 1) | ((y & 1) << 1)) == renderer_quarter_order[pass->subsample_phase & 3];
+    }
+}
+
+// Whether a cell gets a ray this frame
+static inline int renderer_cell_cast(const RenderPass* pass, int x, int y) {
+    if (!pass->reuse) return renderer_cell_traced(pass, x, y);
+
+    uint8_t state = pass->renderer->cell_state[y * pass->renderer->width + x];
+    return state == RENDER_CELL_DIRTY || (state == RENDER_CELL_STALE && renderer_cell_traced(pass, x, y));
+}
+
+// Keep a traced hit for later frames and draw it. A ray that found no
+// voxel within FAR_PLANE goes on across the heightfield mips first.
+static void renderer_store_hit(RenderPass* pass, int x, int y, RayHit* hit, Vector3 direction) {
+    if (RENDER_LOD && !hit->hit) {
+        *hit = cast_ray_far(pass->world, pass->camera.position, direction, FAR_PLANE, RENDER_LOD_DISTANCE);
+    }
+
+    int index = y * pass->renderer->width + x;
+    pass->renderer->hit_cache[index] = *hit;
+    pass->renderer->cell_state[index] = RENDER_CELL_CACHED;
+    pass->shade(pass, x, y, hit);
+}
+
+// Render a band of framebuffer rows
+static void renderer_render_rows(RenderPass* pass, int y_start, int y_end) {
+    Renderer* renderer = pass->renderer;
+    World* world = pass->world;
+    const RenderCamera* camera = &pass->camera;
+    Vector3 camera_pos = camera->position;
+
+    // Get screen dimensions
+    int screen_width = renderer->width;
+    int cells = screen_width * renderer->height;
+    const float* table_forward = renderer->ray_table;
+    const float* table_right = table_forward + cells;
+    const float* table_up = table_right + cells;
+
+    // Render each pixel
+    for (int y = y_start; y < y_end; y++) {
+        RayPacketDirs rays;
+        int xs[RAY_PACKET_SIZE];
+        int x = 0;
+
+        while (x < screen_width) {
+            // Neighbouring traced cells are traced together as one packet
+            int max_count = RENDER_RAY_PACKETS ? RAY_PACKET_SIZE : 1;
+            int count = 0;
+            for (; x < screen_width && count < max_count; x++) {
+                if (renderer_cell_cast(pass, x, y)) {
+                    // Rotate the camera-space ray into the world; the basis is
+                    // orthonormal, so the ray stays unit length
+                    int index = y * screen_width + x;
+                    float f = table_forward[index];
+                    float r = table_right[index];
+                    float u = table_up[index];
+                    rays.dir_x[count] = f * camera->forward.x + r * camera->right.x + u * camera->up.x;
+                    rays.dir_y[count] = f * camera->forward.y + r * camera->right.y + u * camera->up.y;
+                    rays.dir_z[count] = f * camera->forward.z + r * camera->right.z + u * camera->up.z;
+                    xs[count] = x;
+                    count++;
+                }
+            }
+
+            // Cast rays
+            if (count == RAY_PACKET_SIZE) {
+                RayHitPacket hits;
+                ray_packet_prepare(&rays);
+                cast_ray_packet4_prepared(world, camera_pos, &rays, FAR_PLANE, &hits);
+
+                for (int lane = 0; lane < RAY_PACKET_SIZE; lane++) {
+                    RayHit hit = ray_packet_get_hit(&hits, lane);
+                    Vector3 dir = vec3_create(rays.dir_x[lane], rays.dir_y[lane], rays.dir_z[lane]);
+                    renderer_store_hit(pass, xs[lane], y, &hit, dir);
+                }
+            }
+            else {
+                for (int lane = 0; lane < count; lane++) {
+                    Vector3 dir = vec3_create(rays.dir_x[lane], rays.dir_y[lane], rays.dir_z[lane]);
+                    RayHit hit = cast_ray_unit(world, camera_pos, dir, ray_inverse(dir), FAR_PLANE);
+                    renderer_store_hit(pass, xs[lane], y, &hit, dir);
+                }
+            }
+        }
+    }
+}
+
+// Unnormalized view ray through (0, y) and its step per cell along the row
+static void renderer_row_ray(const RenderCamera* camera, float aspect_ratio,
+                             int screen_width, int screen_height, int y,
+                             Vector3* start, Vector3* step) {
+    float scale_x = aspect_ratio * FOV_HORIZONTAL;
+    float screen_y = (1.0f - 2.0f * y / screen_height) * FOV_VERTICAL;
+    float step_x = 2.0f / screen_width * scale_x;
+
+    start->x = camera->forward.x - scale_x * camera->right.x + screen_y * camera->up.x;
+    start->y = camera->forward.y - scale_x * camera->right.y + screen_y * camera->up.y;
+    start->z = camera->forward.z - scale_x * camera->right.z + screen_y * camera->up.z;
+    step->x = step_x * camera->right.x;
+    step->y = step_x * camera->right.y;
+    step->z = step_x * camera->right.z;
+}
+
+// Express a vector in a camera basis (forward, right, up)
+static Vector3 renderer_to_camera(const RenderCamera* camera, Vector3 v) {
+    return vec3_create(vec3_dot(v, camera->forward), vec3_dot(v, camera->right), vec3_dot(v, camera->up));
+}
+
+// Screen cell of a camera-space offset. Returns 0 when it is behind the
+// camera or off screen.
+static int renderer_project(const RenderPass* pass, float forward, float right, float up, int* out_x, int* out_y) {
+    if (forward <= 0.01f) return 0;
+
+    Renderer* renderer = pass->renderer;
+    float inverse = 1.0f / forward;
+    float screen_x = right * inverse / (pass->aspect_ratio * FOV_HORIZONTAL);
+    float screen_y = up * inverse / FOV_VERTICAL;
+    int x = (int)floorf((screen_x + 1.0f) * 0.5f * renderer->width + 0.5f);
+    int y = (int)floorf((1.0f - screen_y) * 0.5f * renderer->height + 0.5f);
+    if (x < 0 || y < 0 || x >= renderer->width || y >= renderer->height) return 0;
+
+    *out_x = x;
+    *out_y = y;
+    return 1;
+}
+
+// Fill the cells that were not traced this frame from the previous frame.
+// Surfaces in the history are moved to where the current camera sees them,
+// nearest first; cells nothing lands on take a traced neighbour, or the sky
+// when they looked at the sky last frame. Rays are stepped along each row and
+// kept in the current camera's basis, so a cell costs a couple of square
+// roots and no vector calls.
+static void renderer_reproject(RenderPass* pass) {
+    Renderer* renderer = pass->renderer;
+    Framebuffer* fb = renderer->framebuffer;
+    Framebuffer* history = renderer->history;
+    const RenderCamera* camera = &pass->camera;
+    const RenderCamera* previous = &renderer->history_camera;
+    int width = renderer->width;
+    int height = renderer->height;
+
+    // A still camera sees last frame's image unchanged
+    if (memcmp(camera, previous, sizeof(RenderCamera)) == 0) {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                int index = y * width + x;
+                if (renderer_cell_traced(pass, x, y)) continue;
+
+                renderer->depth_buffer[index] = renderer->history_depth[index];
+                fb->char_buffer[index] = history->char_buffer[index];
+                fb->attr_buffer[index] = history->attr_buffer[index];
+            }
+        }
+        return;
+    }
+
+    // Previous camera position relative to the current one
+    Vector3 origin = renderer_to_camera(camera, vec3_sub(previous->position, camera->position));
+
+    // Scatter the surfaces seen last frame
+    for (int y = 0; y < height; y++) {
+        Vector3 start, step;
+        renderer_row_ray(previous, pass->aspect_ratio, width, height, y, &start, &step);
+        Vector3 world_ray = start;
+        Vector3 ray = renderer_to_camera(camera, start);
+        Vector3 ray_step = renderer_to_camera(camera, step);
+
+        for (int x = 0; x < width; x++, world_ray = vec3_add(world_ray, step), ray = vec3_add(ray, ray_step)) {
+            int source = y * width + x;
+            RenderDepth stored = renderer->history_depth[source];
+            if (stored == RENDER_DEPTH_FAR) continue;
+            float depth = render_depth_decode(stored);
+
+            // Hit point relative to the current camera
+            float t = depth / sqrtf(world_ray.x * world_ray.x + world_ray.y * world_ray.y + world_ray.z * world_ray.z);
+            float forward = origin.x + ray.x * t;
+            float right = origin.y + ray.y * t;
+            float up = origin.z + ray.z * t;
+
+            int tx, ty;
+            if (!renderer_project(pass, forward, right, up, &tx, &ty)) continue;
+            if (renderer_cell_traced(pass, tx, ty)) continue;
+
+            int target = ty * width + tx;
+            RenderDepth target_depth = render_depth_encode(sqrtf(forward * forward + right * right + up * up));
+            if (target_depth < renderer->depth_buffer[target]) {
+                renderer->depth_buffer[target] = target_depth;
+                fb->char_buffer[target] = history->char_buffer[source];
+                fb->attr_buffer[target] = history->attr_buffer[source];
+            }
+        }
+    }
+
+    // Fill the holes (disocclusions, magnified surfaces and sky)
+    static const int neighbours[8][2] = {
+        { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 }, { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 }
+    };
+    RayHit miss;
+    memset(&miss, 0, sizeof(miss));
+
+    for (int y = 0; y < height; y++) {
+        Vector3 start, step;
+        renderer_row_ray(camera, pass->aspect_ratio, width, height, y, &start, &step);
+
+        for (int x = 0; x < width; x++) {
+            int index = y * width + x;
+            if (renderer->depth_buffer[index] != RENDER_DEPTH_FAR || renderer_cell_traced(pass, x, y)) continue;
+
+            // Sky last frame stays sky: look up where this direction was on screen
+            Vector3 ray = renderer_to_camera(previous, vec3_add(start, vec3_mul(step, (float)x)));
+            int px, py;
+            if (renderer_project(pass, ray.x, ray.y, ray.z, &px, &py) &&
+                renderer->history_depth[py * width + px] == RENDER_DEPTH_FAR) {
+                pass->shade(pass, x, y, &miss);
+                continue;
+            }
+
+            // Otherwise copy the nearest traced surface next to it
+            int best = -1;
+            for (int n = 0; n < 8; n++) {
+                int nx = x + neighbours[n][0];
+                int ny = y + neighbours[n][1];
+                if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+                if (!renderer_cell_traced(pass, nx, ny)) continue;
+
+                int candidate = ny * width + nx;
+                if (renderer->depth_buffer[candidate] == RENDER_DEPTH_FAR) continue;
+                if (best < 0 || renderer->depth_buffer[candidate] < renderer->depth_buffer[best]) {
+                    best = candidate;
+                }
+            }
+
+            if (best < 0) {
+                pass->shade(pass, x, y, &miss);
+                continue;
+            }
+            renderer->depth_buffer[index] = renderer->depth_buffer[best];
+            fb->char_buffer[index] = fb->char_buffer[best];
+            fb->attr_buffer[index] = fb->attr_buffer[best];
+        }
+    }
+}
+
+// Mark the cells a box of blocks may cover. Returns 0 when the box cannot
+// be bounded on screen because it reaches behind the camera.
+static int renderer_mark_box(RenderPass* pass, const WorldEdit* box) {
+    Renderer* renderer = pass->renderer;
+    const RenderCamera* camera = &pass->camera;
+
+    // Screen bounds of the box corners
+    int min_x = renderer->width, min_y = renderer->height, max_x = -1, max_y = -1;
+    for (int corner = 0; corner < 8; corner++) {
+        Vector3 point = vec3_create(
+            (float)((corner & 1) ? box->x1 + 1 : box->x0),
+            (float)((corner & 2) ? box->y1 + 1 : box->y0),
+            (float)((corner & 4) ? box->z1 + 1 : box->z0));
+        Vector3 view = renderer_to_camera(camera, vec3_sub(point, camera->position));
+        if (view.x <= 0.01f) return 0;
+
+        float screen_x = view.y / view.x / (pass->aspect_ratio * FOV_HORIZONTAL);
+        float screen_y = view.z / view.x / FOV_VERTICAL;
+        float fx = (screen_x + 1.0f) * 0.5f * renderer->width;
+        float fy = (1.0f - screen_y) * 0.5f * renderer->height;
+
+        // Clamp before converting so far-off corners cannot overflow
+        fx = clamp(fx, -2.0f, renderer->width + 1.0f);
+        fy = clamp(fy, -2.0f, renderer->height + 1.0f);
+        min_x = min_int(min_x, (int)floorf(fx) - 1);
+        min_y = min_int(min_y, (int)floorf(fy) - 1);
+        max_x = max_int(max_x, (int)ceilf(fx) + 1);
+        max_y = max_int(max_y, (int)ceilf(fy) + 1);
+    }
+
+    min_x = max_int(min_x, 0);
+    min_y = max_int(min_y, 0);
+    max_x = min_int(max_x, renderer->width - 1);
+    max_y = min_int(max_y, renderer->height - 1);
+    for (int y = min_y; y <= max_y; y++) {
+        memset(renderer->cell_state + y * renderer->width + min_x, RENDER_CELL_DIRTY,
+               max_x >= min_x ? max_x - min_x + 1 : 0);
+    }
+
+    return 1;
+}
+
+// Mark the cells that blocks changed since the cache was traced may cover.
+// Returns 0 when the changes cannot be bounded on screen (too many, too
+// wide, or reaching behind the camera).
+static int renderer_mark_edits(RenderPass* pass) {
+    Renderer* renderer = pass->renderer;
+    World* world = pass->world;
+
+    for (unsigned int generation = renderer->cache_generation + 1;
+         generation - 1 != world->generation; generation++) {
+        const WorldEdit* edit = world_get_edit(world, generation);
+        if (!edit || !renderer_mark_box(pass, edit)) return 0;
+    }
+
+    return 1;
+}
+
+// Mark the cells of the previously and newly highlighted blocks when the
+// highlight moved. Returns 0 when either cannot be bounded on screen.
+static int renderer_mark_highlight(RenderPass* pass) {
+    Renderer* renderer = pass->renderer;
+    if (pass->highlight == renderer->highlight_valid && (!pass->highlight ||
+        (pass->highlight_x == renderer->highlight_x && pass->highlight_y == renderer->highlight_y &&
+         pass->highlight_z == renderer->highlight_z))) {
+        return 1;
+    }
+
+    if (renderer->highlight_valid) {
+        WorldEdit box = { renderer->highlight_x, renderer->highlight_y, renderer->highlight_z,
+                          renderer->highlight_x, renderer->highlight_y, renderer->highlight_z };
+        if (!renderer_mark_box(pass, &box)) return 0;
+    }
+    if (pass->highlight) {
+        WorldEdit box = { pass->highlight_x, pass->highlight_y, pass->highlight_z,
+                          pass->highlight_x, pass->highlight_y, pass->highlight_z };
+        if (!renderer_mark_box(pass, &box)) return 0;
+    }
+    return 1;
+}
+
+// Draw the cells that keep their cached hit this frame: copied from the
+// last frame, or re-shaded when the light or the options changed. Returns
+// the number of cells left for rays.
+static int renderer_reuse_cells(RenderPass* pass, int relight, int reshade) {
+    Renderer* renderer = pass->renderer;
+    Framebuffer* fb = renderer->framebuffer;
+    Framebuffer* history = renderer->history;
+    int width = renderer->width;
+    int pending = 0;
+
+    for (int y = 0; y < renderer->height; y++) {
+        for (int x = 0; x < width; x++) {
+            int index = y * width + x;
+            if (renderer_cell_cast(pass, x, y)) {
+                pending++;
+                continue;
+            }
+
+            if (reshade && renderer->cell_state[index] == RENDER_CELL_CACHED) {
+                if (relight) ray_hit_relight(pass->world, &renderer->hit_cache[index]);
+                pass->shade(pass, x, y, &renderer->hit_cache[index]);
+                continue;
+            }
+
+            renderer->depth_buffer[index] = renderer->history_depth[index];
+            fb->char_buffer[index] = history->char_buffer[index];
+            fb->attr_buffer[index] = history->attr_buffer[index];
+        }
+    }
+
+    return pending;
+}
+
+// Smooth a per-cell cost measurement
+static float renderer_smooth_cost(float average, float sample) {
+    return average > 0.0f ? average * 0.75f + sample * 0.25f : sample;
+}
+
+// Predicted world pass time at a subsampling level
+static float renderer_predict_us(const Renderer* renderer, int level) {
+    float cells = (float)renderer->width * renderer->height;
+    float time = renderer->ray_cost_us * cells / (float)(1 << level);
+    if (level > 0) time += renderer->reproject_cost_us * cells;
+    return time;
+}
+
+// Pick next frame's subsampling from the measured cost of a traced and a
+// reprojected cell, so the world pass stays inside RENDER_WORLD_BUDGET_MS
+static void renderer_update_subsampling(Renderer* renderer, int level,
+                                        unsigned long long trace_us, unsigned long long reproject_us) {
+    float cells = (float)renderer->width * renderer->height;
+    renderer->ray_cost_us = renderer_smooth_cost(renderer->ray_cost_us, trace_us * (float)(1 << level) / cells);
+    if (level > 0) {
+        renderer->reproject_cost_us = renderer_smooth_cost(renderer->reproject_cost_us, reproject_us / cells);
+    }
+
+    // Drop cells as soon as the budget is exceeded, add them back only with headroom
+    float budget_us = RENDER_WORLD_BUDGET_MS * 1000.0f;
+    while (level < RENDER_SUBSAMPLE_MAX && renderer_predict_us(renderer, level) > budget_us) {
+        level++;
+    }
+    while (level > 0 && renderer_predict_us(renderer, level - 1) < budget_us * 0.75f) {
+        level--;
+    }
+    renderer->subsample_level = level;
+}
+
+// Thread pool task: render one band of rows
+static void renderer_render_band_task(void* context, int task_index, int thread_index) {
+    RenderPass* pass = (RenderPass*)context;
+    (void)thread_index;
+    int y_start = task_index * RENDER_BAND_ROWS;
+    int y_end = y_start + RENDER_BAND_ROWS;
+    if (y_end > pass->renderer->height) {
+        y_end = pass->renderer->height;
+    }
+
+    renderer_render_rows(pass, y_start, y_end);
+}
+
+// Camera basis of the player's view
+static RenderCamera renderer_player_camera(Player* player) {
+    RenderCamera camera;
 
     // Get camera position and direction
     Vector3 camera_pos = player_get_camera_position(player);
@@ -116,86 +841,131 @@ void renderer_render_world(Renderer* renderer, World* world, Player* player) {
     camera_up = vec3_cross(camera_right, camera_dir);
 
     // Normalize vectors
-    camera_dir = vec3_normalize(camera_dir);
-    camera_up = vec3_normalize(camera_up);
-    camera_right = vec3_normalize(camera_right);
+    camera.position = camera_pos;
+    camera.forward = vec3_normalize(camera_dir);
+    camera.up = vec3_normalize(camera_up);
+    camera.right = vec3_normalize(camera_right);
+    return camera;
+}
 
-    // Get screen dimensions
-    int screen_width = renderer->width;
-    int screen_height = renderer->height;
+// Whether the player's targeted block is highlighted: only while its trace is current
+static int renderer_target_highlighted(const Player* player, const World* world) {
+    const PlayerTarget* target = &player->target;
+    return RENDER_HIGHLIGHT_TARGET && target->valid && target->hit &&
+        target->world == world && target->generation == world->generation;
+}
 
-    // Aspect ratio
-    float aspect_ratio = (float)screen_width / screen_height;
+// Whether renderer_render_world would draw exactly the last world image
+int renderer_world_current(const Renderer* renderer, const World* world, Player* player) {
+    if (!renderer || !world || !player) return 0;
+    if (!renderer->world_settled || renderer->cache_world != world ||
+        renderer->cache_generation != world->generation ||
+        renderer->cache_light_epoch != world->light_epoch ||
+        renderer->cache_options != (renderer->options & RENDER_OPTION_ALL)) {
+        return 0;
+    }
 
-    // Render sky
-    float sky_brightness = world->sky_brightness;
-    int sky_color = (sky_brightness > 0.5f) ? COLOR_CYAN : COLOR_BLACK;
+    RenderCamera camera = renderer_player_camera(player);
+    if (memcmp(&camera, &renderer->history_camera, sizeof(RenderCamera)) != 0) return 0;
 
-    // Render each pixel
-    for (int y = 0; y < screen_height; y++) {
-        for (int x = 0; x < screen_width; x++) {
-            // Calculate ray direction
-            float screen_x = (2.0f * x / screen_width - 1.0f) * aspect_ratio * FOV_HORIZONTAL;
-            float screen_y = (1.0f - 2.0f * y / screen_height) * FOV_VERTICAL;
-
-            // Ray direction
-            Vector3 ray_dir;
-            ray_dir.x = camera_dir.x + screen_x * camera_right.x + screen_y * camera_up.x;
-            ray_dir.y = camera_dir.y + screen_x * camera_right.y + screen_y * camera_up.y;
-            ray_dir.z = camera_dir.z + screen_x * camera_right.z + screen_y * camera_up.z;
-            ray_dir = vec3_normalize(ray_dir);
-
-            // Cast ray
-            RayHit hit = cast_ray(world, camera_pos, ray_dir, FAR_PLANE);
-
-            // Render hit or sky
-            if (hit.hit) {
-                // Calculate buffer index
-                int index = y * screen_width + x;
-
-                // Check depth buffer
-                if (hit.distance < renderer->depth_buffer[index]) {
-                    // Update depth buffer
-                    renderer->depth_buffer[index] = hit.distance;
-
-                    // Get display character
-                    char display_char = get_hit_display_char(hit);
-
-                    // Get color
-                    int fg_color = get_hit_color(hit);
-                    int bg_color = COLOR_BLACK;
-
-                    // Write to framebuffer
-                    renderer->framebuffer->char_buffer[index] = display_char;
-                    renderer->framebuffer->fg_color_buffer[index] = fg_color;
-                    renderer->framebuffer->bg_color_buffer[index] = bg_color;
-                }
-            }
-            else {
-                // Draw sky gradient
-                int index = y * screen_width + x;
-                float sky_y = (float)y / screen_height;
+    const PlayerTarget* target = &player->target;
+    int highlight = renderer_target_highlighted(player, world);
+    return highlight == renderer->highlight_valid && (!highlight ||
+        (target->x == renderer->highlight_x && target->y == renderer->highlight_y &&
+         target->z == renderer->highlight_z));
+}
 
-                char display_char = ' ';
-                int fg_color = COLOR_BLACK;
-                int bg_color;
+// Render the world
+void renderer_render_world(Renderer* renderer, World* world, Player* player) {
+    if (!renderer || !world || !player) return;
 
-                if (sky_y < 0.5f) {
-                    // Upper sky (darker)
-                    bg_color = sky_color;
-                }
-                else {
-                    // Lower sky (lighter)
-                    bg_color = (sky_color == COLOR_CYAN) ? COLOR_BLUE : COLOR_BLACK;
-                }
+    RenderPass pass;
+    pass.renderer = renderer;
+    pass.world = world;
+    pass.camera = renderer_player_camera(player);
 
-                // Write to framebuffer
-                renderer->framebuffer->char_buffer[index] = display_char;
-                renderer->framebuffer->fg_color_buffer[index] = fg_color;
-                renderer->framebuffer->bg_color_buffer[index] = bg_color;
-            }
+    // Aspect ratio
+    pass.aspect_ratio = (float)renderer->width / renderer->height;
+
+    // Shading kernel for the options, picked once for every cell
+    int options = renderer->options & RENDER_OPTION_ALL;
+    pass.shade = renderer_shade_kernels[options];
+
+    // Render sky, in the light epoch's brightness like the blocks
+    float sky_brightness = world->epoch_brightness;
+    int sky_color = (sky_brightness > 0.5f) ? COLOR_CYAN : COLOR_BLACK;
+    int colors = options & RENDER_OPTION_COLORS;
+    pass.sky_upper = colors ? sky_color : COLOR_BLACK;
+    pass.sky_lower = colors && sky_color == COLOR_CYAN ? COLOR_BLUE : COLOR_BLACK;
+
+    // Trace a rotating subset of cells when the full frame would miss the budget
+    pass.subsample_level = renderer->adaptive_resolution && renderer->history_valid ?
+        renderer->subsample_level : 0;
+    pass.subsample_phase = (int)(renderer->frame_index++ & 3);
+
+    // Highlight the player's targeted block while its trace is current
+    const PlayerTarget* target = &player->target;
+    pass.highlight = renderer_target_highlighted(player, world);
+    pass.highlight_x = target->x;
+    pass.highlight_y = target->y;
+    pass.highlight_z = target->z;
+    pass.highlight_type = target->block_type;
+
+    // A still camera keeps every cached hit that no block change can reach
+    int cells = renderer->width * renderer->height;
+    pass.reuse = renderer->history_valid && renderer->cache_world == world &&
+        memcmp(&pass.camera, &renderer->history_camera, sizeof(RenderCamera)) == 0 &&
+        renderer_mark_edits(&pass) && renderer_mark_highlight(&pass);
+    int relight = renderer->cache_light_epoch != world->light_epoch;
+    int reshade = relight || renderer->cache_options != options;
+    int pending = cells;
+    if (pass.reuse) {
+        pending = renderer_reuse_cells(&pass, relight, reshade);
+    }
+    else {
+        memset(renderer->cell_state, RENDER_CELL_STALE, cells * sizeof(uint8_t));
+    }
+
+    renderer->cache_world = world;
+    renderer->cache_generation = world->generation;
+    renderer->cache_light_epoch = world->light_epoch;
+    renderer->cache_options = options;
+    renderer->highlight_valid = pass.highlight;
+    renderer->highlight_x = pass.highlight_x;
+    renderer->highlight_y = pass.highlight_y;
+    renderer->highlight_z = pass.highlight_z;
+
+    // Nothing changed: the frame is the last one. Until that happens again,
+    // the next frame may still refine or change the image.
+    renderer->world_settled = pass.reuse && pending == 0 && !reshade;
+    if (renderer->world_settled) return;
+
+    // World and player are read-only during the pass, and every band owns
+    // its own rows of the framebuffer and depth buffer, so bands can be
+    // rendered concurrently without locking.
+    unsigned long long start = get_time_us();
+    if (pending > 0) {
+        int band_count = (renderer->height + RENDER_BAND_ROWS - 1) / RENDER_BAND_ROWS;
+        threadpool_run(renderer->thread_pool, renderer_render_band_task, &pass, band_count);
+    }
+
+    // Moving camera: fill the untraced cells and adapt the level. Frames that
+    // reuse the cache trace too few cells to say what a full frame costs.
+    if (!pass.reuse) {
+        unsigned long long traced = get_time_us();
+        if (pass.subsample_level > 0) {
+            renderer_reproject(&pass);
+        }
+        if (renderer->adaptive_resolution) {
+            renderer_update_subsampling(renderer, pass.subsample_level, traced - start, get_time_us() - traced);
         }
     }
+
+    // Keep this frame for reprojection and reuse
+    framebuffer_copy(renderer->history, renderer->framebuffer);
+    memcpy(renderer->history_depth, renderer->depth_buffer, cells * sizeof(RenderDepth));
+    renderer->history_camera = pass.camera;
+    renderer->history_valid = 1;
 }
 
 // Render the HUD (heads-up display)
@@ -225,20 +995,25 @@ void renderer_render_hud(Renderer* renderer, Player* player, World* world) {
         '*', COLOR_WHITE | COLOR_BRIGHT, COLOR_BLACK);
 
     // Show coordinates
-    char coords[32];
-    sprintf(coords, "X:%.1f Y:%.1f Z:%.1f",
-        player->position.x, player->position.y, player->position.z);
-    renderer_draw_text(renderer, 2, 1, coords, COLOR_WHITE, COLOR_BLACK);
+    Arena* scratch = &renderer->scratch;
+    renderer_draw_text(renderer, 2, 1, arena_printf(scratch, "X:%.1f Y:%.1f Z:%.1f",
+        player->position.x, player->position.y, player->position.z), COLOR_WHITE, COLOR_BLACK);
 
     // Show health and stamina
-    char stats[32];
-    sprintf(stats, "HP:%.0f SP:%.0f", player->health, player->stamina);
-    renderer_draw_text(renderer, 2, 2, stats, COLOR_WHITE, COLOR_BLACK);
+    renderer_draw_text(renderer, 2, 2, arena_printf(scratch, "HP:%.0f SP:%.0f",
+        player->health, player->stamina), COLOR_WHITE, COLOR_BLACK);
+
+    // Show the targeted block
+    const PlayerTarget* target = player_get_target(player, world);
+    if (target->hit) {
+        renderer_draw_text(renderer, 2, 3, arena_printf(scratch, "AIM: %s %d,%d,%d",
+            world_get_block_type(world, target->block_type).name, target->x, target->y, target->z),
+            COLOR_WHITE, COLOR_BLACK);
+    }
 
     // Show time of day
-    char time[32];
-    sprintf(time, "Time: %.2f", world->time_of_day);
-    renderer_draw_text(renderer, renderer->width - 13, 1, time, COLOR_WHITE, COLOR_BLACK);
+    renderer_draw_text(renderer, renderer->width - 13, 1, arena_printf(scratch, "Time: %.2f",
+        world->time_of_day), COLOR_WHITE, COLOR_BLACK);
 
     // Controls help
     renderer_draw_text(renderer, 2, renderer->height - 2,
@@ -246,77 +1021,210 @@ void renderer_render_hud(Renderer* renderer, Player* player, World* world) {
         COLOR_WHITE, COLOR_BLACK);
 }
 
+#if DEBUG_MODE
+// Profiler section of the debug overlay: stage times and hot-path counters
+// averaged over recent frames, and a sparkline of frame times
+static void renderer_render_profile(Renderer* renderer, int row) {
+    static const char levels[] = "_.-:=+*#%@";
+    size_t line_size = 128;
+    char* line = (char*)arena_alloc(&renderer->scratch, line_size);
+    int length = 0;
+    if (!line) return;
+
+    for (int scope = 0; scope < PROFILE_SCOPE_COUNT; scope++) {
+        length += snprintf(line + length, line_size - length, "%s%s %.1f",
+            scope ? " " : "", profiler_scope_name((ProfileScope)scope), profiler_scope_ms((ProfileScope)scope));
+        if (length >= (int)line_size) break;
+    }
+    renderer_draw_text(renderer, 2, row, line, COLOR_WHITE, COLOR_BLACK);
+
+    double rays = profiler_counter_average(PROFILE_RAYS);
+    double steps = profiler_counter_average(PROFILE_DDA_STEPS);
+    snprintf(line, line_size, "RAYS: %.0f/f | STEPS: %.1f/ray | LIGHT: %.0f/f | OUT: %.0f B/f",
+        rays, rays > 0.0 ? steps / rays : 0.0,
+        profiler_counter_average(PROFILE_BRIGHTNESS), profiler_counter_average(PROFILE_PRESENT_BYTES));
+    renderer_draw_text(renderer, 2, row + 1, line, COLOR_WHITE, COLOR_BLACK);
+
+    // Frame times scaled so the frame budget sits at half height
+    float history[PROFILER_AVERAGE_FRAMES];
+    int count = profiler_frame_history(history, PROFILER_AVERAGE_FRAMES);
+    float peak = 0.0f;
+    int top = (int)sizeof(levels) - 2;
+    for (int i = 0; i < count; i++) {
+        int level = (int)(history[i] * (float)top / (2.0f * MS_PER_FRAME));
+        line[i] = levels[level < 0 ? 0 : (level > top ? top : level)];
+        peak = history[i] > peak ? history[i] : peak;
+    }
+    snprintf(line + count, line_size - count, " peak %.1fms", peak);
+    renderer_draw_text(renderer, 2, row + 2, line, COLOR_WHITE, COLOR_BLACK);
+}
+#endif
+
 // Render debug information
 void renderer_render_debug(Renderer* renderer, Player* player) {
     if (!renderer || !player || !renderer->draw_debug) return;
 
-    // Debug info
-    char debug[128];
+    Arena* scratch = &renderer->scratch;
 
     // Show player velocity
-    sprintf(debug, "VEL: X:%.2f Y:%.2f Z:%.2f",
-        player->velocity.x, player->velocity.y, player->velocity.z);
-    renderer_draw_text(renderer, 2, 4, debug, COLOR_WHITE, COLOR_BLACK);
+    renderer_draw_text(renderer, 2, 4, arena_printf(scratch, "VEL: X:%.2f Y:%.2f Z:%.2f",
+        player->velocity.x, player->velocity.y, player->velocity.z), COLOR_WHITE, COLOR_BLACK);
 
     // Show player rotation
-    sprintf(debug, "ROT: P:%.2f Y:%.2f",
-        player->rotation.x * 180.0f / M_PI, player->rotation.y * 180.0f / M_PI);
-    renderer_draw_text(renderer, 2, 5, debug, COLOR_WHITE, COLOR_BLACK);
+    renderer_draw_text(renderer, 2, 5, arena_printf(scratch, "ROT: P:%.2f Y:%.2f",
+        player->rotation.x * 180.0f / M_PI, player->rotation.y * 180.0f / M_PI), COLOR_WHITE, COLOR_BLACK);
 
     // Show grounded state
-    sprintf(debug, "GROUNDED: %s | FLYING: %s",
-        player->grounded ? "YES" : "NO", player->flying ? "YES" : "NO");
-    renderer_draw_text(renderer, 2, 6, debug, COLOR_WHITE, COLOR_BLACK);
+    renderer_draw_text(renderer, 2, 6, arena_printf(scratch, "GROUNDED: %s | FLYING: %s",
+        player->grounded ? "YES" : "NO", player->flying ? "YES" : "NO"), COLOR_WHITE, COLOR_BLACK);
+
+    // Show output cost of the last presented frame
+    renderer_draw_text(renderer, 2, 7, arena_printf(scratch, "OUT: %d bytes/frame | %d cells",
+        renderer->present_bytes, renderer->present_cells), COLOR_WHITE, COLOR_BLACK);
+
+    // Show the fraction of cells traced per frame
+    renderer_draw_text(renderer, 2, 8, arena_printf(scratch, "RES: 1/%d traced%s",
+        1 << renderer->subsample_level, renderer->adaptive_resolution ? " (adaptive)" : ""),
+        COLOR_WHITE, COLOR_BLACK);
+
+#if DEBUG_MODE
+    renderer_render_profile(renderer, 9);
+#endif
+}
+
+// Mark the minimap rows a box of blocks covers. Returns 0 when the edit
+// log no longer has every change since the image was sampled.
+static int renderer_minimap_mark_edits(MinimapCache* map, const World* world) {
+    for (unsigned int generation = map->generation + 1; generation - 1 != world->generation; generation++) {
+        const WorldEdit* edit = world_get_edit(world, generation);
+        if (!edit) return 0;
+
+        int y0 = max_int((edit->y0 >> map->zoom) - map->origin_y, 0);
+        int y1 = min_int((edit->y1 >> map->zoom) - map->origin_y, RENDER_MINIMAP_SIZE - 1);
+        for (int y = y0; y <= y1; y++) {
+            map->stale[y] = 1;
+        }
+    }
+    return 1;
+}
+
+// Move the image to a new top-left cell; rows that gain cells turn stale
+static void renderer_minimap_scroll(MinimapCache* map, int origin_x, int origin_y) {
+    int dx = origin_x - map->origin_x;
+    int dy = origin_y - map->origin_y;
+    map->origin_x = origin_x;
+    map->origin_y = origin_y;
+    if (!dx && !dy) return;
+
+    if (abs(dx) >= RENDER_MINIMAP_SIZE || abs(dy) >= RENDER_MINIMAP_SIZE) {
+        memset(map->stale, 1, sizeof(map->stale));
+        return;
+    }
+
+    // Copy from the old row that lands on each new one, top-down when the
+    // view moves down so no source row is overwritten before it is read
+    char glyphs[RENDER_MINIMAP_SIZE];
+    uint8_t attrs[RENDER_MINIMAP_SIZE];
+    int copy = RENDER_MINIMAP_SIZE - abs(dx);
+    for (int i = 0; i < RENDER_MINIMAP_SIZE; i++) {
+        int y = dy > 0 ? i : RENDER_MINIMAP_SIZE - 1 - i;
+        int source = y + dy;
+        if (source < 0 || source >= RENDER_MINIMAP_SIZE) {
+            map->stale[y] = 1;
+            continue;
+        }
+
+        char* row_glyphs = map->glyphs + y * RENDER_MINIMAP_SIZE;
+        uint8_t* row_attrs = map->attrs + y * RENDER_MINIMAP_SIZE;
+        memcpy(glyphs, map->glyphs + source * RENDER_MINIMAP_SIZE, RENDER_MINIMAP_SIZE);
+        memcpy(attrs, map->attrs + source * RENDER_MINIMAP_SIZE, RENDER_MINIMAP_SIZE);
+        memset(row_glyphs, ' ', RENDER_MINIMAP_SIZE);
+        memset(row_attrs, COLOR_ATTR(COLOR_WHITE, COLOR_BLACK), RENDER_MINIMAP_SIZE);
+        memcpy(row_glyphs + max_int(-dx, 0), glyphs + max_int(dx, 0), copy);
+        memcpy(row_attrs + max_int(-dx, 0), attrs + max_int(dx, 0), copy);
+        map->stale[y] = map->stale[source] || dx != 0;
+    }
+}
+
+// Resample one minimap row from the world's heightfield mips
+static void renderer_minimap_sample_row(MinimapCache* map, const World* world, int y) {
+    const WorldLodCell* cells = world->lod[map->zoom];
+    int width = world_lod_width(world, map->zoom);
+    int height = world_lod_height(world, map->zoom);
+    int cell_y = map->origin_y + y;
+
+    for (int x = 0; x < RENDER_MINIMAP_SIZE; x++) {
+        int cell_x = map->origin_x + x;
+        int index = y * RENDER_MINIMAP_SIZE + x;
+        map->glyphs[index] = ' ';
+        map->attrs[index] = COLOR_ATTR(COLOR_WHITE, COLOR_BLACK);
+
+        if (cell_x < 0 || cell_y < 0 || cell_x >= width || cell_y >= height) continue;
+
+        // Highest block of the cell
+        const WorldLodCell* cell = &cells[(size_t)cell_y * width + cell_x];
+        if (cell->top >= 0) {
+            map->glyphs[index] = world_block_glyph(world, cell->type);
+            map->attrs[index] = COLOR_ATTR(world_block_color(world, cell->type), COLOR_BLACK);
+        }
+    }
+
+    map->stale[y] = 0;
 }
 
 // Render minimap
 void renderer_render_minimap(Renderer* renderer, World* world, Player* player) {
     if (!renderer || !world || !player || !renderer->show_minimap) return;
 
+    MinimapCache* map = &renderer->minimap;
+
     // Minimap size and position
-    int map_size = 16;
+    int map_size = RENDER_MINIMAP_SIZE;
     int map_x = renderer->width - map_size - 2;
     int map_y = 2;
 
+    // Top-left cell of a view centered on the player
+    int origin_x = ((int)player->position.x >> map->zoom) - map_size / 2;
+    int origin_y = ((int)player->position.y >> map->zoom) - map_size / 2;
+
+    // Find the rows that no longer show the world
+    if (!map->valid || map->world != world || map->drawn_zoom != map->zoom) {
+        map->valid = 1;
+        map->world = world;
+        map->drawn_zoom = map->zoom;
+        map->origin_x = origin_x;
+        map->origin_y = origin_y;
+        memset(map->stale, 1, sizeof(map->stale));
+    }
+    else {
+        renderer_minimap_scroll(map, origin_x, origin_y);
+        if (!renderer_minimap_mark_edits(map, world)) memset(map->stale, 1, sizeof(map->stale));
+    }
+    map->generation = world->generation;
+
+    // Resample stale rows nearest the player first, within the budget
+#if RENDER_MINIMAP_BUDGET_US > 0
+    unsigned long long start = get_time_us();
+#endif
+    for (int i = 0; i < map_size; i++) {
+        int y = map_size / 2 + ((i & 1) ? -(i + 1) / 2 : i / 2);
+        if (!map->stale[y]) continue;
+
+        renderer_minimap_sample_row(map, world, y);
+#if RENDER_MINIMAP_BUDGET_US > 0
+        if (get_time_us() - start >= RENDER_MINIMAP_BUDGET_US) break;
+#endif
+    }
+
     // Minimap border
     renderer_draw_rect(renderer, map_x - 1, map_y - 1, map_size + 2, map_size + 2, ' ', COLOR_WHITE, COLOR_BLACK);
 
-    // Draw minimap
-    int player_x = (int)player->position.x;
-    int player_y = (int)player->position.y;
-
-    // Draw terrain
+    // Blit the cached image
     for (int y = 0; y < map_size; y++) {
         for (int x = 0; x < map_size; x++) {
-            int world_x = player_x + x - map_size / 2;
-            int world_y = player_y + y - map_size / 2;
-
-            if (world_x < 0 || world_x >= world->width ||
-                world_y < 0 || world_y >= world->height) {
-                continue;
-            }
-
-            // Find highest non-air block at this position
-            int highest_z = -1;
-            uint8_t highest_block = BLOCK_AIR;
-
-            for (int z = world->depth - 1; z >= 0; z--) {
-                uint8_t block = world_get_block(world, world_x, world_y, z);
-                if (block != BLOCK_AIR) {
-                    highest_z = z;
-                    highest_block = block;
-                    break;
-                }
-            }
-
-            if (highest_z >= 0) {
-                // Get block type info
-                BlockType block_type = world_get_block_type(world, highest_block);
-
-                // Use block_type to avoid 'unreferenced local variable' warning
-                renderer_set_pixel(renderer, map_x + x, map_y + y,
-                    block_type.display_char, block_type.fg_color, COLOR_BLACK);
-            }
+            uint8_t attr = map->attrs[y * map_size + x];
+            renderer_set_pixel(renderer, map_x + x, map_y + y, map->glyphs[y * map_size + x],
+                COLOR_ATTR_FG(attr), COLOR_ATTR_BG(attr));
         }
     }
 
@@ -325,32 +1233,144 @@ void renderer_render_minimap(Renderer* renderer, World* world, Player* player) {
         'P', COLOR_WHITE | COLOR_BRIGHT, COLOR_BLACK);
 }
 
+// Check whether a cell of a frame differs from what the terminal shows
+static int renderer_cell_changed(const Renderer* renderer, const Framebuffer* fb, int index) {
+    if (!renderer->presented_valid) return 1;
+
+    const Framebuffer* shown = renderer->presented;
+    return fb->char_buffer[index] != shown->char_buffer[index] ||
+        fb->attr_buffer[index] != shown->attr_buffer[index];
+}
+
+// First cell of a row at or after x that changed since the last present
+// (width when none). Unchanged stretches are compared 16 cells at a time.
+static int renderer_next_changed(const Renderer* renderer, const Framebuffer* fb, int row, int x, int width) {
+    if (!renderer->presented_valid) return x;
+
+#if RENDERER_SSE2
+    const Framebuffer* shown = renderer->presented;
+    for (; x + 16 <= width; x += 16) {
+        __m128i glyphs = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(fb->char_buffer + row + x)),
+                                        _mm_loadu_si128((const __m128i*)(shown->char_buffer + row + x)));
+        __m128i attrs = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(fb->attr_buffer + row + x)),
+                                       _mm_loadu_si128((const __m128i*)(shown->attr_buffer + row + x)));
+        if (_mm_movemask_epi8(_mm_and_si128(glyphs, attrs)) != 0xFFFF) break;
+    }
+#endif
+
+    while (x < width && !renderer_cell_changed(renderer, fb, row + x)) {
+        x++;
+    }
+    return x;
+}
+
 // Present the rendered frame
 void renderer_present(Renderer* renderer) {
     if (!renderer) return;
 
-    // Set cursor to top-left
-    terminal_set_cursor(0, 0);
+    renderer_present_frame(renderer, renderer->framebuffer);
+}
 
-    // Draw framebuffer
-    Framebuffer* fb = renderer->framebuffer;
-    for (int y = 0; y < fb->height; y++) {
-        for (int x = 0; x < fb->width; x++) {
-            int index = y * fb->width + x;
+// Encode the cells of a frame that differ from the last encoded one as VT
+// output, and remember the frame as shown. Returns the bytes appended.
+int renderer_encode_frame(Renderer* renderer, const Framebuffer* fb, OutputBuffer* out) {
+    if (!renderer || !fb || !out) return 0;
+
+    Framebuffer* shown = renderer->presented;
+    int bytes = 0;
+    int cells = 0;
 
-            char c = fb->char_buffer[index];
-            int fg = fb->fg_color_buffer[index];
-            int bg = fb->bg_color_buffer[index];
+    // Color currently active on the terminal (-1 = unknown)
+    int current_fg = -1;
+    int current_bg = -1;
 
-            terminal_set_color(fg, bg);
-            putchar(c);
+    // Write only runs of changed cells. Each run costs one cursor move, so
+    // short gaps of unchanged cells are rewritten instead of starting a new run.
+    for (int y = 0; y < fb->height; y++) {
+        int row = y * fb->width;
+        int x = 0;
+
+        while (x < fb->width) {
+            // Find start of the next run
+            x = renderer_next_changed(renderer, fb, row, x, fb->width);
+            if (x >= fb->width) break;
+
+            // Find end of the run, absorbing short unchanged gaps
+            int run_start = x;
+            int run_end = x + 1;
+            int gap = 0;
+            for (int i = x + 1; i < fb->width; i++) {
+                if (renderer_cell_changed(renderer, fb, row + i)) {
+                    run_end = i + 1;
+                    gap = 0;
+                }
+                else if (++gap > RENDER_PRESENT_MAX_GAP) {
+                    break;
+                }
+            }
+
+            // Emit the run, switching color only where it actually changes
+            bytes += output_set_cursor(out, run_start, y);
+            int text_start = run_start;
+            for (int i = run_start; i < run_end; i++) {
+                int index = row + i;
+                int fg = COLOR_ATTR_FG(fb->attr_buffer[index]);
+                int bg = COLOR_ATTR_BG(fb->attr_buffer[index]);
+
+                if (fg != current_fg || bg != current_bg) {
+                    bytes += output_write(out, fb->char_buffer + row + text_start, i - text_start);
+                    bytes += output_set_color(out, fg, bg);
+                    current_fg = fg;
+                    current_bg = bg;
+                    text_start = i;
+                }
+            }
+            bytes += output_write(out, fb->char_buffer + row + text_start, run_end - text_start);
+            cells += run_end - run_start;
+            x = run_end;
         }
-        putchar('\n');
     }
 
+    // Remember what the terminal now shows
+    framebuffer_copy(shown, fb);
+    renderer->presented_valid = 1;
+
     // Reset terminal color
-    terminal_reset_color();
-    terminal_flush();
+    if (current_fg != -1) {
+        bytes += output_reset_color(out);
+    }
+
+    PROFILE_COUNT(PROFILE_PRESENT_BYTES, bytes);
+    renderer->present_bytes = bytes;
+    renderer->present_cells = cells;
+    return bytes;
+}
+
+// Present a frame the size of the renderer
+void renderer_present_frame(Renderer* renderer, const Framebuffer* fb) {
+    if (!renderer || !fb) return;
+
+    // Console cell backend: blit the whole grid in one call
+    if (terminal_get_backend() == TERMINAL_BACKEND_CONSOLE) {
+        int bytes = terminal_present_cells(fb->char_buffer, fb->attr_buffer, fb->width, fb->height);
+        renderer->presented_valid = 0;
+        PROFILE_COUNT(PROFILE_PRESENT_BYTES, bytes);
+        renderer->present_bytes = bytes;
+        renderer->present_cells = fb->width * fb->height;
+        return;
+    }
+
+    // The whole frame is assembled in one buffer and written at the end
+    terminal_begin_frame();
+    renderer_encode_frame(renderer, fb, terminal_get_output());
+    terminal_end_frame();
+}
+
+// Force the next present to redraw every cell
+void renderer_invalidate(Renderer* renderer) {
+    if (!renderer) return;
+
+    renderer->presented_valid = 0;
 }
 
 // Set a pixel in the framebuffer
@@ -367,8 +1387,7 @@ void renderer_set_pixel(Renderer* renderer, int x, int y, char c, int fg, int bg
     // Set pixel
     int index = y * fb->width + x;
     fb->char_buffer[index] = c;
-    fb->fg_color_buffer[index] = fg;
-    fb->bg_color_buffer[index] = bg;
+    fb->attr_buffer[index] = COLOR_ATTR(fg, bg);
 }
 
 // Draw a line
@@ -445,7 +1464,21 @@ void renderer_toggle_debug(Renderer* renderer) {
 void renderer_toggle_wireframe(Renderer* renderer) {
     if (!renderer) return;
 
-    renderer->wireframe_mode = !renderer->wireframe_mode;
+    renderer->options ^= RENDER_OPTION_WIREFRAME;
+}
+
+// Replace the render options (RENDER_OPTION_* flags)
+void renderer_set_options(Renderer* renderer, int options) {
+    if (!renderer) return;
+
+    renderer->options = options & RENDER_OPTION_ALL;
+}
+
+// Switch one render option on or off
+void renderer_toggle_option(Renderer* renderer, int option) {
+    if (!renderer) return;
+
+    renderer->options ^= option & RENDER_OPTION_ALL;
 }
 
 // Toggle minimap
@@ -455,6 +1488,148 @@ void renderer_toggle_minimap(Renderer* renderer) {
     renderer->show_minimap = !renderer->show_minimap;
 }
 
+// Show the next coarser minimap zoom, wrapping back to one block per cell
+void renderer_cycle_minimap_zoom(Renderer* renderer) {
+    if (!renderer) return;
+
+    renderer->minimap.zoom = (renderer->minimap.zoom + 1) % WORLD_LOD_LEVELS;
+}
+
+// Set the number of render threads (0 = one per CPU)
+void renderer_set_thread_count(Renderer* renderer, int thread_count) {
+    if (!renderer) return;
+
+    renderer->thread_count = thread_count;
+
+    // Restart workers with the new count
+    if (renderer->owns_thread_pool) threadpool_destroy(renderer->thread_pool);
+    renderer->thread_pool = NULL;
+    renderer->owns_thread_pool = 1;
+
+    int resolved = renderer_resolve_thread_count(thread_count);
+    if (resolved > 1) {
+        renderer->thread_pool = threadpool_create(resolved);
+    }
+}
+
+// Render with a pool the caller owns and may share between renderers
+void renderer_set_thread_pool(Renderer* renderer, ThreadPool* pool) {
+    if (!renderer) return;
+
+    if (renderer->owns_thread_pool) threadpool_destroy(renderer->thread_pool);
+    renderer->thread_pool = pool;
+    renderer->owns_thread_pool = 0;
+}
+
+// Enable or disable adaptive resolution; the next frame is fully traced
+void renderer_set_adaptive_resolution(Renderer* renderer, int enabled) {
+    if (!renderer) return;
+
+    renderer->adaptive_resolution = enabled;
+    renderer->subsample_level = 0;
+    renderer->history_valid = 0;
+    renderer->world_settled = 0;
+}
+
+// Frame queue
+
+FrameQueue* frame_queue_create(int width, int height) {
+    FrameQueue* queue = (FrameQueue*)malloc(sizeof(FrameQueue));
+    if (!queue) return NULL;
+
+    for (int i = 0; i < FRAME_QUEUE_BUFFERS; i++) {
+        queue->buffers[i] = framebuffer_create(width, height);
+        if (!queue->buffers[i]) {
+            while (--i >= 0) framebuffer_destroy(queue->buffers[i]);
+            free(queue);
+            return NULL;
+        }
+    }
+
+    queue->front = 0;
+    queue->ready = 1;
+    queue->back = 2;
+    queue->fresh = 0;
+    queue->closed = 0;
+    mutex_init(&queue->lock);
+    condvar_init(&queue->available);
+    return queue;
+}
+
+void frame_queue_destroy(FrameQueue* queue) {
+    if (!queue) return;
+
+    for (int i = 0; i < FRAME_QUEUE_BUFFERS; i++) {
+        framebuffer_destroy(queue->buffers[i]);
+    }
+    condvar_destroy(&queue->available);
+    mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+// Hand over a finished frame; replaces a ready frame nobody took yet
+void frame_queue_publish(FrameQueue* queue, const Framebuffer* frame) {
+    if (!queue || !frame) return;
+
+    // Only this side touches the back buffer, so the copy needs no lock.
+    // Frames follow the renderer's size; a frame of a new size gets a new
+    // buffer (or is dropped if none can be had).
+    Framebuffer* back = queue->buffers[queue->back];
+    if (back->width != frame->width || back->height != frame->height) {
+        Framebuffer* resized = framebuffer_create(frame->width, frame->height);
+        if (!resized) return;
+        framebuffer_destroy(back);
+        queue->buffers[queue->back] = back = resized;
+    }
+    framebuffer_copy(back, frame);
+
+    mutex_lock(&queue->lock);
+    if (queue->closed) {
+        mutex_unlock(&queue->lock);
+        return;
+    }
+
+    int ready = queue->ready;
+    queue->ready = queue->back;
+    queue->back = ready;
+    queue->fresh = 1;
+    condvar_signal(&queue->available);
+    mutex_unlock(&queue->lock);
+}
+
+// Wait for a frame newer than the last one taken. The frame stays valid
+// until the next call; NULL once the queue is closed.
+const Framebuffer* frame_queue_acquire(FrameQueue* queue) {
+    if (!queue) return NULL;
+
+    mutex_lock(&queue->lock);
+    while (!queue->fresh && !queue->closed) {
+        condvar_wait(&queue->available, &queue->lock);
+    }
+
+    const Framebuffer* frame = NULL;
+    if (queue->fresh) {
+        int front = queue->front;
+        queue->front = queue->ready;
+        queue->ready = front;
+        queue->fresh = 0;
+        frame = queue->buffers[queue->front];
+    }
+    mutex_unlock(&queue->lock);
+    return frame;
+}
+
+// Wake the presenter for good; frames published afterwards are ignored
+void frame_queue_close(FrameQueue* queue) {
+    if (!queue) return;
+
+    mutex_lock(&queue->lock);
+    queue->closed = 1;
+    queue->fresh = 0;
+    condvar_broadcast(&queue->available);
+    mutex_unlock(&queue->lock);
+}
+
 /* Restore warning settings */
 #ifdef _MSC_VER
 #pragma warning(pop)
@@ -7,32 +7,146 @@
 
 #include "world.h"
 #include "player.h"
+#include "thread.h"
+#include "threadpool.h"
+#include "raycaster.h"
+#include "terminal.h"
+#include "arena.h"
+#include "config.h"
+#include <math.h>
 
- // Framebuffer structure
+// Camera basis of a rendered frame
+typedef struct {
+    Vector3 position;
+    Vector3 forward;
+    Vector3 right;
+    Vector3 up;
+} RenderCamera;
+
+// Framebuffer planes are padded to and aligned on this many bytes
+#define FRAMEBUFFER_ALIGN 64
+
+// Framebuffer structure: one glyph plane and one attribute plane
+// (COLOR_ATTR: foreground and background nibbles), two bytes per cell
 typedef struct {
     int width;
     int height;
     char* char_buffer;
-    int* fg_color_buffer;
-    int* bg_color_buffer;
+    uint8_t* attr_buffer;
+    void* storage;            // Allocation both planes live in
 } Framebuffer;
 
+// Depth plane sample: distance along the view ray, or RENDER_DEPTH_FAR
+#if RENDER_DEPTH_16BIT
+typedef uint16_t RenderDepth;
+#define RENDER_DEPTH_FAR 0xFFFF
+#define RENDER_DEPTH_RANGE (2.0f * (RENDER_LOD ? RENDER_LOD_DISTANCE : FAR_PLANE)) // Reprojected depth may exceed the far plane
+#define RENDER_DEPTH_SCALE (65534.0f / RENDER_DEPTH_RANGE)
+#else
+typedef float RenderDepth;
+#define RENDER_DEPTH_FAR INFINITY
+#endif
+
+// Convert between distances and depth samples
+static inline RenderDepth render_depth_encode(float distance) {
+#if RENDER_DEPTH_16BIT
+    if (distance >= RENDER_DEPTH_RANGE) return (RenderDepth)(RENDER_DEPTH_FAR - 1);
+    return (RenderDepth)(distance * RENDER_DEPTH_SCALE + 0.5f);
+#else
+    return distance;
+#endif
+}
+
+static inline float render_depth_decode(RenderDepth depth) {
+#if RENDER_DEPTH_16BIT
+    return depth == RENDER_DEPTH_FAR ? INFINITY : depth / RENDER_DEPTH_SCALE;
+#else
+    return depth;
+#endif
+}
+
+// Render options (Renderer.options). Every combination has its own shading
+// kernel with the options compiled in, picked once per frame.
+#define RENDER_OPTION_FOG 0x01       // Dim hits with distance (shows through shading)
+#define RENDER_OPTION_SHADING 0x02   // Brighten lit and darken shaded block colors
+#define RENDER_OPTION_COLORS 0x04    // Block and sky colors (off = white on black)
+#define RENDER_OPTION_EDGES 0x08     // Outline block faces
+#define RENDER_OPTION_WIREFRAME 0x10 // Draw only the outlines
+#define RENDER_OPTION_BITS 5
+#define RENDER_OPTION_ALL ((1 << RENDER_OPTION_BITS) - 1)
+
+#define RENDER_DEFAULT_OPTIONS \
+    ((ENABLE_FOG ? RENDER_OPTION_FOG : 0) | (ENABLE_SHADING ? RENDER_OPTION_SHADING : 0) | \
+     (ENABLE_COLORS ? RENDER_OPTION_COLORS : 0) | (ENABLE_EDGES ? RENDER_OPTION_EDGES : 0) | \
+     (ENABLE_WIREFRAME ? RENDER_OPTION_WIREFRAME : 0))
+
+// Top-down map around the player, read from the world's heightfield mips.
+// Kept between frames and resampled only where blocks changed or the view
+// scrolled.
+typedef struct {
+    int zoom;                 // Each cell covers 2^zoom blocks on a side (a mip level)
+    char glyphs[RENDER_MINIMAP_SIZE * RENDER_MINIMAP_SIZE];
+    uint8_t attrs[RENDER_MINIMAP_SIZE * RENDER_MINIMAP_SIZE];
+    uint8_t stale[RENDER_MINIMAP_SIZE]; // Per row: whether it must be resampled
+    int valid;                // Whether the fields below describe the image
+    const World* world;       // World, generation and view the image was sampled for
+    unsigned int generation;
+    int origin_x, origin_y;   // Mip cell at the top-left corner
+    int drawn_zoom;
+} MinimapCache;
+
 // Renderer structure
 typedef struct {
+    Arena arena;              // Framebuffers and per-cell buffers, laid out again on resize
+    Arena scratch;            // Text and other data for one frame, emptied by renderer_clear
     Framebuffer* framebuffer;
     int width;
     int height;
-    float* depth_buffer;
+    RenderDepth* depth_buffer;
     int draw_hud;
     int draw_debug;
-    int wireframe_mode;
+    int options;              // RENDER_OPTION_* flags
     int show_minimap;
+    MinimapCache minimap;
+    ThreadPool* thread_pool;  // Workers for the parallel render pass
+    int thread_count;         // Requested render thread count (0 = auto)
+    int owns_thread_pool;     // Whether thread_pool is destroyed with the renderer
+    Framebuffer* presented;   // Copy of the last frame sent to the terminal
+    int presented_valid;      // Whether the terminal still shows 'presented'
+    int present_bytes;        // Bytes written by the last present
+    int present_cells;        // Cells rewritten by the last present
+    int adaptive_resolution;  // Trace a subset of cells and reproject the rest
+    int subsample_level;      // 0 = every cell traced, 1 = half, 2 = a quarter
+    unsigned int frame_index; // Rotates which subset of cells is traced
+    float ray_cost_us;        // Smoothed cost of tracing one cell
+    float reproject_cost_us;  // Smoothed reprojection cost per screen cell
+    Framebuffer* history;     // World image of the previous frame (no overlays)
+    RenderDepth* history_depth; // Depth of the previous frame
+    RenderCamera history_camera;
+    int history_valid;
+    int world_settled;        // Whether the last world render found nothing to change
+    float* ray_table;         // Camera-space unit ray per cell: forward, right and up planes
+    RayHit* hit_cache;        // Per cell: hit from the last time it was traced
+    uint8_t* cell_state;      // Per cell: whether hit_cache is current, see renderer.c
+    const World* cache_world; // World, generation and light epoch the cache was traced in
+    unsigned int cache_generation;
+    unsigned int cache_light_epoch;
+    int cache_options;        // Options the image was shaded with
+    int highlight_valid;      // Whether the image shows a highlighted block
+    int highlight_x, highlight_y, highlight_z;
 } Renderer;
 
-// Renderer creation and destruction
+// Renderer creation and destruction. renderer_create starts its own render
+// workers; renderer_create_shared draws with a pool the caller owns and may
+// share between renderers (see renderer_set_thread_pool).
 Renderer* renderer_create(int width, int height);
+Renderer* renderer_create_shared(int width, int height, ThreadPool* pool);
 void renderer_destroy(Renderer* renderer);
 
+// Change the screen size in place, keeping options and workers; returns 0
+// (and keeps the old size) when the buffers for a larger size cannot be had
+int renderer_resize(Renderer* renderer, int width, int height);
+
 // Rendering functions
 void renderer_clear(Renderer* renderer);
 void renderer_render_world(Renderer* renderer, World* world, Player* player);
@@ -40,6 +154,14 @@ void renderer_render_hud(Renderer* renderer, Player* player, World* world);
 void renderer_render_debug(Renderer* renderer, Player* player);
 void renderer_render_minimap(Renderer* renderer, World* world, Player* player);
 void renderer_present(Renderer* renderer);
+void renderer_present_frame(Renderer* renderer, const Framebuffer* frame);
+int renderer_encode_frame(Renderer* renderer, const Framebuffer* frame, OutputBuffer* out);
+void renderer_invalidate(Renderer* renderer);
+
+// Whether renderer_render_world would redraw its last image unchanged: the
+// camera, blocks, light, options and highlight are the same and no cell is
+// still being refined. Lets a caller skip frames while nothing moves.
+int renderer_world_current(const Renderer* renderer, const World* world, Player* player);
 
 // Utility functions
 void renderer_set_pixel(Renderer* renderer, int x, int y, char c, int fg, int bg);
@@ -49,6 +171,36 @@ void renderer_draw_text(Renderer* renderer, int x, int y, const char* text, int
 void renderer_toggle_hud(Renderer* renderer);
 void renderer_toggle_debug(Renderer* renderer);
 void renderer_toggle_wireframe(Renderer* renderer);
+void renderer_set_options(Renderer* renderer, int options);
+void renderer_toggle_option(Renderer* renderer, int option);
 void renderer_toggle_minimap(Renderer* renderer);
+void renderer_cycle_minimap_zoom(Renderer* renderer);
+void renderer_set_thread_count(Renderer* renderer, int thread_count);
+void renderer_set_thread_pool(Renderer* renderer, ThreadPool* pool);
+void renderer_set_adaptive_resolution(Renderer* renderer, int enabled);
+
+// Finished frames handed from a render thread to a present thread. Of the
+// three buffers one is being presented, one holds the newest finished frame
+// and one is free to be filled. A new frame replaces a ready one the
+// presenter has not taken, so the render side never waits for output.
+// Frames may change size from one publish to the next.
+#define FRAME_QUEUE_BUFFERS 3
+
+typedef struct {
+    Framebuffer* buffers[FRAME_QUEUE_BUFFERS];
+    int front;                // Being presented
+    int ready;                // Newest finished frame, when fresh
+    int back;                 // Filled by the next publish
+    int fresh;                // Whether ready holds a frame not yet taken
+    int closed;
+    Mutex lock;
+    CondVar available;
+} FrameQueue;
+
+FrameQueue* frame_queue_create(int width, int height);
+void frame_queue_destroy(FrameQueue* queue);
+void frame_queue_publish(FrameQueue* queue, const Framebuffer* frame);
+const Framebuffer* frame_queue_acquire(FrameQueue* queue);
+void frame_queue_close(FrameQueue* queue);
 
 #endif /* RENDERER_H */
@@ -0,0 +1,646 @@
+/**
+ * @file server.c
+ * @brief Telnet server mode: many viewers exploring one shared world
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "server.h"
+#include "config.h"
+#include "terminal.h"
+#include "world.h"
+#include "player.h"
+#include "physics.h"
+#include "renderer.h"
+#include "threadpool.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+typedef SOCKET ServerSocket;
+#define SERVER_NO_SOCKET INVALID_SOCKET
+#define server_close_socket closesocket
+#define server_would_block() (WSAGetLastError() == WSAEWOULDBLOCK)
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+typedef int ServerSocket;
+#define SERVER_NO_SOCKET (-1)
+#define server_close_socket close
+#define server_would_block() (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+#endif
+
+// Telnet commands and options (RFC 854, 857, 858, 1073)
+#define TELNET_SE 240
+#define TELNET_SB 250
+#define TELNET_WILL 251
+#define TELNET_WONT 252
+#define TELNET_DO 253
+#define TELNET_DONT 254
+#define TELNET_IAC 255
+#define TELNET_ECHO 1
+#define TELNET_SGA 3
+#define TELNET_NAWS 31
+
+// Where the telnet parser is within a command
+enum {
+    TELNET_DATA,
+    TELNET_COMMAND,           // After IAC
+    TELNET_OPTION,            // After IAC WILL/WONT/DO/DONT
+    TELNET_SUB,               // Inside IAC SB ... IAC SE
+    TELNET_SUB_COMMAND        // IAC inside a subnegotiation
+};
+
+// Server options
+typedef struct {
+    int port;
+    int max_sessions;
+    int world_size;
+    unsigned int seed;
+    int threads;
+} ServerOptions;
+
+// One connected viewer
+typedef struct {
+    ServerSocket socket;
+    Player* player;
+    Renderer* renderer;
+    KeyState keys;
+    OutputBuffer output;      // Encoded frame not yet fully sent
+    int sent;                 // Bytes of output already sent
+    unsigned long long stalled_since; // When output stopped draining (0 = draining)
+    unsigned char input[64];  // Key bytes not yet parsed
+    int input_length;
+    int telnet_state;
+    unsigned char sub[16];    // Subnegotiation being received
+    int sub_length;
+    int after_cr;             // Last byte was CR (telnet sends CR LF or CR NUL for Enter)
+    int width, height;        // Window size the renderer should have
+    int closing;              // Close once the output has been sent
+} ServerSession;
+
+// Set by SIGINT
+static volatile sig_atomic_t server_stop = 0;
+
+static void server_interrupt(int signal_number) {
+    (void)signal_number;
+    server_stop = 1;
+}
+
+// Parse the command line, returning 0 on bad input
+static int server_parse_options(ServerOptions* options, int argc, char** argv) {
+    options->port = SERVER_PORT;
+    options->max_sessions = SERVER_MAX_SESSIONS;
+    options->world_size = WORLD_WIDTH;
+    options->seed = 1;
+    options->threads = RENDER_THREADS;
+
+    for (int i = 0; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            fprintf(stderr, "server: missing value for %s\n", arg);
+            return 0;
+        }
+
+        if (strcmp(arg, "--port") == 0) {
+            options->port = atoi(value);
+        }
+        else if (strcmp(arg, "--sessions") == 0) {
+            options->max_sessions = atoi(value);
+        }
+        else if (strcmp(arg, "--world") == 0) {
+            options->world_size = atoi(value);
+        }
+        else if (strcmp(arg, "--seed") == 0) {
+            options->seed = (unsigned int)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--threads") == 0) {
+            options->threads = atoi(value);
+        }
+        else {
+            fprintf(stderr, "server: unknown option %s\n", arg);
+            return 0;
+        }
+        i++;
+    }
+
+    if (options->port < 1 || options->port > 65535 || options->max_sessions < 1 ||
+        options->max_sessions > SERVER_MAX_SESSIONS || options->world_size < 1) {
+        fprintf(stderr, "server: port, sessions (1-%d) and world must be valid\n", SERVER_MAX_SESSIONS);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Make a socket non-blocking
+static int server_set_nonblocking(ServerSocket socket) {
+#ifdef _WIN32
+    u_long enabled = 1;
+    return ioctlsocket(socket, FIONBIO, &enabled) == 0;
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+// Open the listening socket on all interfaces
+static ServerSocket server_listen(int port) {
+    ServerSocket listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == SERVER_NO_SOCKET) return SERVER_NO_SOCKET;
+
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((unsigned short)port);
+
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listener, 8) != 0 || !server_set_nonblocking(listener)) {
+        server_close_socket(listener);
+        return SERVER_NO_SOCKET;
+    }
+    return listener;
+}
+
+// Place a player on the ground at the centre of the world
+static void server_spawn_player(Player* player, World* world) {
+    int x = world->width / 2;
+    int y = world->height / 2;
+    player_set_position(player, vec3_create(x + 0.5f, y + 0.5f, (float)world->depth));
+
+    for (int z = world->depth - 3; z >= 0; z--) {
+        if (world_is_solid(world, x, y, z) &&
+            !world_is_solid(world, x, y, z + 1) &&
+            !world_is_solid(world, x, y, z + 2)) {
+            player_set_position(player, vec3_create(x + 0.5f, y + 0.5f, z + 1.0f + player->height));
+            break;
+        }
+    }
+}
+
+// Give a session a renderer of its window size, drawing with the shared
+// workers; a session that has one resizes it in place
+static int server_session_resize(ServerSession* session, ThreadPool* pool) {
+    if (session->renderer) {
+        if (!renderer_resize(session->renderer, session->width, session->height)) return 0;
+    }
+    else {
+        session->renderer = renderer_create_shared(session->width, session->height, pool);
+        if (!session->renderer) return 0;
+    }
+
+    // The client shows whatever was there before; start from a clear screen
+    output_write(&session->output, "\033[0m\033[2J", 8);
+    return 1;
+}
+
+// Set up a session for an accepted connection
+static int server_session_open(ServerSession* session, ServerSocket socket, World* world, ThreadPool* pool) {
+    memset(session, 0, sizeof(ServerSession));
+    session->socket = socket;
+    session->width = SERVER_DEFAULT_WIDTH;
+    session->height = SERVER_DEFAULT_HEIGHT;
+    key_state_clear(&session->keys);
+
+    session->player = player_create();
+    if (!session->player || !output_buffer_init(&session->output,
+        SERVER_DEFAULT_WIDTH * SERVER_DEFAULT_HEIGHT * TERMINAL_BYTES_PER_CELL) ||
+        !server_session_resize(session, pool)) {
+        if (session->player) player_destroy(session->player);
+        output_buffer_free(&session->output);
+        return 0;
+    }
+    server_spawn_player(session->player, world);
+
+    // Character at a time without local echo, and report the window size
+    static const unsigned char negotiation[] = {
+        TELNET_IAC, TELNET_WILL, TELNET_ECHO,
+        TELNET_IAC, TELNET_WILL, TELNET_SGA,
+        TELNET_IAC, TELNET_DO, TELNET_SGA,
+        TELNET_IAC, TELNET_DO, TELNET_NAWS
+    };
+    output_buffer_reset(&session->output);
+    output_write(&session->output, (const char*)negotiation, (int)sizeof(negotiation));
+    output_write(&session->output, "\033[?25l\033[0m\033[2J", 14);
+    return 1;
+}
+
+// Release a session and its connection
+static void server_session_close(ServerSession* session) {
+    server_close_socket(session->socket);
+    session->socket = SERVER_NO_SOCKET;
+    player_destroy(session->player);
+    renderer_destroy(session->renderer);
+    output_buffer_free(&session->output);
+    session->player = NULL;
+    session->renderer = NULL;
+}
+
+// Apply a window size report: IAC SB NAWS w1 w0 h1 h0 IAC SE
+static void server_session_window(ServerSession* session) {
+    if (session->sub_length < 5 || session->sub[0] != TELNET_NAWS) return;
+
+    int width = session->sub[1] << 8 | session->sub[2];
+    int height = session->sub[3] << 8 | session->sub[4];
+    if (width < 1 || height < 1) return;
+
+    session->width = min_int(width, SERVER_MAX_WIDTH);
+    session->height = min_int(height, SERVER_MAX_HEIGHT);
+}
+
+// Feed one byte of key data to the session's keyboard
+static void server_session_key_byte(ServerSession* session, unsigned char c, unsigned long long now) {
+    // Enter arrives as CR LF or CR NUL; the second byte is not a key
+    int after_cr = session->after_cr;
+    session->after_cr = c == '\r';
+    if (after_cr && (c == '\n' || c == 0)) return;
+
+    if (session->input_length == (int)sizeof(session->input)) session->input_length = 0;
+    session->input[session->input_length++] = c;
+
+    int offset = 0;
+    while (offset < session->input_length) {
+        int key;
+        int used = terminal_parse_key(session->input + offset, session->input_length - offset, &key);
+        if (used == 0) break;
+
+        if (key) key_state_event(&session->keys, key, 1, now);
+        offset += used;
+    }
+    session->input_length -= offset;
+    memmove(session->input, session->input + offset, (size_t)session->input_length);
+}
+
+// Separate telnet commands from key data
+static void server_session_byte(ServerSession* session, unsigned char c, unsigned long long now) {
+    switch (session->telnet_state) {
+    case TELNET_DATA:
+        if (c == TELNET_IAC) session->telnet_state = TELNET_COMMAND;
+        else server_session_key_byte(session, c, now);
+        break;
+
+    case TELNET_COMMAND:
+        if (c == TELNET_IAC) {
+            server_session_key_byte(session, c, now);
+            session->telnet_state = TELNET_DATA;
+        }
+        else if (c == TELNET_SB) {
+            session->sub_length = 0;
+            session->telnet_state = TELNET_SUB;
+        }
+        else if (c >= TELNET_WILL && c <= TELNET_DONT) {
+            session->telnet_state = TELNET_OPTION;
+        }
+        else {
+            session->telnet_state = TELNET_DATA;
+        }
+        break;
+
+    case TELNET_OPTION:
+        // Replies to our own requests; nothing else is offered or accepted
+        session->telnet_state = TELNET_DATA;
+        break;
+
+    case TELNET_SUB:
+        if (c == TELNET_IAC) session->telnet_state = TELNET_SUB_COMMAND;
+        else if (session->sub_length < (int)sizeof(session->sub)) session->sub[session->sub_length++] = c;
+        break;
+
+    case TELNET_SUB_COMMAND:
+        if (c == TELNET_SE) {
+            server_session_window(session);
+            session->telnet_state = TELNET_DATA;
+        }
+        else {
+            // IAC IAC inside a subnegotiation is a data byte
+            if (session->sub_length < (int)sizeof(session->sub)) session->sub[session->sub_length++] = c;
+            session->telnet_state = TELNET_SUB;
+        }
+        break;
+    }
+}
+
+// Read everything the client sent; returns 0 once the connection is gone
+static int server_session_read(ServerSession* session, unsigned long long now) {
+    unsigned char buffer[512];
+    for (;;) {
+        int count = (int)recv(session->socket, (char*)buffer, (int)sizeof(buffer), 0);
+        if (count == 0) return 0;
+        if (count < 0) return server_would_block();
+
+        for (int i = 0; i < count; i++) {
+            server_session_byte(session, buffer[i], now);
+        }
+    }
+}
+
+// Send as much pending output as the connection takes; returns 0 when the
+// connection failed or has not taken anything for SERVER_STALL_MS
+static int server_session_send(ServerSession* session, unsigned long long now) {
+    while (session->sent < session->output.size) {
+        int count = (int)send(session->socket, session->output.data + session->sent,
+                              session->output.size - session->sent, 0);
+        if (count < 0) {
+            if (!server_would_block()) return 0;
+            if (session->stalled_since == 0) session->stalled_since = now;
+            return now - session->stalled_since < SERVER_STALL_MS * 1000ULL;
+        }
+        session->sent += count;
+        session->stalled_since = 0;
+    }
+
+    output_buffer_reset(&session->output);
+    session->sent = 0;
+    return 1;
+}
+
+// Act on the keys a session pressed this frame
+static void server_session_control(ServerSession* session, World* world) {
+    KeyState* keys = &session->keys;
+    Player* player = session->player;
+
+    if (key_state_pressed(keys, 'q')) {
+        output_write(&session->output, "\033[0m\033[2J\033[H\033[?25h", 17);
+        session->closing = 1;
+        return;
+    }
+
+    // Player movement
+    float forward = 0.0f;
+    float right = 0.0f;
+    if (key_state_held(keys, 'i')) forward += 1.0f;
+    if (key_state_held(keys, 'k')) forward -= 1.0f;
+    if (key_state_held(keys, 'l')) right += 1.0f;
+    if (key_state_held(keys, 'j')) right -= 1.0f;
+    player_move(player, world, forward, right);
+
+    // Player looking
+    if (key_state_held(keys, 'w')) player_rotate(player, PLAYER_TURN_SPEED, 0.0f);
+    if (key_state_held(keys, 's')) player_rotate(player, -PLAYER_TURN_SPEED, 0.0f);
+    if (key_state_held(keys, 'a')) player_rotate(player, 0.0f, -PLAYER_TURN_SPEED);
+    if (key_state_held(keys, 'd')) player_rotate(player, 0.0f, PLAYER_TURN_SPEED);
+
+    // Jump and fly
+    if (key_state_pressed(keys, ' ')) player_jump(player);
+    if (key_state_pressed(keys, 'f')) player->flying = !player->flying;
+
+    // Block interaction changes the world every session sees
+    player_update_target(player, world);
+    if (key_state_pressed(keys, 'e')) player_place_block(player, world, player->selected_slot);
+    if (key_state_pressed(keys, 'r')) player_break_block(player, world);
+
+    for (int i = 1; i <= 9; i++) {
+        if (key_state_pressed(keys, '0' + i)) player_select_slot(player, i);
+    }
+
+    // Overlays
+    if (key_state_pressed(keys, 'h')) renderer_toggle_hud(session->renderer);
+    if (key_state_pressed(keys, 'm')) renderer_toggle_minimap(session->renderer);
+    if (key_state_pressed(keys, 'n')) renderer_cycle_minimap_zoom(session->renderer);
+
+    // Render options, e.g. fog and shading off to send less over a slow link
+    if (key_state_pressed(keys, 'g')) renderer_toggle_option(session->renderer, RENDER_OPTION_FOG);
+    if (key_state_pressed(keys, 'b')) renderer_toggle_option(session->renderer, RENDER_OPTION_SHADING);
+    if (key_state_pressed(keys, 'c')) renderer_toggle_option(session->renderer, RENDER_OPTION_COLORS);
+    if (key_state_pressed(keys, 'x')) renderer_toggle_option(session->renderer, RENDER_OPTION_EDGES);
+    if (key_state_pressed(keys, 'v')) renderer_toggle_wireframe(session->renderer);
+}
+
+// Telnet escapes data bytes equal to IAC by doubling them
+static void server_escape_output(OutputBuffer* out, int start) {
+    int extra = 0;
+    for (int i = start; i < out->size; i++) {
+        if ((unsigned char)out->data[i] == TELNET_IAC) extra++;
+    }
+    if (extra == 0) return;
+
+    // Grow by the escapes, then spread the bytes out from the end
+    static const char room[16] = { 0 };
+    int size = out->size;
+    for (int added = 0; added < extra; added += 16) {
+        if (!output_write(out, room, min_int(extra - added, 16))) {
+            out->size = size;
+            return;
+        }
+    }
+    for (int i = size - 1, j = out->size - 1; i >= start; i--) {
+        out->data[j--] = out->data[i];
+        if ((unsigned char)out->data[i] == TELNET_IAC) out->data[j--] = (char)TELNET_IAC;
+    }
+}
+
+// Draw a session's view and queue the cells that changed
+static void server_session_render(ServerSession* session, World* world) {
+    Renderer* renderer = session->renderer;
+
+    renderer_clear(renderer);
+    renderer_render_world(renderer, world, session->player);
+    renderer_render_hud(renderer, session->player, world);
+    renderer_render_minimap(renderer, world, session->player);
+
+    int start = session->output.size;
+    renderer_encode_frame(renderer, renderer->framebuffer, &session->output);
+    server_escape_output(&session->output, start);
+}
+
+// Sleep until the deadline or until a socket has something to read or can
+// take pending output
+static void server_wait(ServerSocket listener, ServerSession* sessions, int max_sessions,
+                        unsigned long long deadline) {
+    unsigned long long now = get_time_us();
+    if (now >= deadline) return;
+
+    fd_set readable, writable;
+    FD_ZERO(&readable);
+    FD_ZERO(&writable);
+    FD_SET(listener, &readable);
+    ServerSocket highest = listener;
+
+    for (int i = 0; i < max_sessions; i++) {
+        ServerSession* session = &sessions[i];
+        if (session->socket == SERVER_NO_SOCKET) continue;
+
+        FD_SET(session->socket, &readable);
+        if (session->sent < session->output.size) FD_SET(session->socket, &writable);
+        if (session->socket > highest) highest = session->socket;
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = (long)((deadline - now) / 1000000);
+    timeout.tv_usec = (long)((deadline - now) % 1000000);
+    select((int)highest + 1, &readable, &writable, NULL, &timeout);
+}
+
+// Run the server
+int server_run(int argc, char** argv) {
+    ServerOptions options;
+    if (!server_parse_options(&options, argc, argv)) return 1;
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "server: cannot start Winsock\n");
+        return 1;
+    }
+#else
+    // A viewer hanging up mid-frame must not end the server
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    ServerSocket listener = server_listen(options.port);
+    if (listener == SERVER_NO_SOCKET) {
+        fprintf(stderr, "server: cannot listen on port %d\n", options.port);
+        return 1;
+    }
+
+    // Frames are assembled per session; nothing is drawn on the local terminal
+    terminal_set_headless(1);
+
+    World* world = world_create(options.world_size, options.world_size, WORLD_DEPTH);
+    ServerSession* sessions = (ServerSession*)calloc((size_t)options.max_sessions, sizeof(ServerSession));
+    ThreadPool* pool = NULL;
+    int threads = options.threads > 0 ? options.threads : thread_cpu_count();
+    if (threads > 1) pool = threadpool_create(threads);
+    if (!world || !sessions) {
+        fprintf(stderr, "server: out of memory\n");
+        if (world) world_destroy(world);
+        free(sessions);
+        threadpool_destroy(pool);
+        server_close_socket(listener);
+        return 1;
+    }
+    world_init_block_types(world);
+    world_generate_terrain(world, options.seed);
+    world_generate_structures(world, options.seed + 100);
+    world_set_time(world, 0.5f);
+
+    for (int i = 0; i < options.max_sessions; i++) {
+        sessions[i].socket = SERVER_NO_SOCKET;
+    }
+
+    fprintf(stderr, "server: listening on port %d (telnet), Ctrl+C to stop\n", options.port);
+    signal(SIGINT, server_interrupt);
+
+    PhysicsClock clock;
+    physics_clock_init(&clock);
+    unsigned long long period = 1000000ULL / TARGET_FPS;
+    unsigned long long last_frame = get_time_us();
+    unsigned long long deadline = last_frame + period;
+
+    while (!server_stop) {
+        unsigned long long now = get_time_us();
+
+        // Accept new viewers
+        for (;;) {
+            ServerSocket client = accept(listener, NULL, NULL);
+            if (client == SERVER_NO_SOCKET) break;
+
+            int slot = -1;
+            for (int i = 0; i < options.max_sessions && slot < 0; i++) {
+                if (sessions[i].socket == SERVER_NO_SOCKET) slot = i;
+            }
+            if (slot < 0 || !server_set_nonblocking(client) ||
+                !server_session_open(&sessions[slot], client, world, pool)) {
+                server_close_socket(client);
+                if (slot >= 0) sessions[slot].socket = SERVER_NO_SOCKET;
+            }
+        }
+
+        // Input arrives between frames; keys are applied on the next one
+        for (int i = 0; i < options.max_sessions; i++) {
+            ServerSession* session = &sessions[i];
+            if (session->socket == SERVER_NO_SOCKET) continue;
+            if (!server_session_read(session, now) || !server_session_send(session, now)) {
+                server_session_close(session);
+            }
+        }
+
+        if (now >= deadline) {
+            float seconds = (now - last_frame) / 1000000.0f;
+            last_frame = now;
+            deadline = now - deadline < period ? deadline + period : now + period;
+
+            // Shared world: time and light once for everybody
+            world_set_time(world, world->time_of_day + 0.001f * seconds);
+            world_update_lighting(world);
+
+            // Keyboards and players, in fixed simulation steps
+            int steps = physics_clock_advance(&clock, seconds);
+            for (int i = 0; i < options.max_sessions; i++) {
+                ServerSession* session = &sessions[i];
+                if (session->socket == SERVER_NO_SOCKET || session->closing) continue;
+
+                key_state_release(&session->keys, now, 1);
+                server_session_control(session, world);
+                key_state_begin_frame(&session->keys);
+            }
+            for (int step = 0; step < steps; step++) {
+                for (int i = 0; i < options.max_sessions; i++) {
+                    if (sessions[i].socket != SERVER_NO_SOCKET) player_update(sessions[i].player, world);
+                }
+            }
+
+            // Views: each session's rays are spread over the shared workers.
+            // A session still sending its last frame gets no new one; its
+            // next frame then carries everything that changed meanwhile.
+            for (int i = 0; i < options.max_sessions; i++) {
+                ServerSession* session = &sessions[i];
+                if (session->socket == SERVER_NO_SOCKET || session->closing ||
+                    session->sent < session->output.size) {
+                    continue;
+                }
+
+                player_set_interpolation(session->player, clock.alpha);
+                player_update_target(session->player, world);
+                if ((session->width != session->renderer->width || session->height != session->renderer->height) &&
+                    !server_session_resize(session, pool)) {
+                    session->closing = 1;
+                    continue;
+                }
+                server_session_render(session, world);
+            }
+
+            for (int i = 0; i < options.max_sessions; i++) {
+                ServerSession* session = &sessions[i];
+                if (session->socket == SERVER_NO_SOCKET) continue;
+                if (!server_session_send(session, now) ||
+                    (session->closing && session->sent >= session->output.size)) {
+                    server_session_close(session);
+                }
+            }
+        }
+
+        server_wait(listener, sessions, options.max_sessions, deadline);
+    }
+
+    fprintf(stderr, "server: stopping\n");
+    for (int i = 0; i < options.max_sessions; i++) {
+        if (sessions[i].socket != SERVER_NO_SOCKET) server_session_close(&sessions[i]);
+    }
+    free(sessions);
+    world_destroy(world);
+    threadpool_destroy(pool);
+    server_close_socket(listener);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    terminal_set_headless(0);
+    return 0;
+}
@@ -0,0 +1,23 @@
+/**
+ * @file server.h
+ * @brief Telnet server mode: many viewers exploring one shared world
+ *
+ * Every connection is a session with its own player, renderer and
+ * keyboard; the world and the render workers are shared. Each frame a
+ * session is sent the cells that changed since its last frame, and a
+ * session that has not taken all of its last frame yet is skipped until it
+ * has, so a slow viewer never holds up the others.
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+// Run the server with the arguments that follow --server and return the
+// process exit code. Runs until interrupted. Options:
+//   --port N          TCP port (default SERVER_PORT)
+//   --sessions N      connected viewers at most (default SERVER_MAX_SESSIONS)
+//   --world W         world width and height in blocks (default WORLD_WIDTH)
+//   --seed S          world seed (default 1)
+//   --threads N       render threads shared by all sessions (0 = auto)
+int server_run(int argc, char** argv);
+
+#endif /* SERVER_H */
@@ -11,31 +11,85 @@
 
 #include "terminal.h"
 #include "config.h"
+#include "utils.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef _WIN32
 #include <windows.h>
-#include <conio.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
 #else
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <sys/ioctl.h>
+#include <sys/select.h>
+#include <poll.h>
+#include <errno.h>
+#include <signal.h>
 #include <time.h>
 #endif
 
  // Global state
 static int terminal_width = 0;
 static int terminal_height = 0;
-static char keystate[256] = { 0 };
-static char keyheld[256] = { 0 };
+static OutputBuffer frame_output = { 0 };
+static int headless_output = 0;  // Frames are assembled but never written
+
+static KeyState keyboard;        // Keys of the local terminal
 
 #ifdef _WIN32
 static HANDLE hConsole = NULL;
 static DWORD dwOriginalMode = 0;
+static int output_backend = TERMINAL_BACKEND_VT;
+static CHAR_INFO* cell_buffer = NULL;
+static int cell_capacity = 0;
+static HANDLE hInput = NULL;
+static DWORD dwOriginalInputMode = 0;
+static short vkey_keys[256] = { 0 };  // Key each virtual key went down as
+static HANDLE wait_timer = NULL;       // See terminal_wait_timer
 #else
 static struct termios original_termios;
+static unsigned char input_bytes[64];  // Bytes read but not yet parsed
+static int input_length = 0;
+static volatile sig_atomic_t window_resized = 0; // Set by SIGWINCH
+#endif
+
+static OutputBuffer* terminal_output(void);
+
+// Read the window size into terminal_width and terminal_height
+static int terminal_query_size(void) {
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO csbi;
+    if (!GetConsoleScreenBufferInfo(hConsole, &csbi)) {
+        return 0;
+    }
+
+    terminal_width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
+    terminal_height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
+#else
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0 || ws.ws_row == 0) {
+        terminal_width = 80;
+        terminal_height = 24;
+    }
+    else {
+        terminal_width = ws.ws_col;
+        terminal_height = ws.ws_row;
+    }
+#endif
+    return 1;
+}
+
+#ifndef _WIN32
+// SIGWINCH handler: the size is read again by the next terminal_process_input
+static void terminal_window_changed(int signal_number) {
+    (void)signal_number;
+    window_resized = 1;
+}
 #endif
 
 // Initialize the terminal
@@ -58,22 +112,26 @@ int terminal_init(void) {
         return 0;
     }
 
-    // Get console screen buffer info
-    CONSOLE_SCREEN_BUFFER_INFO csbi;
-    if (!GetConsoleScreenBufferInfo(hConsole, &csbi)) {
+    // Get terminal size
+    if (!terminal_query_size()) {
         return 0;
     }
 
-    // Set terminal size
-    terminal_width = csbi.srWindow.Right - csbi.srWindow.Left + 1;
-    terminal_height = csbi.srWindow.Bottom - csbi.srWindow.Top + 1;
-
     // Hide cursor
     CONSOLE_CURSOR_INFO cursor_info;
     cursor_info.dwSize = 1;
     cursor_info.bVisible = FALSE;
     SetConsoleCursorInfo(hConsole, &cursor_info);
 
+    // Read raw key events: no line editing, echo or mouse selection
+    hInput = GetStdHandle(STD_INPUT_HANDLE);
+    if (hInput != INVALID_HANDLE_VALUE && GetConsoleMode(hInput, &dwOriginalInputMode)) {
+        SetConsoleMode(hInput, ENABLE_EXTENDED_FLAGS | ENABLE_WINDOW_INPUT);
+    }
+    else {
+        hInput = NULL;
+    }
+
     // Clear screen
     system("cls");
 #else
@@ -93,25 +151,32 @@ int terminal_init(void) {
     int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
     fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
 
-    // Get terminal size
-    struct winsize ws;
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1) {
-        terminal_width = 80;
-        terminal_height = 24;
-    }
-    else {
-        terminal_width = ws.ws_col;
-        terminal_height = ws.ws_row;
-    }
+    // Get terminal size, and again whenever the window changes
+    terminal_query_size();
+    signal(SIGWINCH, terminal_window_changed);
 
     // Hide cursor and clear screen
-    printf("\033[?25l");
-    printf("\033[2J");
+    terminal_write("\033[?25l", 6);
+    terminal_clear();
+    terminal_flush();
+#endif
+
+    // Preallocate the frame buffer for the current terminal size
+    output_buffer_free(&frame_output);
+    terminal_output();
+#ifdef _WIN32
+    if (TERMINAL_OUTPUT_BACKEND == TERMINAL_BACKEND_CONSOLE) {
+        terminal_set_backend(TERMINAL_BACKEND_CONSOLE);
+    }
 #endif
 
     // Clear key states
-    memset(keystate, 0, sizeof(keystate));
-    memset(keyheld, 0, sizeof(keyheld));
+    key_state_clear(&keyboard);
+#ifdef _WIN32
+    memset(vkey_keys, 0, sizeof(vkey_keys));
+#else
+    input_length = 0;
+#endif
 
     return 1;
 }
@@ -129,225 +194,722 @@ void terminal_cleanup(void) {
         cursor_info.bVisible = TRUE;
         SetConsoleCursorInfo(hConsole, &cursor_info);
     }
+    if (hInput != NULL) {
+        SetConsoleMode(hInput, dwOriginalInputMode);
+    }
 #else
     // Restore terminal attributes
     tcsetattr(STDIN_FILENO, TCSANOW, &original_termios);
+    signal(SIGWINCH, SIG_DFL);
 
     // Show cursor
-    printf("\033[?25h");
+    terminal_write("\033[?25h", 6);
 #endif
 
     // Reset colors and clear screen
     terminal_reset_color();
     terminal_clear();
     terminal_set_cursor(0, 0);
+    terminal_flush();
+
+    // Release output buffers
+    output_buffer_free(&frame_output);
+#ifdef _WIN32
+    free(cell_buffer);
+    cell_buffer = NULL;
+    cell_capacity = 0;
+    if (wait_timer != NULL) {
+        CloseHandle(wait_timer);
+        wait_timer = NULL;
+    }
+#endif
 }
 
-// Process input
-void terminal_process_input(void) {
-    // Reset key states (but maintain held states)
-    for (int i = 0; i < 256; i++) {
-        keyheld[i] = keystate[i] || keyheld[i];
-        keystate[i] = 0;
+// Mark a key code in a key bitset
+static void key_bits_set(uint32_t* bits, int key, int value) {
+    uint32_t mask = (uint32_t)1 << (key & 31);
+    if (value) bits[key >> 5] |= mask;
+    else bits[key >> 5] &= ~mask;
+}
+
+static int key_bits_get(const uint32_t* bits, int key) {
+    if (key < 0 || key >= KEY_COUNT) return 0;
+    return (bits[key >> 5] >> (key & 31)) & 1;
+}
+
+// Named keys with an ASCII equivalent are stored as that character, so
+// terminal_key_pressed(' ') and terminal_special_key_pressed(KEY_SPACE) agree
+static int terminal_key_code(int key) {
+    switch (key) {
+    case KEY_ENTER: return '\r';
+    case KEY_ESCAPE: return 27;
+    case KEY_SPACE: return ' ';
+    case KEY_BACKSPACE: return 8;
+    case KEY_TAB: return '\t';
+    default: return key;
     }
+}
 
-#ifdef _WIN32
-    // Check for key presses using _kbhit and _getch
-    while (_kbhit()) {
-        int ch = _getch();
-
-        // Handle special keys (arrow keys, etc.)
-        if (ch == 0 || ch == 0xE0) {
-            ch = _getch();
-
-            // Map extended keys to values within 0-255 range
-            switch (ch) {
-            case 72: if (KEY_UP < 256) keystate[KEY_UP] = 1; break;
-            case 80: if (KEY_DOWN < 256) keystate[KEY_DOWN] = 1; break;
-            case 75: if (KEY_LEFT < 256) keystate[KEY_LEFT] = 1; break;
-            case 77: if (KEY_RIGHT < 256) keystate[KEY_RIGHT] = 1; break;
-            case 71: if (KEY_HOME < 256) keystate[KEY_HOME] = 1; break;
-            case 79: if (KEY_END < 256) keystate[KEY_END] = 1; break;
-            case 73: if (KEY_PGUP < 256) keystate[KEY_PGUP] = 1; break;
-            case 81: if (KEY_PGDN < 256) keystate[KEY_PGDN] = 1; break;
-            case 82: if (KEY_INSERT < 256) keystate[KEY_INSERT] = 1; break;
-            case 83: if (KEY_DELETE < 256) keystate[KEY_DELETE] = 1; break;
-            case 59: if (KEY_F1 < 256) keystate[KEY_F1] = 1; break;
-            case 60: if (KEY_F2 < 256) keystate[KEY_F2] = 1; break;
-            case 61: if (KEY_F3 < 256) keystate[KEY_F3] = 1; break;
-            case 62: if (KEY_F4 < 256) keystate[KEY_F4] = 1; break;
-            case 63: if (KEY_F5 < 256) keystate[KEY_F5] = 1; break;
-            case 64: if (KEY_F6 < 256) keystate[KEY_F6] = 1; break;
-            case 65: if (KEY_F7 < 256) keystate[KEY_F7] = 1; break;
-            case 66: if (KEY_F8 < 256) keystate[KEY_F8] = 1; break;
-            case 67: if (KEY_F9 < 256) keystate[KEY_F9] = 1; break;
-            case 68: if (KEY_F10 < 256) keystate[KEY_F10] = 1; break;
-            case 133: if (KEY_F11 < 256) keystate[KEY_F11] = 1; break;
-            case 134: if (KEY_F12 < 256) keystate[KEY_F12] = 1; break;
+// Release every key and drop the frame's events
+void key_state_clear(KeyState* keys) {
+    if (!keys) return;
+
+    memset(keys, 0, sizeof(KeyState));
+}
+
+// Presses and events only last one frame; held keys stay down
+void key_state_begin_frame(KeyState* keys) {
+    if (!keys) return;
+
+    memset(keys->pressed, 0, sizeof(keys->pressed));
+    keys->event_count = 0;
+    keys->event_next = 0;
+}
+
+// Record a key going down (or repeating) or up
+void key_state_event(KeyState* keys, int key, int down, unsigned long long now) {
+    if (!keys) return;
+
+    key = terminal_key_code(key);
+    if (key <= 0 || key >= KEY_COUNT) return;
+
+    int repeat = key_bits_get(keys->down, key);
+    if (down) {
+        key_bits_set(keys->down, key, 1);
+        key_bits_set(keys->pressed, key, 1);
+        keys->seen_us[key] = now;
+        keys->repeating[key] = (char)repeat;
+    }
+    else {
+        if (!repeat) return;
+        key_bits_set(keys->down, key, 0);
+    }
+
+    if (keys->event_count < TERMINAL_INPUT_EVENTS) {
+        TerminalKeyEvent* event = &keys->events[keys->event_count++];
+        event->key = key;
+        event->down = down;
+        event->repeat = down && repeat;
+        event->time_us = now;
+    }
+}
+
+// Release held keys: all of them, or only those that stopped repeating
+void key_state_release(KeyState* keys, unsigned long long now, int stale_only) {
+    if (!keys) return;
+
+    for (int word = 0; word < KEY_STATE_WORDS; word++) {
+        uint32_t bits = keys->down[word];
+        for (int key = word * 32; bits; key++, bits >>= 1) {
+            if (!(bits & 1)) continue;
+
+            // A terminal repeats a held key; without a repeat it was let go
+            unsigned long long timeout = keys->repeating[key] ? TERMINAL_KEY_REPEAT_MS : TERMINAL_KEY_HOLD_MS;
+            if (!stale_only || now - keys->seen_us[key] > timeout * 1000) {
+                key_state_event(keys, key, 0, now);
             }
         }
-        else {
-            // Map normal keys and special keys
-            switch (ch) {
-            case 8: if (KEY_BACKSPACE < 256) keystate[KEY_BACKSPACE] = 1; break;
-            case 9: if (KEY_TAB < 256) keystate[KEY_TAB] = 1; break;
-            case 13: if (KEY_ENTER < 256) keystate[KEY_ENTER] = 1; break;
-            case 27: if (KEY_ESCAPE < 256) keystate[KEY_ESCAPE] = 1; break;
-            case 32: if (KEY_SPACE < 256) keystate[KEY_SPACE] = 1; break;
-            default: keystate[ch & 0xFF] = 1; break;
+    }
+}
+
+// Take the next event of the frame
+int key_state_poll(KeyState* keys, TerminalKeyEvent* event) {
+    if (!keys || !event || keys->event_next >= keys->event_count) return 0;
+
+    *event = keys->events[keys->event_next++];
+    return 1;
+}
+
+int key_state_pressed(const KeyState* keys, int key) {
+    return keys ? key_bits_get(keys->pressed, terminal_key_code(key)) : 0;
+}
+
+int key_state_held(const KeyState* keys, int key) {
+    return keys ? key_bits_get(keys->down, terminal_key_code(key)) : 0;
+}
+
+// Key named by a byte outside an escape sequence
+static int terminal_char_key(unsigned char c) {
+    switch (c) {
+    case 127: case 8: return KEY_BACKSPACE;
+    case 9: return KEY_TAB;
+    case 10: case 13: return KEY_ENTER;
+    case 27: return KEY_ESCAPE;
+    case 32: return KEY_SPACE;
+    default: return c;
+    }
+}
+
+// Key named by "ESC [ <param> ~"
+static int terminal_tilde_key(int param) {
+    switch (param) {
+    case 1: case 7: return KEY_HOME;
+    case 2: return KEY_INSERT;
+    case 3: return KEY_DELETE;
+    case 4: case 8: return KEY_END;
+    case 5: return KEY_PGUP;
+    case 6: return KEY_PGDN;
+    case 11: case 12: case 13: case 14: case 15: return KEY_F1 + (param - 11);
+    case 17: case 18: case 19: case 20: case 21: return KEY_F6 + (param - 17);
+    case 23: case 24: return KEY_F11 + (param - 23);
+    default: return 0;
+    }
+}
+
+// Key named by the final byte of "ESC [ ... X" or "ESC O X"
+static int terminal_final_key(unsigned char c) {
+    switch (c) {
+    case 'A': return KEY_UP;
+    case 'B': return KEY_DOWN;
+    case 'C': return KEY_RIGHT;
+    case 'D': return KEY_LEFT;
+    case 'H': return KEY_HOME;
+    case 'F': return KEY_END;
+    case 'P': return KEY_F1;
+    case 'Q': return KEY_F2;
+    case 'R': return KEY_F3;
+    case 'S': return KEY_F4;
+    default: return 0;
+    }
+}
+
+// Parse the key at the start of bytes. Returns the bytes it spans, or 0 if
+// the escape sequence is not complete yet; *key is 0 for sequences that
+// name no key.
+int terminal_parse_key(const unsigned char* bytes, int length, int* key) {
+    *key = 0;
+    if (bytes[0] != 27) {
+        *key = terminal_char_key(bytes[0]);
+        return 1;
+    }
+    if (length < 2) return 0;
+
+    // CSI: parameter bytes, then a final byte (modifiers such as "1;5A" are ignored)
+    if (bytes[1] == '[') {
+        int param = 0;
+        int first = -1;
+        int i = 2;
+        for (; i < length && bytes[i] >= 0x20 && bytes[i] <= 0x3F; i++) {
+            if (bytes[i] >= '0' && bytes[i] <= '9') {
+                param = param * 10 + (bytes[i] - '0');
+            }
+            else if (first < 0) {
+                first = param;
             }
         }
+        if (i >= length) return 0;
+
+        if (first < 0) first = param;
+        *key = bytes[i] == '~' ? terminal_tilde_key(first) : terminal_final_key(bytes[i]);
+        return i + 1;
     }
-#else
-    // Check for key presses using read
-    char c;
-    while (read(STDIN_FILENO, &c, 1) > 0) {
-        // Handle escape sequences
-        if (c == 27) {
-            char seq[4] = { 0 };
-            if (read(STDIN_FILENO, &seq[0], 1) <= 0) {
-                if (KEY_ESCAPE < 256) keystate[KEY_ESCAPE] = 1;
-                continue;
-            }
 
-            if (seq[0] == '[') {
-                if (read(STDIN_FILENO, &seq[1], 1) <= 0) {
-                    continue;
-                }
-
-                if (seq[1] >= '0' && seq[1] <= '9') {
-                    if (read(STDIN_FILENO, &seq[2], 1) <= 0) {
-                        continue;
-                    }
-
-                    if (seq[2] == '~') {
-                        switch (seq[1]) {
-                        case '1': if (KEY_HOME < 256) keystate[KEY_HOME] = 1; break;
-                        case '2': if (KEY_INSERT < 256) keystate[KEY_INSERT] = 1; break;
-                        case '3': if (KEY_DELETE < 256) keystate[KEY_DELETE] = 1; break;
-                        case '4': if (KEY_END < 256) keystate[KEY_END] = 1; break;
-                        case '5': if (KEY_PGUP < 256) keystate[KEY_PGUP] = 1; break;
-                        case '6': if (KEY_PGDN < 256) keystate[KEY_PGDN] = 1; break;
-                        }
-                    }
-                }
-                else {
-                    switch (seq[1]) {
-                    case 'A': if (KEY_UP < 256) keystate[KEY_UP] = 1; break;
-                    case 'B': if (KEY_DOWN < 256) keystate[KEY_DOWN] = 1; break;
-                    case 'C': if (KEY_RIGHT < 256) keystate[KEY_RIGHT] = 1; break;
-                    case 'D': if (KEY_LEFT < 256) keystate[KEY_LEFT] = 1; break;
-                    case 'H': if (KEY_HOME < 256) keystate[KEY_HOME] = 1; break;
-                    case 'F': if (KEY_END < 256) keystate[KEY_END] = 1; break;
-                    }
-                }
+    // SS3: F1-F4, and keypad keys in application mode
+    if (bytes[1] == 'O') {
+        if (length < 3) return 0;
+        *key = terminal_final_key(bytes[2]);
+        return 3;
+    }
+
+    // Escape on its own, followed by whatever came next
+    *key = KEY_ESCAPE;
+    return 1;
+}
+
+#ifdef _WIN32
+// Key code for a virtual key, or 0 if it has none of its own
+static int terminal_virtual_key(WORD vkey) {
+    if (vkey >= VK_F1 && vkey <= VK_F12) return KEY_F1 + (vkey - VK_F1);
+
+    switch (vkey) {
+    case VK_UP: return KEY_UP;
+    case VK_DOWN: return KEY_DOWN;
+    case VK_LEFT: return KEY_LEFT;
+    case VK_RIGHT: return KEY_RIGHT;
+    case VK_HOME: return KEY_HOME;
+    case VK_END: return KEY_END;
+    case VK_PRIOR: return KEY_PGUP;
+    case VK_NEXT: return KEY_PGDN;
+    case VK_INSERT: return KEY_INSERT;
+    case VK_DELETE: return KEY_DELETE;
+    case VK_RETURN: return KEY_ENTER;
+    case VK_ESCAPE: return KEY_ESCAPE;
+    case VK_SPACE: return KEY_SPACE;
+    case VK_BACK: return KEY_BACKSPACE;
+    case VK_TAB: return KEY_TAB;
+    default: return 0;
+    }
+}
+
+// Translate one console key record
+static void terminal_console_key(const KEY_EVENT_RECORD* record, unsigned long long now) {
+    WORD vkey = record->wVirtualKeyCode & 0xFF;
+
+    // The key a virtual key went down as is the one it releases, even if
+    // a modifier changed the character in between
+    if (record->bKeyDown) {
+        int key = terminal_virtual_key(vkey);
+        if (!key) key = (unsigned char)record->uChar.AsciiChar;
+        if (!key) return;
+
+        vkey_keys[vkey] = (short)key;
+        key_state_event(&keyboard, key, 1, now);
+    }
+    else if (vkey_keys[vkey]) {
+        key_state_event(&keyboard, vkey_keys[vkey], 0, now);
+        vkey_keys[vkey] = 0;
+    }
+}
+
+// Drain console key-down and key-up events without blocking
+static void terminal_read_input(unsigned long long now) {
+    if (hInput == NULL || hInput == INVALID_HANDLE_VALUE) return;
+
+    INPUT_RECORD records[64];
+    DWORD pending = 0;
+    while (GetNumberOfConsoleInputEvents(hInput, &pending) && pending > 0) {
+        DWORD count = 0;
+        DWORD wanted = pending < 64 ? pending : 64;
+        if (!ReadConsoleInputA(hInput, records, wanted, &count) || count == 0) break;
+
+        for (DWORD i = 0; i < count; i++) {
+            if (records[i].EventType == KEY_EVENT) {
+                terminal_console_key(&records[i].Event.KeyEvent, now);
             }
-            else if (seq[0] == 'O') {
-                if (read(STDIN_FILENO, &seq[1], 1) <= 0) {
-                    continue;
-                }
-
-                switch (seq[1]) {
-                case 'P': if (KEY_F1 < 256) keystate[KEY_F1] = 1; break;
-                case 'Q': if (KEY_F2 < 256) keystate[KEY_F2] = 1; break;
-                case 'R': if (KEY_F3 < 256) keystate[KEY_F3] = 1; break;
-                case 'S': if (KEY_F4 < 256) keystate[KEY_F4] = 1; break;
-                }
+            else if (records[i].EventType == WINDOW_BUFFER_SIZE_EVENT) {
+                terminal_query_size();
             }
-        }
-        else {
-            // Map normal keys
-            switch (c) {
-            case 127: if (KEY_BACKSPACE < 256) keystate[KEY_BACKSPACE] = 1; break;
-            case 9: if (KEY_TAB < 256) keystate[KEY_TAB] = 1; break;
-            case 10: if (KEY_ENTER < 256) keystate[KEY_ENTER] = 1; break;
-            case 27: if (KEY_ESCAPE < 256) keystate[KEY_ESCAPE] = 1; break;
-            case 32: if (KEY_SPACE < 256) keystate[KEY_SPACE] = 1; break;
-            default: keystate[(unsigned char)c] = 1; break;
+            else if (records[i].EventType == FOCUS_EVENT && !records[i].Event.FocusEvent.bSetFocus) {
+                // Key-up events go to the window that has focus
+                key_state_release(&keyboard, now, 0);
+                memset(vkey_keys, 0, sizeof(vkey_keys));
             }
         }
     }
+}
+#else
+// Read everything available in bulk and turn it into key events. A
+// sequence cut off at the end of a read is finished by the next one; an
+// escape with nothing after it by the next frame is the Escape key.
+static void terminal_read_input(unsigned long long now) {
+    int stale = input_length > 0;
+    int received = 0;
+
+    for (;;) {
+        int space = (int)sizeof(input_bytes) - input_length;
+        if (space <= 0) break;
+
+        ssize_t count = read(STDIN_FILENO, input_bytes + input_length, (size_t)space);
+        if (count <= 0) break;
+        input_length += (int)count;
+        received = 1;
+
+        int offset = 0;
+        while (offset < input_length) {
+            int key;
+            int used = terminal_parse_key(input_bytes + offset, input_length - offset, &key);
+            if (used == 0) break;
+
+            if (key) key_state_event(&keyboard, key, 1, now);
+            offset += used;
+        }
+
+        // Keep the unfinished sequence; a buffer full of one is garbage
+        input_length -= offset;
+        memmove(input_bytes, input_bytes + offset, (size_t)input_length);
+        if (input_length == (int)sizeof(input_bytes)) input_length = 0;
+    }
+
+    if (stale && !received) {
+        key_state_event(&keyboard, KEY_ESCAPE, 1, now);
+        input_length = 0;
+    }
+
+    // Terminals only send presses; let keys go once they stop repeating
+    key_state_release(&keyboard, now, 1);
+}
+#endif
+
+// Process input
+int terminal_process_input(void) {
+#ifndef _WIN32
+    if (window_resized) {
+        window_resized = 0;
+        terminal_query_size();
+    }
 #endif
+
+    key_state_begin_frame(&keyboard);
+    terminal_read_input(get_time_us());
+    return keyboard.event_count;
+}
+
+// Take the next key event read by terminal_process_input
+int terminal_poll_event(TerminalKeyEvent* event) {
+    return key_state_poll(&keyboard, event);
 }
 
 // Check if a key was pressed
 int terminal_key_pressed(char key) {
-    return keystate[(unsigned char)key];
+    return key_state_pressed(&keyboard, (unsigned char)key);
 }
 
 // Check if a key is held down
 int terminal_key_held(char key) {
-    return keyheld[(unsigned char)key];
+    return key_state_held(&keyboard, (unsigned char)key);
 }
 
 // Check if a special key was pressed
 int terminal_special_key_pressed(int key) {
-    if (key >= 0 && key < 256) {
-        return keystate[key];
+    return key_state_pressed(&keyboard, key);
+}
+
+// Check if a special key is held down
+int terminal_special_key_held(int key) {
+    return key_state_held(&keyboard, key);
+}
+
+// Append a non-negative decimal number
+static int output_write_uint(OutputBuffer* out, unsigned int value) {
+    char digits[12];
+    int count = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - count] = (char)('0' + value % 10);
+        value /= 10;
+        count++;
+    } while (value > 0);
+
+    return output_write(out, digits + sizeof(digits) - count, count);
+}
+
+// Make room for length more bytes
+static int output_reserve(OutputBuffer* out, int length) {
+    if (out->size + length <= out->capacity) {
+        return 1;
     }
-    return 0;
+
+    // Drain the buffer if the owner knows how
+    if (out->overflow && out->size > 0) {
+        out->overflow(out);
+        if (out->size + length <= out->capacity) {
+            return 1;
+        }
+    }
+
+    // Grow (only happens when the initial capacity was too small)
+    int capacity = out->capacity > 0 ? out->capacity : 256;
+    while (capacity < out->size + length) {
+        capacity *= 2;
+    }
+
+    char* data = (char*)realloc(out->data, capacity);
+    if (!data) return 0;
+
+    out->data = data;
+    out->capacity = capacity;
+    return 1;
+}
+
+// Initialize an output buffer
+int output_buffer_init(OutputBuffer* out, int capacity) {
+    if (!out) return 0;
+
+    out->data = NULL;
+    out->size = 0;
+    out->capacity = 0;
+    out->overflow = NULL;
+
+    if (capacity > 0) {
+        out->data = (char*)malloc(capacity);
+        if (!out->data) return 0;
+        out->capacity = capacity;
+    }
+
+    return 1;
+}
+
+// Free an output buffer
+void output_buffer_free(OutputBuffer* out) {
+    if (!out) return;
+
+    free(out->data);
+    out->data = NULL;
+    out->size = 0;
+    out->capacity = 0;
+}
+
+// Discard buffered bytes, keeping the allocation
+void output_buffer_reset(OutputBuffer* out) {
+    if (out) out->size = 0;
+}
+
+// Append raw bytes
+int output_write(OutputBuffer* out, const char* data, int length) {
+    if (!out || !data || length <= 0) return 0;
+    if (!output_reserve(out, length)) return 0;
+
+    memcpy(out->data + out->size, data, length);
+    out->size += length;
+    return length;
+}
+
+// Append a cursor move
+int output_set_cursor(OutputBuffer* out, int x, int y) {
+    int bytes = output_write(out, "\033[", 2);
+    bytes += output_write_uint(out, (unsigned int)(y + 1));
+    bytes += output_write(out, ";", 1);
+    bytes += output_write_uint(out, (unsigned int)(x + 1));
+    bytes += output_write(out, "H", 1);
+    return bytes;
+}
+
+// Append a color change
+int output_set_color(OutputBuffer* out, int fg, int bg) {
+    int bright_fg = (fg & COLOR_BRIGHT) ? 1 : 0;
+    int bright_bg = (bg & COLOR_BRIGHT) ? 1 : 0;
+
+    // ESC [ bright-fg ; 30+fg ; bright-bg ; 40+bg m
+    char sequence[12];
+    sequence[0] = '\033';
+    sequence[1] = '[';
+    sequence[2] = bright_fg ? '1' : '0';
+    sequence[3] = ';';
+    sequence[4] = '3';
+    sequence[5] = (char)('0' + (fg & 7));
+    sequence[6] = ';';
+    sequence[7] = bright_bg ? '5' : '0';
+    sequence[8] = ';';
+    sequence[9] = '4';
+    sequence[10] = (char)('0' + (bg & 7));
+    sequence[11] = 'm';
+    return output_write(out, sequence, (int)sizeof(sequence));
+}
+
+// Append a color reset
+int output_reset_color(OutputBuffer* out) {
+    return output_write(out, "\033[0m", 4);
+}
+
+// Write bytes straight to the terminal in as few calls as possible
+static void terminal_write_direct(const char* data, int length) {
+    if (headless_output) return;
+
+#ifdef _WIN32
+    HANDLE output = hConsole ? hConsole : GetStdHandle(STD_OUTPUT_HANDLE);
+    while (length > 0) {
+        DWORD written = 0;
+        if (!WriteConsoleA(output, data, (DWORD)length, &written, NULL) &&
+            !WriteFile(output, data, (DWORD)length, &written, NULL)) {
+            return;
+        }
+        if (written == 0) return;
+        data += written;
+        length -= (int)written;
+    }
+#else
+    while (length > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // stdout can share the non-blocking tty with stdin
+                struct pollfd pfd = { STDOUT_FILENO, POLLOUT, 0 };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return;
+        }
+        data += written;
+        length -= (int)written;
+    }
+#endif
+}
+
+// Drain the terminal output buffer when a frame outgrows it
+static void terminal_output_overflow(OutputBuffer* out) {
+    terminal_write_direct(out->data, out->size);
+    out->size = 0;
+}
+
+// Get the terminal output buffer, allocating it on first use
+static OutputBuffer* terminal_output(void) {
+    if (!frame_output.data) {
+        int cells = (terminal_width > 0 ? terminal_width : 80) *
+            (terminal_height > 0 ? terminal_height : 24);
+        output_buffer_init(&frame_output, cells * TERMINAL_BYTES_PER_CELL);
+        frame_output.overflow = terminal_output_overflow;
+    }
+    return &frame_output;
+}
+
+// Output buffer the current frame is assembled in
+OutputBuffer* terminal_get_output(void) {
+    return terminal_output();
 }
 
 // Clear the terminal
 void terminal_clear(void) {
 #ifdef _WIN32
     // Clear screen
+    terminal_flush();
     system("cls");
 #else
     // Clear screen
-    printf("\033[2J");
+    terminal_write("\033[2J", 4);
 #endif
 }
 
 // Set cursor position
-void terminal_set_cursor(int x, int y) {
-    printf("\033[%d;%dH", y + 1, x + 1);
+int terminal_set_cursor(int x, int y) {
+    return output_set_cursor(terminal_output(), x, y);
 }
 
 // Set color
-void terminal_set_color(int fg, int bg) {
-    int bright_fg = (fg & COLOR_BRIGHT) ? 1 : 0;
-    int bright_bg = (bg & COLOR_BRIGHT) ? 1 : 0;
-
-    fg &= ~COLOR_BRIGHT;
-    bg &= ~COLOR_BRIGHT;
-
-    printf("\033[%d;%d;%d;%dm",
-        bright_fg ? 1 : 0,         // bright foreground
-        30 + fg,                    // foreground color
-        bright_bg ? 5 : 0,          // bright background
-        40 + bg);                   // background color
+int terminal_set_color(int fg, int bg) {
+    return output_set_color(terminal_output(), fg, bg);
 }
 
 // Reset color
-void terminal_reset_color(void) {
-    printf("\033[0m");
+int terminal_reset_color(void) {
+    return output_reset_color(terminal_output());
+}
+
+// Write raw bytes
+int terminal_write(const char* data, int length) {
+    return output_write(terminal_output(), data, length);
 }
 
 // Put a character at a position
 void terminal_put_char(int x, int y, char c) {
     terminal_set_cursor(x, y);
-    putchar(c);
+    terminal_write(&c, 1);
 }
 
 // Put a colored character at a position
 void terminal_put_colored_char(int x, int y, char c, int fg, int bg) {
     terminal_set_cursor(x, y);
     terminal_set_color(fg, bg);
-    putchar(c);
+    terminal_write(&c, 1);
     terminal_reset_color();
 }
 
-// Flush the terminal
+// Flush the terminal (everything buffered goes out in one write)
 void terminal_flush(void) {
-    fflush(stdout);
+    OutputBuffer* out = terminal_output();
+    if (out->size > 0) {
+        terminal_write_direct(out->data, out->size);
+        out->size = 0;
+    }
+}
+
+// Start assembling a frame
+void terminal_begin_frame(void) {
+    // Anything still pending belongs to the previous frame
+    terminal_flush();
+}
+
+// Write the assembled frame and return its size in bytes
+int terminal_end_frame(void) {
+    int bytes = terminal_output()->size;
+    terminal_flush();
+    return bytes;
+}
+
+// Select the output backend
+int terminal_set_backend(int backend) {
+#ifdef _WIN32
+    if (backend == TERMINAL_BACKEND_VT || backend == TERMINAL_BACKEND_CONSOLE) {
+        output_backend = backend;
+        return 1;
+    }
+#else
+    if (backend == TERMINAL_BACKEND_VT) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+// Get the output backend
+int terminal_get_backend(void) {
+#ifdef _WIN32
+    return output_backend;
+#else
+    return TERMINAL_BACKEND_VT;
+#endif
+}
+
+// Assemble frames without writing them (benchmarks, tests)
+void terminal_set_headless(int headless) {
+    headless_output = headless ? 1 : 0;
+}
+
+int terminal_is_headless(void) {
+    return headless_output;
+}
+
+// Blit a whole grid of cells with one WriteConsoleOutput call
+int terminal_present_cells(const char* chars, const uint8_t* attrs, int width, int height) {
+#ifdef _WIN32
+    if (!chars || !attrs || width <= 0 || height <= 0) return 0;
+
+    // Console attributes for every attribute byte; ANSI colors are RGB where
+    // the console's are BGR
+    static WORD console_attrs[256];
+    static int console_attrs_ready = 0;
+    if (!console_attrs_ready) {
+        static const WORD color_bits[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+        for (int attr = 0; attr < 256; attr++) {
+            int fg = COLOR_ATTR_FG(attr);
+            int bg = COLOR_ATTR_BG(attr);
+            WORD attributes = color_bits[fg & 7] | (WORD)(color_bits[bg & 7] << 4);
+            if (fg & COLOR_BRIGHT) attributes |= FOREGROUND_INTENSITY;
+            if (bg & COLOR_BRIGHT) attributes |= BACKGROUND_INTENSITY;
+            console_attrs[attr] = attributes;
+        }
+        console_attrs_ready = 1;
+    }
+
+    // The cell buffer only grows when the terminal does
+    int cells = width * height;
+    if (cells > cell_capacity) {
+        CHAR_INFO* buffer = (CHAR_INFO*)realloc(cell_buffer, cells * sizeof(CHAR_INFO));
+        if (!buffer) return 0;
+        cell_buffer = buffer;
+        cell_capacity = cells;
+    }
+
+    for (int i = 0; i < cells; i++) {
+        cell_buffer[i].Char.AsciiChar = chars[i];
+        cell_buffer[i].Attributes = console_attrs[attrs[i]];
+    }
+
+    // Pending escape output must land first
+    terminal_flush();
+    if (headless_output) {
+        return cells * (int)sizeof(CHAR_INFO);
+    }
+
+    COORD size = { (SHORT)width, (SHORT)height };
+    COORD origin = { 0, 0 };
+    SMALL_RECT region = { 0, 0, (SHORT)(width - 1), (SHORT)(height - 1) };
+    if (!WriteConsoleOutputA(hConsole, cell_buffer, size, origin, &region)) {
+        return 0;
+    }
+
+    return cells * (int)sizeof(CHAR_INFO);
+#else
+    (void)chars; (void)attrs; (void)width; (void)height;
+    return 0;
+#endif
 }
 
 // Draw a string at a position
 void terminal_draw_string(int x, int y, const char* str) {
     if (!str) return;
     terminal_set_cursor(x, y);
-    printf("%s", str);
+    terminal_write(str, (int)strlen(str));
 }
 
 // Draw a colored string at a position
@@ -355,7 +917,7 @@ void terminal_draw_colored_string(int x, int y, const char* str, int fg, int bg)
     if (!str) return;
     terminal_set_cursor(x, y);
     terminal_set_color(fg, bg);
-    printf("%s", str);
+    terminal_write(str, (int)strlen(str));
     terminal_reset_color();
 }
 
@@ -377,6 +939,83 @@ void terminal_sleep(int ms) {
 #endif
 }
 
+#ifdef _WIN32
+// Timer behind the microsecond waits, high resolution where available
+static HANDLE terminal_wait_timer(void) {
+    if (wait_timer == NULL) {
+        wait_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (wait_timer == NULL) {
+            wait_timer = CreateWaitableTimerW(NULL, TRUE, NULL);
+        }
+    }
+    return wait_timer;
+}
+
+// Arm the wait timer to fire after us microseconds
+static HANDLE terminal_arm_timer(long long us) {
+    HANDLE timer = terminal_wait_timer();
+    if (timer == NULL) return NULL;
+
+    LARGE_INTEGER due;
+    due.QuadPart = -(us * 10);  // Relative, in 100 ns units
+    if (!SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) return NULL;
+    return timer;
+}
+#endif
+
+// Sleep for specified microseconds
+void terminal_sleep_us(long long us) {
+    if (us <= 0) return;
+
+#ifdef _WIN32
+    HANDLE timer = terminal_arm_timer(us);
+    if (timer != NULL) {
+        WaitForSingleObject(timer, INFINITE);
+    }
+    else {
+        Sleep((DWORD)((us + 999) / 1000));
+    }
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(us / 1000000);
+    ts.tv_nsec = (long)(us % 1000000) * 1000;
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+#endif
+}
+
+// Wait until input is ready to read or timeout_us passes; returns 1 on input
+int terminal_wait_input(long long timeout_us) {
+    if (timeout_us < 0) timeout_us = 0;
+
+#ifdef _WIN32
+    if (hInput == NULL) {
+        terminal_sleep_us(timeout_us);
+        return 0;
+    }
+
+    // The console input handle is signalled while input records are queued
+    HANDLE timer = terminal_arm_timer(timeout_us);
+    if (timer == NULL) {
+        return WaitForSingleObject(hInput, (DWORD)((timeout_us + 999) / 1000)) == WAIT_OBJECT_0;
+    }
+
+    HANDLE handles[2] = { hInput, timer };
+    DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+    CancelWaitableTimer(timer);
+    return result == WAIT_OBJECT_0;
+#else
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(STDIN_FILENO, &readable);
+
+    struct timeval tv;
+    tv.tv_sec = (time_t)(timeout_us / 1000000);
+    tv.tv_usec = (suseconds_t)(timeout_us % 1000000);
+    return select(STDIN_FILENO + 1, &readable, NULL, NULL, &tv) > 0;
+#endif
+}
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
@@ -5,6 +5,7 @@
 #ifndef TERMINAL_H
 #define TERMINAL_H
 
+#include "config.h"
 #include <stdint.h>
 
  // Terminal color codes
@@ -18,30 +19,87 @@
 #define COLOR_WHITE 7
 #define COLOR_BRIGHT 8
 
+// Cell attribute byte: foreground in the low nibble, background in the high nibble
+#define COLOR_ATTR(fg, bg) ((uint8_t)(((fg) & 0x0F) | (((bg) & 0x0F) << 4)))
+#define COLOR_ATTR_FG(attr) ((attr) & 0x0F)
+#define COLOR_ATTR_BG(attr) (((attr) >> 4) & 0x0F)
+
+// Output backends
+#define TERMINAL_BACKEND_VT 0       // Escape sequences written as one byte stream
+#define TERMINAL_BACKEND_CONSOLE 1  // WriteConsoleOutput cell blit (Windows only)
+
+// Byte buffer a whole frame is assembled into before it is written
+typedef struct OutputBuffer OutputBuffer;
+struct OutputBuffer {
+    char* data;
+    int size;
+    int capacity;
+    void (*overflow)(OutputBuffer* out);  // Drains a full buffer (NULL = grow)
+};
+
+// Output buffer operations (each append returns the number of bytes added)
+int output_buffer_init(OutputBuffer* out, int capacity);
+void output_buffer_free(OutputBuffer* out);
+void output_buffer_reset(OutputBuffer* out);
+int output_write(OutputBuffer* out, const char* data, int length);
+int output_set_cursor(OutputBuffer* out, int x, int y);
+int output_set_color(OutputBuffer* out, int fg, int bg);
+int output_reset_color(OutputBuffer* out);
+
 // Terminal initialization and cleanup
 int terminal_init(void);
 void terminal_cleanup(void);
 
-// Input handling
-void terminal_process_input(void);
+// Key going down (or auto-repeating) or up, read by terminal_process_input
+typedef struct {
+    int key;                   // Character or SpecialKeys value (named keys with an ASCII code use it)
+    int down;                  // 1 = pressed or repeated, 0 = released
+    int repeat;                // Auto-repeat of a key already down
+    unsigned long long time_us; // When the event was read (get_time_us)
+} TerminalKeyEvent;
+
+// Input handling. terminal_process_input reads all pending input once per
+// frame and returns the number of key events; a key is pressed if it went
+// down (or repeated) during that frame and held until it goes up.
+// Terminals without key-up events release a key once it stops
+// auto-repeating (TERMINAL_KEY_HOLD_MS, TERMINAL_KEY_REPEAT_MS).
+int terminal_process_input(void);
+int terminal_poll_event(TerminalKeyEvent* event);
 int terminal_key_pressed(char key);
 int terminal_key_held(char key);
 int terminal_special_key_pressed(int key);
+int terminal_special_key_held(int key);
 
 // Display functions
 void terminal_clear(void);
-void terminal_set_cursor(int x, int y);
-void terminal_set_color(int fg, int bg);
-void terminal_reset_color(void);
+// Output primitives return the number of bytes written
+int terminal_set_cursor(int x, int y);
+int terminal_set_color(int fg, int bg);
+int terminal_reset_color(void);
+int terminal_write(const char* data, int length);
 void terminal_put_char(int x, int y, char c);
 void terminal_put_colored_char(int x, int y, char c, int fg, int bg);
 void terminal_flush(void);
+void terminal_begin_frame(void);
+int terminal_end_frame(void);
+OutputBuffer* terminal_get_output(void);
+int terminal_set_backend(int backend);
+int terminal_get_backend(void);
+void terminal_set_headless(int headless);
+int terminal_is_headless(void);
+int terminal_present_cells(const char* chars, const uint8_t* attrs, int width, int height);
 void terminal_draw_string(int x, int y, const char* str);
 void terminal_draw_colored_string(int x, int y, const char* str, int fg, int bg);
+
+// Window size in cells; terminal_process_input picks up changes to it
 void terminal_get_size(int* width, int* height);
 
 // Sleep for specified milliseconds
 void terminal_sleep(int ms);
+void terminal_sleep_us(long long us);
+
+// Wait up to timeout_us for input; returns 1 as soon as input can be read
+int terminal_wait_input(long long timeout_us);
 
 // Special keys
 enum SpecialKeys {
@@ -71,7 +129,36 @@ enum SpecialKeys {
     KEY_F9,
     KEY_F10,
     KEY_F11,
-    KEY_F12
+    KEY_F12,
+    KEY_COUNT
 };
 
+// Keys of one keyboard: down now, pressed this frame, and this frame's
+// events. terminal_process_input keeps one for the local terminal; other
+// input sources (network sessions) can keep their own.
+#define KEY_STATE_WORDS ((KEY_COUNT + 31) / 32)
+
+typedef struct {
+    uint32_t down[KEY_STATE_WORDS];
+    uint32_t pressed[KEY_STATE_WORDS];
+    unsigned long long seen_us[KEY_COUNT];  // Last press or repeat
+    char repeating[KEY_COUNT];              // Whether the key has auto-repeated
+    TerminalKeyEvent events[TERMINAL_INPUT_EVENTS];
+    int event_count;
+    int event_next;
+} KeyState;
+
+void key_state_clear(KeyState* keys);
+void key_state_begin_frame(KeyState* keys);
+void key_state_event(KeyState* keys, int key, int down, unsigned long long now);
+void key_state_release(KeyState* keys, unsigned long long now, int stale_only);
+int key_state_poll(KeyState* keys, TerminalKeyEvent* event);
+int key_state_pressed(const KeyState* keys, int key);
+int key_state_held(const KeyState* keys, int key);
+
+// Parse the VT key sequence at the start of bytes into a key code (0 for
+// sequences that name no key). Returns the bytes it spans, or 0 if the
+// escape sequence is not complete yet.
+int terminal_parse_key(const unsigned char* bytes, int length, int* key);
+
 #endif /* TERMINAL_H */
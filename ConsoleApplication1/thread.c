@@ -0,0 +1,173 @@
+/**
+ * @file thread.c
+ * @brief Implementation of the portable threading layer
+ */
+#include "thread.h"
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+// Start parameters handed to a new thread
+typedef struct {
+    ThreadFunc func;
+    void* arg;
+} ThreadStart;
+
+#ifdef _WIN32
+static DWORD WINAPI thread_trampoline(LPVOID param) {
+#else
+static void* thread_trampoline(void* param) {
+#endif
+    ThreadStart start = *(ThreadStart*)param;
+    free(param);
+
+    start.func(start.arg);
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// Create a new thread running func(arg)
+int thread_create(Thread* thread, ThreadFunc func, void* arg) {
+    if (!thread || !func) return 0;
+
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+
+    start->func = func;
+    start->arg = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 0;
+    }
+#else
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0) {
+        free(start);
+        return 0;
+    }
+#endif
+
+    return 1;
+}
+
+// Wait for a thread to finish
+void thread_join(Thread thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+// Get the number of logical processors
+int thread_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+#endif
+}
+
+// Mutex operations
+void mutex_init(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutex_destroy(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void mutex_lock(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+int mutex_trylock(Mutex* mutex) {
+#ifdef _WIN32
+    return TryEnterCriticalSection(mutex) ? 1 : 0;
+#else
+    return pthread_mutex_trylock(mutex) == 0;
+#endif
+}
+
+void mutex_unlock(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+// Condition variable operations
+void condvar_init(CondVar* cond) {
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+void condvar_destroy(CondVar* cond) {
+#ifdef _WIN32
+    (void)cond; // Windows condition variables need no cleanup
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+void condvar_wait(CondVar* cond, Mutex* mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void condvar_signal(CondVar* cond) {
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void condvar_broadcast(CondVar* cond) {
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+// Atomic operations
+
+long long atomic_add(volatile long long* value, long long amount) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd64((volatile LONG64*)value, amount);
+#else
+    return __atomic_fetch_add(value, amount, __ATOMIC_RELAXED);
+#endif
+}
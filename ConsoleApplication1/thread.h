@@ -0,0 +1,45 @@
+/**
+ * @file thread.h
+ * @brief Portable threads, mutexes and condition variables
+ */
+#ifndef THREAD_H
+#define THREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+#else
+#include <pthread.h>
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+#endif
+
+// Thread entry point
+typedef void (*ThreadFunc)(void* arg);
+
+// Thread operations
+int thread_create(Thread* thread, ThreadFunc func, void* arg);
+void thread_join(Thread thread);
+int thread_cpu_count(void);
+
+// Mutex operations
+void mutex_init(Mutex* mutex);
+void mutex_destroy(Mutex* mutex);
+void mutex_lock(Mutex* mutex);
+int mutex_trylock(Mutex* mutex);
+void mutex_unlock(Mutex* mutex);
+
+// Condition variable operations
+void condvar_init(CondVar* cond);
+void condvar_destroy(CondVar* cond);
+void condvar_wait(CondVar* cond, Mutex* mutex);
+void condvar_signal(CondVar* cond);
+void condvar_broadcast(CondVar* cond);
+
+// Atomically add to a counter; returns the previous value
+long long atomic_add(volatile long long* value, long long amount);
+
+#endif /* THREAD_H */
@@ -0,0 +1,184 @@
+/**
+ * @file threadpool.c
+ * @brief Implementation of the persistent worker pool
+ */
+#include "threadpool.h"
+#include "thread.h"
+#include <stdlib.h>
+
+// Per-worker start data
+typedef struct {
+    ThreadPool* pool;
+    int thread_index;
+} ThreadPoolWorker;
+
+// Thread pool structure
+struct ThreadPool {
+    int thread_count;            // Threads executing tasks, including the caller
+    Thread* threads;             // Worker threads (thread_count - 1)
+    ThreadPoolWorker* workers;   // Start data for each worker
+
+    Mutex lock;
+    CondVar work_ready;          // Signalled when a new job is published
+    CondVar work_done;           // Signalled when the last task of a job finishes
+
+    // Current job, protected by lock
+    ThreadPoolTask task;
+    void* context;
+    int task_count;
+    int next_task;               // Next task index to hand out
+    int tasks_remaining;         // Tasks not yet finished
+    unsigned int generation;     // Incremented for every published job
+    int shutdown;
+};
+
+// Take task indices from the current job until it is exhausted
+static void threadpool_drain(ThreadPool* pool, int thread_index) {
+    mutex_lock(&pool->lock);
+
+    while (pool->next_task < pool->task_count) {
+        int task_index = pool->next_task++;
+        ThreadPoolTask task = pool->task;
+        void* context = pool->context;
+        mutex_unlock(&pool->lock);
+
+        task(context, task_index, thread_index);
+
+        mutex_lock(&pool->lock);
+        pool->tasks_remaining--;
+        if (pool->tasks_remaining == 0) {
+            condvar_broadcast(&pool->work_done);
+        }
+    }
+
+    mutex_unlock(&pool->lock);
+}
+
+// Worker thread main loop
+static void threadpool_worker_main(void* arg) {
+    ThreadPoolWorker* worker = (ThreadPoolWorker*)arg;
+    ThreadPool* pool = worker->pool;
+    unsigned int seen_generation = 0;
+
+    while (1) {
+        // Wait for a new job or shutdown
+        mutex_lock(&pool->lock);
+        while (!pool->shutdown && pool->generation == seen_generation) {
+            condvar_wait(&pool->work_ready, &pool->lock);
+        }
+
+        if (pool->shutdown) {
+            mutex_unlock(&pool->lock);
+            return;
+        }
+
+        seen_generation = pool->generation;
+        mutex_unlock(&pool->lock);
+
+        threadpool_drain(pool, worker->thread_index);
+    }
+}
+
+// Create a thread pool
+ThreadPool* threadpool_create(int thread_count) {
+    if (thread_count < 1) thread_count = 1;
+
+    ThreadPool* pool = (ThreadPool*)calloc(1, sizeof(ThreadPool));
+    if (!pool) return NULL;
+
+    mutex_init(&pool->lock);
+    condvar_init(&pool->work_ready);
+    condvar_init(&pool->work_done);
+    pool->thread_count = 1;
+
+    int worker_count = thread_count - 1;
+    if (worker_count == 0) {
+        return pool;
+    }
+
+    pool->threads = (Thread*)malloc(worker_count * sizeof(Thread));
+    pool->workers = (ThreadPoolWorker*)malloc(worker_count * sizeof(ThreadPoolWorker));
+    if (!pool->threads || !pool->workers) {
+        threadpool_destroy(pool);
+        return NULL;
+    }
+
+    // Start workers; the caller is thread 0
+    for (int i = 0; i < worker_count; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].thread_index = i + 1;
+
+        if (!thread_create(&pool->threads[i], threadpool_worker_main, &pool->workers[i])) {
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    return pool;
+}
+
+// Destroy a thread pool
+void threadpool_destroy(ThreadPool* pool) {
+    if (!pool) return;
+
+    // Wake and join workers
+    mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    condvar_broadcast(&pool->work_ready);
+    mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < pool->thread_count - 1; i++) {
+        thread_join(pool->threads[i]);
+    }
+
+    condvar_destroy(&pool->work_done);
+    condvar_destroy(&pool->work_ready);
+    mutex_destroy(&pool->lock);
+
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+// Run a job and wait for it to complete
+void threadpool_run(ThreadPool* pool, ThreadPoolTask task, void* context, int task_count) {
+    if (!task || task_count <= 0) return;
+
+    // Serial fallback
+    if (!pool || pool->thread_count <= 1 || task_count == 1) {
+        for (int i = 0; i < task_count; i++) {
+            task(context, i, 0);
+        }
+        return;
+    }
+
+    // Publish job
+    mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->task_count = task_count;
+    pool->next_task = 0;
+    pool->tasks_remaining = task_count;
+    pool->generation++;
+    condvar_broadcast(&pool->work_ready);
+    mutex_unlock(&pool->lock);
+
+    // The caller works too
+    threadpool_drain(pool, 0);
+
+    // Wait for tasks still running on workers
+    mutex_lock(&pool->lock);
+    while (pool->tasks_remaining > 0) {
+        condvar_wait(&pool->work_done, &pool->lock);
+    }
+    pool->task = NULL;
+    pool->context = NULL;
+    pool->task_count = 0;
+    pool->next_task = 0;
+    mutex_unlock(&pool->lock);
+}
+
+// Get the number of threads executing tasks
+int threadpool_thread_count(ThreadPool* pool) {
+    return pool ? pool->thread_count : 1;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file threadpool.h
+ * @brief Persistent worker pool for data-parallel jobs
+ */
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Task callback, invoked once for every task index of a job
+typedef void (*ThreadPoolTask)(void* context, int task_index, int thread_index);
+
+// Forward declaration
+typedef struct ThreadPool ThreadPool;
+
+// Pool creation and destruction (thread_count includes the calling thread)
+ThreadPool* threadpool_create(int thread_count);
+void threadpool_destroy(ThreadPool* pool);
+
+// Run task_count tasks across the pool and wait for all of them to finish.
+// A NULL pool runs the tasks serially on the calling thread.
+void threadpool_run(ThreadPool* pool, ThreadPoolTask task, void* context, int task_count);
+
+// Number of threads that execute tasks (at least 1)
+int threadpool_thread_count(ThreadPool* pool);
+
+#endif /* THREADPOOL_H */
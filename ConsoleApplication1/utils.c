@@ -0,0 +1,501 @@
+/**
+ * @file utils.c
+ * @brief Implementation of utility functions
+ */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+// SSE2 is part of every x64 target and the MSVC x86 default
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTILS_SSE2 1
+#include <emmintrin.h>
+#else
+#define UTILS_SSE2 0
+#endif
+
+// Generator behind set_random_seed/random_int/random_float
+static Rng global_rng = { 0x853c49e6748fea9bULL };
+
+// Logging state
+static int log_level = LOG_INFO;
+static FILE* log_file = NULL;
+
+// Time utilities
+unsigned long long get_time_ms(void) {
+#ifdef _WIN32
+    return (unsigned long long)GetTickCount64();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000ULL + (unsigned long long)(now.tv_nsec / 1000000);
+#endif
+}
+
+// Monotonic time in microseconds
+unsigned long long get_time_us(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = { 0 };
+    LARGE_INTEGER counter;
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000ULL +
+        (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000ULL / (unsigned long long)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000ULL + (unsigned long long)(now.tv_nsec / 1000);
+#endif
+}
+
+// Seed the global generator (the same seed gives the same sequence on every platform)
+void set_random_seed(unsigned int seed) {
+    rng_seed(&global_rng, seed);
+}
+
+// Integer in [min, max]
+int random_int(int min, int max) {
+    return rng_int(&global_rng, min, max);
+}
+
+// Float in [min, max)
+float random_float(float min, float max) {
+    return rng_float(&global_rng, min, max);
+}
+
+// Seed a generator
+void rng_seed(Rng* rng, unsigned int seed) {
+    rng->state = 0;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+// Next 32 random bits (PCG32: 64-bit LCG with a permuted output)
+uint32_t rng_next(Rng* rng) {
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+    uint32_t rot = (uint32_t)(old >> 59);
+    return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+// Integer in [min, max]
+int rng_int(Rng* rng, int min, int max) {
+    if (max <= min) return min;
+
+    uint32_t range = (uint32_t)max - (uint32_t)min + 1;
+    uint32_t value = rng_next(rng);
+    return (int)((uint32_t)min + (range ? value % range : value));
+}
+
+// Float in [min, max)
+float rng_float(Rng* rng, float min, float max) {
+    // 24 random bits fill the float mantissa exactly
+    float unit = (float)(rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+    return min + (max - min) * unit;
+}
+
+// Hash a lattice point into 32 well-mixed bits. Only wrapping integer
+// arithmetic, so every platform (and the SSE2 path) agrees.
+static inline uint32_t noise_hash2(int32_t x, int32_t y, uint32_t seed) {
+    uint32_t h = (uint32_t)x * 0x8da6b343u + (uint32_t)y * 0xd8163841u + seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 13;
+    return h;
+}
+
+static inline uint32_t noise_hash3(int32_t x, int32_t y, int32_t z, uint32_t seed) {
+    uint32_t h = (uint32_t)x * 0x8da6b343u + (uint32_t)y * 0xd8163841u +
+        (uint32_t)z * 0x9e3779b1u + seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 13;
+    return h;
+}
+
+// Quintic fade curve
+static inline float noise_fade(float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Interpolation used by the noise (kept in one form for bit-exact batches)
+static inline float noise_lerp(float a, float b, float t) {
+    return a + t * (b - a);
+}
+
+// Dot product with one of the four diagonal gradients
+static inline float noise_grad2(uint32_t hash, float x, float y) {
+    return ((hash & 1) ? -x : x) + ((hash & 2) ? -y : y);
+}
+
+// Dot product with one of the twelve cube-edge gradients
+static inline float noise_grad3(uint32_t hash, float x, float y, float z) {
+    int h = (int)(hash & 15);
+    float u = h < 8 ? x : y;
+    float v = h < 4 ? y : (h == 12 || h == 14) ? x : z;
+    return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+// Seed of one octave of fractal noise
+static inline uint32_t noise_octave_seed(int seed, int octave) {
+    return (uint32_t)seed + (uint32_t)octave * 0x9e3779b9u;
+}
+
+// Single octave of 2D gradient noise, roughly in [-1, 1]
+static float noise2d_seeded(float x, float y, uint32_t seed) {
+    float fx = floorf(x);
+    float fy = floorf(y);
+    int32_t ix = (int32_t)fx;
+    int32_t iy = (int32_t)fy;
+    x -= fx;
+    y -= fy;
+
+    float n00 = noise_grad2(noise_hash2(ix, iy, seed), x, y);
+    float n10 = noise_grad2(noise_hash2(ix + 1, iy, seed), x - 1.0f, y);
+    float n01 = noise_grad2(noise_hash2(ix, iy + 1, seed), x, y - 1.0f);
+    float n11 = noise_grad2(noise_hash2(ix + 1, iy + 1, seed), x - 1.0f, y - 1.0f);
+
+    float u = noise_fade(x);
+    float v = noise_fade(y);
+    return noise_lerp(noise_lerp(n00, n10, u), noise_lerp(n01, n11, u), v);
+}
+
+// Single octave of 3D gradient noise, roughly in [-1, 1]
+static float noise3d_seeded(float x, float y, float z, uint32_t seed) {
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float fz = floorf(z);
+    int32_t ix = (int32_t)fx;
+    int32_t iy = (int32_t)fy;
+    int32_t iz = (int32_t)fz;
+    x -= fx;
+    y -= fy;
+    z -= fz;
+
+    float u = noise_fade(x);
+    float v = noise_fade(y);
+    float w = noise_fade(z);
+
+    float n000 = noise_grad3(noise_hash3(ix, iy, iz, seed), x, y, z);
+    float n100 = noise_grad3(noise_hash3(ix + 1, iy, iz, seed), x - 1.0f, y, z);
+    float n010 = noise_grad3(noise_hash3(ix, iy + 1, iz, seed), x, y - 1.0f, z);
+    float n110 = noise_grad3(noise_hash3(ix + 1, iy + 1, iz, seed), x - 1.0f, y - 1.0f, z);
+    float n001 = noise_grad3(noise_hash3(ix, iy, iz + 1, seed), x, y, z - 1.0f);
+    float n101 = noise_grad3(noise_hash3(ix + 1, iy, iz + 1, seed), x - 1.0f, y, z - 1.0f);
+    float n011 = noise_grad3(noise_hash3(ix, iy + 1, iz + 1, seed), x, y - 1.0f, z - 1.0f);
+    float n111 = noise_grad3(noise_hash3(ix + 1, iy + 1, iz + 1, seed), x - 1.0f, y - 1.0f, z - 1.0f);
+
+    float nx00 = noise_lerp(n000, n100, u);
+    float nx10 = noise_lerp(n010, n110, u);
+    float nx01 = noise_lerp(n001, n101, u);
+    float nx11 = noise_lerp(n011, n111, u);
+    return noise_lerp(noise_lerp(nx00, nx10, v), noise_lerp(nx01, nx11, v), w);
+}
+
+// Noise functions for terrain generation
+float noise2d(float x, float y, int seed) {
+    return noise2d_seeded(x, y, (uint32_t)seed);
+}
+
+float noise3d(float x, float y, float z, int seed) {
+    return noise3d_seeded(x, y, z, (uint32_t)seed);
+}
+
+// Fractal noise: octaves double in frequency and scale by persistence,
+// normalized back to roughly [-1, 1]
+float perlin_noise2d(float x, float y, int octaves, float persistence, int seed) {
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float max_value = 0.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise2d_seeded(x * frequency, y * frequency, noise_octave_seed(seed, i)) * amplitude;
+        max_value += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0f;
+    }
+
+    return max_value > 0.0f ? total / max_value : 0.0f;
+}
+
+float perlin_noise3d(float x, float y, float z, int octaves, float persistence, int seed) {
+    float total = 0.0f;
+    float frequency = 1.0f;
+    float amplitude = 1.0f;
+    float max_value = 0.0f;
+
+    for (int i = 0; i < octaves; i++) {
+        total += noise3d_seeded(x * frequency, y * frequency, z * frequency, noise_octave_seed(seed, i)) * amplitude;
+        max_value += amplitude;
+        amplitude *= persistence;
+        frequency *= 2.0f;
+    }
+
+    return max_value > 0.0f ? total / max_value : 0.0f;
+}
+
+#if UTILS_SSE2
+
+// 32-bit multiply (SSE2 only has the unsigned 32x32->64 form)
+static inline __m128i noise_mullo(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// noise_hash2 for four x coordinates sharing one row
+static inline __m128i noise_hash2_x4(__m128i x, uint32_t row) {
+    __m128i h = _mm_add_epi32(noise_mullo(x, _mm_set1_epi32((int)0x8da6b343u)), _mm_set1_epi32((int)row));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = noise_mullo(h, _mm_set1_epi32(0x2c1b3c6d));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+    return h;
+}
+
+// noise_grad2 for four lanes: hash bits 0 and 1 flip the signs
+static inline __m128 noise_grad2_x4(__m128i hash, __m128 x, __m128 y) {
+    __m128i sign_x = _mm_slli_epi32(hash, 31);
+    __m128i sign_y = _mm_slli_epi32(_mm_srli_epi32(hash, 1), 31);
+    return _mm_add_ps(_mm_xor_ps(x, _mm_castsi128_ps(sign_x)), _mm_xor_ps(y, _mm_castsi128_ps(sign_y)));
+}
+
+static inline __m128 noise_fade_x4(__m128 t) {
+    __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+        _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+static inline __m128 noise_lerp_x4(__m128 a, __m128 b, __m128 t) {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+}
+
+// floorf for four lanes (exact for |x| < 2^31)
+static inline __m128 noise_floor_x4(__m128 x) {
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+}
+
+// Four samples of noise2d_seeded along one row, bit-identical to the scalar path
+static inline __m128 noise2d_row_x4(__m128 x, float y, uint32_t seed) {
+    float fy = floorf(y);
+    int32_t iy = (int32_t)fy;
+    y -= fy;
+
+    __m128 fx = noise_floor_x4(x);
+    __m128i ix = _mm_cvttps_epi32(fx);
+    __m128i ix1 = _mm_add_epi32(ix, _mm_set1_epi32(1));
+    x = _mm_sub_ps(x, fx);
+
+    // The y and seed terms of the hash are the same for the whole row
+    uint32_t row0 = (uint32_t)iy * 0xd8163841u + seed * 0xcb1ab31fu;
+    uint32_t row1 = (uint32_t)(iy + 1) * 0xd8163841u + seed * 0xcb1ab31fu;
+
+    __m128 x1 = _mm_sub_ps(x, _mm_set1_ps(1.0f));
+    __m128 y0 = _mm_set1_ps(y);
+    __m128 y1 = _mm_set1_ps(y - 1.0f);
+
+    __m128 n00 = noise_grad2_x4(noise_hash2_x4(ix, row0), x, y0);
+    __m128 n10 = noise_grad2_x4(noise_hash2_x4(ix1, row0), x1, y0);
+    __m128 n01 = noise_grad2_x4(noise_hash2_x4(ix, row1), x, y1);
+    __m128 n11 = noise_grad2_x4(noise_hash2_x4(ix1, row1), x1, y1);
+
+    __m128 u = noise_fade_x4(x);
+    __m128 v = _mm_set1_ps(noise_fade(y));
+    return noise_lerp_x4(noise_lerp_x4(n00, n10, u), noise_lerp_x4(n01, n11, u), v);
+}
+
+#endif
+
+// Batch noise: out[i] = noise2d((x_start + i) * x_scale, y, seed)
+void noise2d_row(float* out, int count, int x_start, float x_scale, float y, int seed) {
+    if (!out || count <= 0) return;
+
+    int i = 0;
+#if UTILS_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x_start + i),
+            _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(x_scale));
+        _mm_storeu_ps(out + i, noise2d_row_x4(x, y, (uint32_t)seed));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = noise2d_seeded((float)(x_start + i) * x_scale, y, (uint32_t)seed);
+    }
+}
+
+// Batch fractal noise: out[i] = perlin_noise2d((x_start + i) * x_scale, y, ...)
+void perlin_noise2d_row(float* out, int count, int x_start, float x_scale, float y,
+    int octaves, float persistence, int seed) {
+    if (!out || count <= 0) return;
+
+    int i = 0;
+#if UTILS_SSE2
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(x_start + i),
+            _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(x_scale));
+        __m128 total = _mm_setzero_ps();
+        float frequency = 1.0f;
+        float amplitude = 1.0f;
+        float max_value = 0.0f;
+
+        for (int octave = 0; octave < octaves; octave++) {
+            __m128 sample = noise2d_row_x4(_mm_mul_ps(x, _mm_set1_ps(frequency)), y * frequency,
+                noise_octave_seed(seed, octave));
+            total = _mm_add_ps(total, _mm_mul_ps(sample, _mm_set1_ps(amplitude)));
+            max_value += amplitude;
+            amplitude *= persistence;
+            frequency *= 2.0f;
+        }
+
+        __m128 result = max_value > 0.0f ? _mm_div_ps(total, _mm_set1_ps(max_value)) : _mm_setzero_ps();
+        _mm_storeu_ps(out + i, result);
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = perlin_noise2d((float)(x_start + i) * x_scale, y, octaves, persistence, seed);
+    }
+}
+
+// Batch fractal noise over a grid: out[y * width + x] samples
+// ((x_start + x) * x_scale, (y_start + y) * y_scale)
+void perlin_noise2d_grid(float* out, int width, int height, int x_start, int y_start,
+    float x_scale, float y_scale, int octaves, float persistence, int seed) {
+    if (!out || width <= 0 || height <= 0) return;
+
+    for (int y = 0; y < height; y++) {
+        perlin_noise2d_row(out + (size_t)y * width, width, x_start, x_scale,
+            (float)(y_start + y) * y_scale, octaves, persistence, seed);
+    }
+}
+
+// Math utilities
+float clamp(float value, float min, float max) {
+    if (value < min) return min;
+    if (value > max) return max;
+    return value;
+}
+
+float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+float smoothstep(float edge0, float edge1, float x) {
+    if (edge1 == edge0) return x < edge0 ? 0.0f : 1.0f;
+    float t = clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+int max_int(int a, int b) {
+    return a > b ? a : b;
+}
+
+int min_int(int a, int b) {
+    return a < b ? a : b;
+}
+
+float max_float(float a, float b) {
+    return a > b ? a : b;
+}
+
+float min_float(float a, float b) {
+    return a < b ? a : b;
+}
+
+// Logging functions
+void log_message(int level, const char* format, ...) {
+    static const char* level_names[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+    if (!format || level < log_level) return;
+
+    FILE* out = log_file ? log_file : stderr;
+    const char* name = (level >= LOG_DEBUG && level <= LOG_ERROR) ? level_names[level] : "LOG";
+
+    fprintf(out, "[%s] ", name);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(out, format, args);
+    va_end(args);
+
+    fputc('\n', out);
+    fflush(out);
+}
+
+void set_log_level(int level) {
+    log_level = level;
+}
+
+void set_log_file(FILE* file) {
+    log_file = file;
+}
+
+// String utilities
+char* str_duplicate(const char* str) {
+    if (!str) return NULL;
+
+    size_t length = strlen(str);
+    char* copy = (char*)malloc(length + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, str, length + 1);
+    return copy;
+}
+
+char* str_concat(const char* str1, const char* str2) {
+    if (!str1) str1 = "";
+    if (!str2) str2 = "";
+
+    size_t length1 = strlen(str1);
+    size_t length2 = strlen(str2);
+    char* result = (char*)malloc(length1 + length2 + 1);
+    if (!result) return NULL;
+
+    memcpy(result, str1, length1);
+    memcpy(result + length1, str2, length2 + 1);
+    return result;
+}
+
+int str_ends_with(const char* str, const char* suffix) {
+    if (!str || !suffix) return 0;
+
+    size_t length = strlen(str);
+    size_t suffix_length = strlen(suffix);
+    if (suffix_length > length) return 0;
+
+    return memcmp(str + length - suffix_length, suffix, suffix_length) == 0;
+}
+
+// Trim whitespace in place; returns the first non-space character
+char* str_trim(char* str) {
+    if (!str) return NULL;
+
+    while (isspace((unsigned char)*str)) {
+        str++;
+    }
+
+    char* end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+
+    return str;
+}
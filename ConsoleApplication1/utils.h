@@ -6,6 +6,7 @@
 #define UTILS_H
 
 #include <stdio.h>
+#include <stdint.h>
 
  // Logging levels
 #define LOG_DEBUG 0
@@ -15,16 +16,38 @@
 
 // Time utilities
 unsigned long long get_time_ms(void);
+unsigned long long get_time_us(void);
 void set_random_seed(unsigned int seed);
 int random_int(int min, int max);
 float random_float(float min, float max);
 
+// Seedable random number generator; the sequence for a seed is the same
+// on every platform. The functions above use one shared instance.
+typedef struct {
+    uint64_t state;
+} Rng;
+
+void rng_seed(Rng* rng, unsigned int seed);
+uint32_t rng_next(Rng* rng);
+int rng_int(Rng* rng, int min, int max);
+float rng_float(Rng* rng, float min, float max);
+
 // Noise functions for terrain generation
 float noise2d(float x, float y, int seed);
 float noise3d(float x, float y, float z, int seed);
 float perlin_noise2d(float x, float y, int octaves, float persistence, int seed);
 float perlin_noise3d(float x, float y, float z, int octaves, float persistence, int seed);
 
+// Batch noise (SSE2 where available, bit-identical to the calls above):
+// out[i] samples x = (x_start + i) * x_scale along row y
+void noise2d_row(float* out, int count, int x_start, float x_scale, float y, int seed);
+void perlin_noise2d_row(float* out, int count, int x_start, float x_scale, float y,
+    int octaves, float persistence, int seed);
+
+// Heightmap: out[y * width + x] samples ((x_start + x) * x_scale, (y_start + y) * y_scale)
+void perlin_noise2d_grid(float* out, int width, int height, int x_start, int y_start,
+    float x_scale, float y_scale, int octaves, float persistence, int seed);
+
 // Math utilities
 float clamp(float value, float min, float max);
 float lerp(float a, float b, float t);
@@ -6,34 +6,91 @@
 #include "config.h"
 #include "utils.h"
 #include "terminal.h"
+#include "thread.h"
+#include "threadpool.h"
+#include "worldfile.h"
+#include "worldpage.h"
+#include "worldlight.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <limits.h>
 
  // Global block type definitions
 static BlockType default_block_types[MAX_BLOCK_TYPES] = {
     // Air
-    { ' ', COLOR_BLACK, COLOR_BLACK, 0, 0.0f, "Air" },
+    { ' ', COLOR_BLACK, COLOR_BLACK, 0, 0.0f, "Air", 0 },
     // Dirt
-    { '.', COLOR_YELLOW, COLOR_BLACK, 1, 0.6f, "Dirt" },
+    { '.', COLOR_YELLOW, COLOR_BLACK, 1, 0.6f, "Dirt", 0 },
     // Grass
-    { '"', COLOR_GREEN, COLOR_BLACK, 1, 0.5f, "Grass" },
+    { '"', COLOR_GREEN, COLOR_BLACK, 1, 0.5f, "Grass", 0 },
     // Stone
-    { '#', COLOR_WHITE, COLOR_BLACK, 1, 0.8f, "Stone" },
+    { '#', COLOR_WHITE, COLOR_BLACK, 1, 0.8f, "Stone", 0 },
     // Wood
-    { '|', COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK, 1, 0.7f, "Wood" },
+    { '|', COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK, 1, 0.7f, "Wood", 0 },
     // Leaves
-    { '*', COLOR_GREEN | COLOR_BRIGHT, COLOR_BLACK, 1, 0.5f, "Leaves" },
+    { '*', COLOR_GREEN | COLOR_BRIGHT, COLOR_BLACK, 1, 0.5f, "Leaves", 0 },
     // Water
-    { '~', COLOR_BLUE, COLOR_BLACK, 0, 0.3f, "Water" },
+    { '~', COLOR_BLUE, COLOR_BLACK, 0, 0.3f, "Water", 0 },
     // Sand
-    { ',', COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK, 1, 0.4f, "Sand" },
+    { ',', COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK, 1, 0.4f, "Sand", 0 },
     // Brick
-    { '=', COLOR_RED, COLOR_BLACK, 1, 0.9f, "Brick" }
+    { '=', COLOR_RED, COLOR_BLACK, 1, 0.9f, "Brick", 0 },
+    // Torch
+    { '!', COLOR_YELLOW | COLOR_BRIGHT, COLOR_BLACK, 0, 0.0f, "Torch", 14 }
 };
 
-// Create a new world
-World* world_create(int width, int height, int depth) {
+// Stands in for every chunk of a sparse world that is not resident. Nothing
+// writes to it: block writes page their chunk in first.
+static uint8_t world_absent_chunk[CHUNK_VOLUME];
+
+// Flatten the block type list into the lookup table
+static void world_build_block_table(World* world) {
+    BlockTable* table = &world->block_table;
+    memset(table, 0, sizeof(BlockTable));
+    table->glyph[BLOCK_AIR] = ' ';
+
+    int count = world->num_block_types < MAX_BLOCK_TYPES ? world->num_block_types : MAX_BLOCK_TYPES;
+    for (int type = 0; type < MAX_BLOCK_TYPES; type++) {
+        const BlockType* block = &world->block_types[type < count ? type : BLOCK_AIR];
+        table->glyph[type] = block->display_char;
+        table->color[type] = (uint8_t)block->fg_color;
+        table->flags[type] = block->solid ? BLOCK_FLAG_SOLID | BLOCK_FLAG_OPAQUE : 0;
+        table->absorption[type] = block->light_absorption;
+
+        // Clear blocks dim light by one level, absorbing ones by more
+        int loss = 1 + (int)(block->light_absorption * 4.0f);
+        table->light_loss[type] = block->solid ? 0 : (uint8_t)min_int(loss, WORLD_LIGHT_MAX + 1);
+        table->light_emission[type] = (uint8_t)min_int(max_int(block->light_emission, 0), WORLD_LIGHT_MAX);
+    }
+}
+
+// Add the arena space of count items of size bytes to a total; returns 0
+// when the sum no longer fits a size_t
+static int world_add_bytes(size_t* total, size_t count, size_t size) {
+    if (size && count > (SIZE_MAX - ARENA_ALIGN) / size) return 0;
+    size_t bytes = arena_align(count * size);
+    if (bytes > SIZE_MAX - *total) return 0;
+    *total += bytes;
+    return 1;
+}
+
+// Allocate a world, with block storage or with every chunk absent
+static World* world_alloc(int width, int height, int depth, int resident) {
+    // Light queue nodes hold 16-bit coordinates
+    if (width <= 0 || height <= 0 || depth <= 0 ||
+        width > WORLD_MAX_SIZE || height > WORLD_MAX_SIZE || depth > WORLD_MAX_SIZE) {
+        return NULL;
+    }
+
+    // Chunk grid (partial chunks at the edges are padded with air)
+    int chunks_x = (width + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    int chunks_y = (height + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    int chunks_z = (depth + CHUNK_SIZE - 1) >> CHUNK_SHIFT;
+    size_t chunks = (size_t)chunks_x * chunks_y * chunks_z;
+    if (chunks > INT_MAX) return NULL;
+
     World* world = (World*)malloc(sizeof(World));
     if (!world) return NULL;
 
@@ -41,236 +98,465 @@ World* world_create(int width, int height, int depth) {
     world->width = width;
     world->height = height;
     world->depth = depth;
+    world->chunks_x = chunks_x;
+    world->chunks_y = chunks_y;
+    world->chunks_z = chunks_z;
+    world->chunk_count = (int)chunks;
+    world->pager = NULL;
+    world->generation = 0;
+    world->edit_log_start = 0;
+    world->light_epoch = 0;
+
+    // Everything below lives as long as the world, so it all comes from
+    // one arena sized up front
+    size_t lod_cells[WORLD_LOD_LEVELS];
+    size_t bytes = 0;
+    int sized = world_add_bytes(&bytes, chunks, sizeof(uint8_t*)) &&
+        world_add_bytes(&bytes, chunks, sizeof(uint64_t)) &&
+        world_add_bytes(&bytes, chunks, sizeof(uint8_t*)) &&
+        world_add_bytes(&bytes, chunks, BRICKS_PER_CHUNK * sizeof(uint16_t)) &&
+        world_add_bytes(&bytes, chunks, 1) &&
+        world_add_bytes(&bytes, 2 * WORLD_LIGHT_QUEUE_SIZE, sizeof(WorldLightNode)) &&
+        world_add_bytes(&bytes, MAX_BLOCK_TYPES, sizeof(BlockType));
+    if (resident) {
+        sized = sized && world_add_bytes(&bytes, chunks, CHUNK_VOLUME) &&
+            world_add_bytes(&bytes, chunks, CHUNK_VOLUME);
+    }
+    for (int level = 0; level < WORLD_LOD_LEVELS; level++) {
+        lod_cells[level] = (size_t)world_lod_width(world, level) * world_lod_height(world, level);
+        sized = sized && world_add_bytes(&bytes, lod_cells[level], sizeof(WorldLodCell));
+    }
 
-    // Allocate blocks
-    world->blocks = (uint8_t***)malloc(depth * sizeof(uint8_t**));
-    if (!world->blocks) {
+    // A fresh arena is zeroed: all air, no occupied bricks
+    if (!sized || !arena_init(&world->arena, bytes)) {
         free(world);
         return NULL;
     }
 
-    for (int z = 0; z < depth; z++) {
-        world->blocks[z] = (uint8_t**)malloc(height * sizeof(uint8_t*));
-        if (!world->blocks[z]) {
-            // Clean up
-            for (int i = 0; i < z; i++) {
-                for (int j = 0; j < height; j++) {
-                    free(world->blocks[i][j]);
-                }
-                free(world->blocks[i]);
-            }
-            free(world->blocks);
-            free(world);
-            return NULL;
-        }
-
-        for (int y = 0; y < height; y++) {
-            world->blocks[z][y] = (uint8_t*)malloc(width * sizeof(uint8_t));
-            if (!world->blocks[z][y]) {
-                // Clean up
-                for (int i = 0; i < z; i++) {
-                    for (int j = 0; j < height; j++) {
-                        free(world->blocks[i][j]);
-                    }
-                    free(world->blocks[i]);
-                }
+    // Carve every table before filling any of them
+    Arena* arena = &world->arena;
+    world->block_storage = resident ? (uint8_t*)arena_alloc(arena, chunks * CHUNK_VOLUME) : NULL;
+    world->chunks = (uint8_t**)arena_alloc(arena, chunks * sizeof(uint8_t*));
+    world->light_storage = resident ? (uint8_t*)arena_alloc(arena, chunks * CHUNK_VOLUME) : NULL;
+    world->light = (uint8_t**)arena_alloc(arena, chunks * sizeof(uint8_t*));
+    world->light_queue = (WorldLightNode*)arena_alloc(arena, 2 * WORLD_LIGHT_QUEUE_SIZE * sizeof(WorldLightNode));
+    world->chunk_occupancy = (uint64_t*)arena_alloc(arena, chunks * sizeof(uint64_t));
+    world->brick_counts = (uint16_t*)arena_alloc(arena, chunks * BRICKS_PER_CHUNK * sizeof(uint16_t));
+    world->chunk_touched = (uint8_t*)arena_alloc(arena, chunks);
+    world->block_types = (BlockType*)arena_alloc(arena, MAX_BLOCK_TYPES * sizeof(BlockType));
+    int carved = world->chunks && world->light && world->light_queue && world->chunk_occupancy &&
+        world->brick_counts && world->chunk_touched && world->block_types &&
+        (!resident || (world->block_storage && world->light_storage));
+    for (int level = 0; level < WORLD_LOD_LEVELS; level++) {
+        world->lod[level] = (WorldLodCell*)arena_alloc(arena, lod_cells[level] * sizeof(WorldLodCell));
+        carved = carved && world->lod[level];
+    }
+    if (!carved) {
+        arena_release(arena);
+        free(world);
+        return NULL;
+    }
 
-                for (int j = 0; j < y; j++) {
-                    free(world->blocks[z][j]);
-                }
-                free(world->blocks[z]);
-                free(world->blocks);
-                free(world);
-                return NULL;
-            }
+    // Blocks in one contiguous block, or none until paged in
+    for (int i = 0; i < world->chunk_count; i++) {
+        world->chunks[i] = resident ? world->block_storage + (size_t)i * CHUNK_VOLUME : world_absent_chunk;
+    }
 
-            // Initialize all blocks to air
-            memset(world->blocks[z][y], BLOCK_AIR, width * sizeof(uint8_t));
-        }
+    // Light beside the blocks, with the queues that flood it (an all-air
+    // world is lit by the sky all the way down)
+    for (int i = 0; i < world->chunk_count; i++) {
+        world->light[i] = resident ? world->light_storage + (size_t)i * CHUNK_VOLUME : world_absent_light;
     }
+    memset(resident ? world->light_storage : world_absent_light, WORLD_LIGHT_MAX << WORLD_LIGHT_SKY_SHIFT,
+        resident ? chunks * CHUNK_VOLUME : CHUNK_VOLUME);
 
-    // Initialize block types
-    world->block_types = (BlockType*)malloc(MAX_BLOCK_TYPES * sizeof(BlockType));
-    if (!world->block_types) {
-        world_destroy(world);
-        return NULL;
+    // No edit transaction open
+    world->edit_depth = 0;
+
+    // Heightfield mips (an all-air world has no tops)
+    for (int level = 0; level < WORLD_LOD_LEVELS; level++) {
+        memset(world->lod[level], 0xFF, lod_cells[level] * sizeof(WorldLodCell));
     }
 
     // Copy default block types
     memcpy(world->block_types, default_block_types, MAX_BLOCK_TYPES * sizeof(BlockType));
     world->num_block_types = MAX_BLOCK_TYPES;
+    world_build_block_table(world);
 
     // Initialize time of day and sky brightness
     world->time_of_day = 0.5f;
     world->sky_brightness = 1.0f;
+    world->epoch_brightness = world->sky_brightness;
 
     return world;
 }
 
+// Create a new world
+World* world_create(int width, int height, int depth) {
+    return world_alloc(width, height, depth, 1);
+}
+
+// Create a world whose chunks are all absent until attached
+World* world_create_sparse(int width, int height, int depth) {
+    return world_alloc(width, height, depth, 0);
+}
+
 // Destroy a world
 void world_destroy(World* world) {
     if (!world) return;
 
-    // Free blocks
-    if (world->blocks) {
-        for (int z = 0; z < world->depth; z++) {
-            if (world->blocks[z]) {
-                for (int y = 0; y < world->height; y++) {
-                    free(world->blocks[z][y]);
-                }
-                free(world->blocks[z]);
-            }
-        }
-        free(world->blocks);
-    }
+    // Write back and release paged chunks
+    if (world->pager) world_pager_destroy(world);
 
-    // Free block types
-    free(world->block_types);
+    // Free blocks, derived data and block types
+    arena_release(&world->arena);
 
     // Free world
     free(world);
 }
 
-// Generate terrain using perlin noise
-void world_generate_terrain(World* world, unsigned int seed) {
-    if (!world) return;
+// Derived data updates used by generation
+static void world_rebuild_derived_parallel(World* world, ThreadPool* pool);
+
+// Shared state for the terrain generation stages
+typedef struct {
+    World* world;
+    unsigned int seed;
+    int* heightmap;          // Surface height per column
+    float* moisture;         // Surface moisture per column
+    float* noise_rows;       // One scratch row per thread
+    int regions_x;           // Tree regions (one per chunk column)
+    int regions_y;
+    int tree_pass;           // Current 2x2 parity pass of tree placement
+} TerrainJob;
+
+// Resolve the generation thread count (0 = one per CPU)
+static ThreadPool* world_create_gen_pool(void) {
+    int thread_count = WORLD_GEN_THREADS > 0 ? WORLD_GEN_THREADS : thread_cpu_count();
+    return threadpool_create(thread_count);
+}
+
+// Where generated blocks go: the whole world, or one detached chunk column
+typedef struct {
+    const World* world;
+    uint8_t* page;           // chunks_z chunks of one column, or NULL for the world's chunks
+    int page_x;              // Chunk column of the page
+    int page_y;
+} GenTarget;
+
+// Block cell at a position, or NULL if the target does not cover it
+static uint8_t* world_gen_cell(const GenTarget* target, int x, int y, int z) {
+    if (!target->page) {
+        return &target->world->chunks[world_chunk_index(target->world, x, y, z)][world_chunk_offset(x, y, z)];
+    }
+    if ((x >> CHUNK_SHIFT) != target->page_x || (y >> CHUNK_SHIFT) != target->page_y) {
+        return NULL;
+    }
+    return target->page + (size_t)(z >> CHUNK_SHIFT) * CHUNK_VOLUME + world_chunk_offset(x, y, z);
+}
 
-    // Set random seed
-    set_random_seed(seed);
+// Surface height from a base terrain noise sample
+static int world_surface_height(const World* world, float noise) {
+    // Normalize to world depth
+    int height = (int)((noise * 0.5f + 0.5f) * (world->depth * 0.7f));
 
-    // Generate heightmap
-    int* heightmap = (int*)malloc(world->width * world->height * sizeof(int));
-    if (!heightmap) return;
+    // Ensure minimum ground height
+    return height < GROUND_HEIGHT ? GROUND_HEIGHT : height;
+}
 
+// Heightmap and moisture for columns [x0, x0 + count) of row y
+static void world_terrain_noise_row(const World* world, unsigned int seed, int x0, int count, int y,
+                                    int* heights, float* moisture, float* noise_row) {
     // Terrain parameters
     float scale_x = 0.05f;
     float scale_y = 0.05f;
     int octaves = 4;
     float persistence = 0.5f;
 
-    // Generate heightmap
-    for (int y = 0; y < world->height; y++) {
-        for (int x = 0; x < world->width; x++) {
-            float nx = x * scale_x;
-            float ny = y * scale_y;
+    // Generate base terrain a whole row at a time
+    perlin_noise2d_row(noise_row, count, x0, scale_x, y * scale_y, octaves, persistence, seed);
+    for (int x = 0; x < count; x++) {
+        heights[x] = world_surface_height(world, noise_row[x]);
+    }
 
-            // Generate base terrain
-            float height = perlin_noise2d(nx, ny, octaves, persistence, seed);
+    // Surface moisture for the row
+    perlin_noise2d_row(moisture, count, x0, 0.1f, y * 0.1f, 2, 0.5f, seed + 1);
+}
 
-            // Normalize to world depth
-            height = (height * 0.5f + 0.5f) * (world->depth * 0.7f);
-            heightmap[y * world->width + x] = (int)height;
+// Top block of a column for its moisture
+static uint8_t world_surface_type(float moisture) {
+    if (moisture > 0.6f) return BLOCK_DIRT;   // Water area (water sits on top)
+    if (moisture < -0.3f) return BLOCK_SAND;  // Sandy area
+    return BLOCK_GRASS;
+}
 
-            // Ensure minimum ground height
-            if (heightmap[y * world->width + x] < GROUND_HEIGHT) {
-                heightmap[y * world->width + x] = GROUND_HEIGHT;
+// Fill one column of terrain
+static void world_fill_column(const GenTarget* target, int x, int y, int surface_height, float moisture) {
+    const World* world = target->world;
+
+    for (int z = 0; z < world->depth; z++) {
+        uint8_t* cell = world_gen_cell(target, x, y, z);
+
+        if (z < surface_height - 4) {
+            // Deep stone
+            *cell = BLOCK_STONE;
+        }
+        else if (z < surface_height - 1) {
+            // Dirt
+            *cell = BLOCK_DIRT;
+        }
+        else if (z == surface_height - 1) {
+            // Surface layer
+            *cell = world_surface_type(moisture);
+            if (moisture > 0.6f && z + 1 < world->depth) {
+                *world_gen_cell(target, x, y, z + 1) = BLOCK_WATER;
             }
         }
     }
+}
 
-    // Fill terrain
-    for (int y = 0; y < world->height; y++) {
-        for (int x = 0; x < world->width; x++) {
-            int surface_height = heightmap[y * world->width + x];
+// Stage 1: heightmap and moisture for one row of columns
+static void world_terrain_noise_task(void* context, int task_index, int thread_index) {
+    TerrainJob* job = (TerrainJob*)context;
+    World* world = job->world;
+    int y = task_index;
 
-            for (int z = 0; z < world->depth; z++) {
-                if (z < surface_height - 4) {
-                    // Deep stone
-                    world->blocks[z][y][x] = BLOCK_STONE;
-                }
-                else if (z < surface_height - 1) {
-                    // Dirt
-                    world->blocks[z][y][x] = BLOCK_DIRT;
-                }
-                else if (z == surface_height - 1) {
-                    // Surface layer
-                    float moisture = perlin_noise2d(x * 0.1f, y * 0.1f, 2, 0.5f, seed + 1);
-                    if (moisture > 0.6f) {
-                        // Water area
-                        world->blocks[z][y][x] = BLOCK_DIRT;
-                        if (z + 1 < world->depth) {
-                            world->blocks[z + 1][y][x] = BLOCK_WATER;
-                        }
-                    }
-                    else if (moisture < -0.3f) {
-                        // Sandy area
-                        world->blocks[z][y][x] = BLOCK_SAND;
-                    }
-                    else {
-                        // Grass
-                        world->blocks[z][y][x] = BLOCK_GRASS;
-                    }
-                }
-            }
+    world_terrain_noise_row(world, job->seed, 0, world->width, y,
+        job->heightmap + (size_t)y * world->width, job->moisture + (size_t)y * world->width,
+        job->noise_rows + (size_t)thread_index * world->width);
+}
+
+// Stage 2: fill the columns of one chunk column (only touches its own chunks)
+static void world_terrain_fill_task(void* context, int task_index, int thread_index) {
+    TerrainJob* job = (TerrainJob*)context;
+    (void)thread_index;
+    World* world = job->world;
+    GenTarget target = { world, NULL, 0, 0 };
+    int x0 = (task_index % world->chunks_x) * CHUNK_SIZE;
+    int y0 = (task_index / world->chunks_x) * CHUNK_SIZE;
+    int x1 = min_int(x0 + CHUNK_SIZE, world->width);
+    int y1 = min_int(y0 + CHUNK_SIZE, world->height);
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            size_t column = (size_t)y * world->width + x;
+            world_fill_column(&target, x, y, job->heightmap[column], job->moisture[column]);
         }
     }
+}
 
-    // Generate trees
-    int tree_count = (world->width * world->height) / 100;
-    for (int i = 0; i < tree_count; i++) {
-        int tx = random_int(3, world->width - 4);
-        int ty = random_int(3, world->height - 4);
-        int surface_height = heightmap[ty * world->width + tx];
+// Place one tree with its trunk at (tx, ty); blocks outside the target are skipped
+static void world_place_tree(const GenTarget* target, int surface_height, float moisture,
+                             int tree_height, int tx, int ty) {
+    const World* world = target->world;
+
+    // Only place trees on grass
+    if (surface_height >= world->depth - 5 || world_surface_type(moisture) != BLOCK_GRASS) {
+        return;
+    }
+
+    // Tree trunk
+    for (int tz = surface_height; tz < surface_height + tree_height; tz++) {
+        uint8_t* cell = tz < world->depth ? world_gen_cell(target, tx, ty, tz) : NULL;
+        if (cell) {
+            *cell = BLOCK_WOOD;
+        }
+    }
 
-        // Only place trees on grass
-        if (surface_height < world->depth - 5 &&
-            world->blocks[surface_height - 1][ty][tx] == BLOCK_GRASS) {
+    // Tree leaves
+    for (int lz = surface_height + tree_height - 3; lz < surface_height + tree_height + 1; lz++) {
+        if (lz >= world->depth) continue;
 
-            // Tree height
-            int tree_height = random_int(4, 7);
+        for (int ly = ty - 2; ly <= ty + 2; ly++) {
+            if (ly < 0 || ly >= world->height) continue;
 
-            // Tree trunk
-            for (int tz = surface_height; tz < surface_height + tree_height; tz++) {
-                if (tz < world->depth) {
-                    world->blocks[tz][ty][tx] = BLOCK_WOOD;
+            for (int lx = tx - 2; lx <= tx + 2; lx++) {
+                if (lx < 0 || lx >= world->width) continue;
+
+                // Distance from trunk
+                int dx = lx - tx;
+                int dy = ly - ty;
+                int dz = lz - (surface_height + tree_height - 1);
+                float dist = sqrtf(dx * dx + dy * dy + dz * dz * 2.0f);
+
+                // Place leaves in a spherical pattern
+                uint8_t* cell = world_gen_cell(target, lx, ly, lz);
+                if (dist < 2.5f && cell && *cell == BLOCK_AIR) {
+                    *cell = BLOCK_LEAVES;
                 }
             }
+        }
+    }
+}
+
+// Trees of one region (chunk column). Each region draws from its own stream,
+// so the result does not depend on which thread runs it or when. heightmap
+// and moisture cover the box [map_x0, map_x1) x [map_y0, map_y1) with stride
+// map_x1 - map_x0; trunks outside it are drawn but not placed.
+static void world_region_trees(const GenTarget* target, unsigned int seed, int rx, int ry,
+                               const int* heightmap, const float* moisture,
+                               int map_x0, int map_y0, int map_x1, int map_y1) {
+    const World* world = target->world;
+    int region = ry * world->chunks_x + rx;
+    Rng rng;
+    rng_seed(&rng, seed * 0x9e3779b9u ^ (unsigned int)region * 0x85ebca6bu);
+
+    // Trunks stay 3 blocks from the world edge
+    int x0 = max_int(rx * CHUNK_SIZE, 3);
+    int y0 = max_int(ry * CHUNK_SIZE, 3);
+    int x1 = min_int((rx + 1) * CHUNK_SIZE, world->width - 3);
+    int y1 = min_int((ry + 1) * CHUNK_SIZE, world->height - 3);
+    if (x1 <= x0 || y1 <= y0) return;
+
+    // One tree per 100 columns on average
+    int area = CHUNK_SIZE * CHUNK_SIZE;
+    int tree_count = area / 100 + (rng_int(&rng, 0, 99) < area % 100 ? 1 : 0);
+
+    for (int i = 0; i < tree_count; i++) {
+        int tx = rng_int(&rng, x0, x1 - 1);
+        int ty = rng_int(&rng, y0, y1 - 1);
+        int tree_height = rng_int(&rng, 4, 7);
 
-            // Tree leaves
-            for (int lz = surface_height + tree_height - 3; lz < surface_height + tree_height + 1; lz++) {
-                if (lz >= world->depth) continue;
+        if (tx < map_x0 || tx >= map_x1 || ty < map_y0 || ty >= map_y1) continue;
 
-                for (int ly = ty - 2; ly <= ty + 2; ly++) {
-                    if (ly < 0 || ly >= world->height) continue;
+        size_t column = (size_t)(ty - map_y0) * (map_x1 - map_x0) + (tx - map_x0);
+        world_place_tree(target, heightmap[column], moisture[column], tree_height, tx, ty);
+    }
+}
 
-                    for (int lx = tx - 2; lx <= tx + 2; lx++) {
-                        if (lx < 0 || lx >= world->width) continue;
+// Stage 3: trees for one region of the current pass
+static void world_terrain_trees_task(void* context, int task_index, int thread_index) {
+    TerrainJob* job = (TerrainJob*)context;
+    (void)thread_index;
+    World* world = job->world;
+    GenTarget target = { world, NULL, 0, 0 };
+
+    // Regions of the current pass sit two apart on both axes, so their
+    // trees (reaching 2 blocks past the trunk) never touch the same blocks
+    int pass_x = job->tree_pass & 1;
+    int pass_y = job->tree_pass >> 1;
+    int per_row = (job->regions_x - pass_x + 1) / 2;
+    int rx = (task_index % per_row) * 2 + pass_x;
+    int ry = (task_index / per_row) * 2 + pass_y;
+
+    world_region_trees(&target, job->seed, rx, ry, job->heightmap, job->moisture,
+        0, 0, world->width, world->height);
+}
 
-                        // Distance from trunk
-                        int dx = lx - tx;
-                        int dy = ly - ty;
-                        int dz = lz - (surface_height + tree_height - 1);
-                        float dist = sqrtf(dx * dx + dy * dy + dz * dz * 2.0f);
+// Generate one chunk column into storage (chunks_z chunks, zeroed by the
+// caller), exactly as world_generate_terrain would. Only reads the world's
+// dimensions, so it is safe to call from any thread.
+int world_generate_chunk_column(const World* world, unsigned int seed, int cx, int cy, uint8_t* storage) {
+    if (!world || !storage) return 0;
+
+    GenTarget target = { world, storage, cx, cy };
+
+    // Terrain for the column plus the 2-block reach of neighbouring trees
+    enum { MAP_SIZE = CHUNK_SIZE + 4 };
+    int heightmap[MAP_SIZE * MAP_SIZE];
+    float moisture[MAP_SIZE * MAP_SIZE];
+    float noise_row[MAP_SIZE];
+    int map_x0 = max_int(cx * CHUNK_SIZE - 2, 0);
+    int map_y0 = max_int(cy * CHUNK_SIZE - 2, 0);
+    int map_x1 = min_int((cx + 1) * CHUNK_SIZE + 2, world->width);
+    int map_y1 = min_int((cy + 1) * CHUNK_SIZE + 2, world->height);
+    int map_width = map_x1 - map_x0;
+
+    for (int y = map_y0; y < map_y1; y++) {
+        size_t row = (size_t)(y - map_y0) * map_width;
+        world_terrain_noise_row(world, seed, map_x0, map_width, y, heightmap + row, moisture + row, noise_row);
+    }
 
-                        // Place leaves in a spherical pattern
-                        if (dist < 2.5f && world->blocks[lz][ly][lx] == BLOCK_AIR) {
-                            world->blocks[lz][ly][lx] = BLOCK_LEAVES;
-                        }
-                    }
-                }
+    int x0 = cx * CHUNK_SIZE;
+    int y0 = cy * CHUNK_SIZE;
+    for (int y = y0; y < min_int(y0 + CHUNK_SIZE, world->height); y++) {
+        for (int x = x0; x < min_int(x0 + CHUNK_SIZE, world->width); x++) {
+            size_t column = (size_t)(y - map_y0) * map_width + (x - map_x0);
+            world_fill_column(&target, x, y, heightmap[column], moisture[column]);
+        }
+    }
+
+    // Trees from this region and its neighbours, in the same pass order
+    for (int pass = 0; pass < 4; pass++) {
+        for (int ry = max_int(cy - 1, 0); ry <= min_int(cy + 1, world->chunks_y - 1); ry++) {
+            for (int rx = max_int(cx - 1, 0); rx <= min_int(cx + 1, world->chunks_x - 1); rx++) {
+                if ((rx & 1) != (pass & 1) || (ry & 1) != (pass >> 1)) continue;
+                world_region_trees(&target, seed, rx, ry, heightmap, moisture, map_x0, map_y0, map_x1, map_y1);
             }
         }
     }
 
-    // Free heightmap
-    free(heightmap);
+    return 1;
+}
+
+// Generate terrain using perlin noise. Stages run on worker threads; the
+// result is identical for any thread count.
+void world_generate_terrain(World* world, unsigned int seed) {
+    if (!world) return;
+
+    ThreadPool* pool = world_create_gen_pool();
+    int thread_count = threadpool_thread_count(pool);
+
+    TerrainJob job;
+    job.world = world;
+    job.seed = seed;
+    job.heightmap = (int*)malloc((size_t)world->width * world->height * sizeof(int));
+    job.moisture = (float*)malloc((size_t)world->width * world->height * sizeof(float));
+    job.noise_rows = (float*)malloc((size_t)thread_count * world->width * sizeof(float));
+    job.regions_x = world->chunks_x;
+    job.regions_y = world->chunks_y;
+    job.tree_pass = 0;
+
+    if (!job.heightmap || !job.moisture || !job.noise_rows) {
+        free(job.heightmap);
+        free(job.moisture);
+        free(job.noise_rows);
+        threadpool_destroy(pool);
+        return;
+    }
+
+    // Heightmap and moisture, one row per task
+    threadpool_run(pool, world_terrain_noise_task, &job, world->height);
+
+    // Fill terrain, one chunk column per task
+    threadpool_run(pool, world_terrain_fill_task, &job, world->chunks_x * world->chunks_y);
+
+    // Generate trees in four passes of non-adjacent regions
+    for (int pass = 0; pass < 4; pass++) {
+        int pass_x = pass & 1;
+        int pass_y = pass >> 1;
+        int count_x = (job.regions_x - pass_x + 1) / 2;
+        int count_y = (job.regions_y - pass_y + 1) / 2;
+
+        job.tree_pass = pass;
+        threadpool_run(pool, world_terrain_trees_task, &job, count_x * count_y);
+    }
+
+    free(job.heightmap);
+    free(job.moisture);
+    free(job.noise_rows);
+
+    // Build light and occupancy for the new terrain
+    world_rebuild_derived_parallel(world, pool);
+    threadpool_destroy(pool);
 }
 
 // Generate structures (houses, caves, etc.)
 void world_generate_structures(World* world, unsigned int seed) {
     if (!world) return;
 
-    // Set random seed
-    set_random_seed(seed + 100);
-
-    // Generate a simple house
-    int house_x = world->width / 2;
-    int house_y = world->height / 2;
+    // Generate a simple house near the world centre, offset by the seed
+    Rng rng;
+    rng_seed(&rng, seed);
+    int spread_x = world->width / 8;
+    int spread_y = world->height / 8;
+    int house_x = world->width / 2 + rng_int(&rng, -spread_x, spread_x);
+    int house_y = world->height / 2 + rng_int(&rng, -spread_y, spread_y);
     int house_z = 0;
 
     // Find ground level
     while (house_z < world->depth &&
-        world->blocks[house_z][house_y][house_x] == BLOCK_AIR) {
+        world_get_block_fast(world, house_x, house_y, house_z) == BLOCK_AIR) {
         house_z++;
     }
 
@@ -289,41 +575,415 @@ void world_generate_structures(World* world, unsigned int seed) {
         return;
     }
 
-    // Build floor
-    for (int y = 0; y < house_length; y++) {
-        for (int x = 0; x < house_width; x++) {
-            world->blocks[house_z][house_y + y][house_x + x] = BLOCK_WOOD;
+    // One transaction, so derived data is refreshed once for the house
+    int x1 = house_x + house_width - 1;
+    int y1 = house_y + house_length - 1;
+    world_begin_edit(world);
+
+    // Floor and roof
+    world_fill_box(world, house_x, house_y, house_z, x1, y1, house_z, BLOCK_WOOD);
+    world_fill_box(world, house_x, house_y, house_z + house_height, x1, y1, house_z + house_height, BLOCK_WOOD);
+
+    // Walls on the perimeter
+    int wall_z0 = house_z + 1;
+    int wall_z1 = house_z + house_height - 1;
+    world_fill_box(world, house_x, house_y, wall_z0, x1, house_y, wall_z1, BLOCK_BRICK);
+    world_fill_box(world, house_x, y1, wall_z0, x1, y1, wall_z1, BLOCK_BRICK);
+    world_fill_box(world, house_x, house_y + 1, wall_z0, house_x, y1 - 1, wall_z1, BLOCK_BRICK);
+    world_fill_box(world, x1, house_y + 1, wall_z0, x1, y1 - 1, wall_z1, BLOCK_BRICK);
+
+    // Door in the middle of one wall
+    int door_x = house_x + house_width / 2;
+    world_fill_box(world, door_x, house_y, wall_z0, door_x, house_y, house_z + 2, BLOCK_AIR);
+
+    // Add a window
+    world_set_block(world, x1 - 1, y1 - 1, house_z + 2, BLOCK_AIR);
+
+    world_commit_edit(world);
+}
+
+// Recompute the surface (level 0 mip cell) of one column. Returns whether
+// it changed.
+static int world_update_column_surface(World* world, int x, int y) {
+    WorldLodCell surface = { -1, BLOCK_AIR };
+
+    for (int z = world->depth - 1; z >= 0; z--) {
+        uint8_t type = world_get_block_fast(world, x, y, z);
+        if (type != BLOCK_AIR) {
+            surface.top = (int16_t)z;
+            surface.type = type;
+            break;
         }
     }
 
-    // Build walls
-    for (int z = 1; z < house_height; z++) {
-        for (int y = 0; y < house_length; y++) {
-            for (int x = 0; x < house_width; x++) {
-                // Only build walls on the perimeter
-                if (x == 0 || x == house_width - 1 || y == 0 || y == house_length - 1) {
-                    // Door in the middle of one wall
-                    if (!(z < 3 && x == house_width / 2 && y == 0)) {
-                        world->blocks[house_z + z][house_y + y][house_x + x] = BLOCK_BRICK;
+    WorldLodCell* cell = &world->lod[0][(size_t)y * world->width + x];
+    if (cell->top == surface.top && cell->type == surface.type) return 0;
+    *cell = surface;
+    return 1;
+}
+
+// Rebuild the coarser mip cells over a box of columns from the level below.
+// The box grows to cover the columns of every cell that changed, full
+// height, since far-field rays see the whole cell at the new top.
+static void world_update_lod(World* world, WorldEdit* box) {
+    int x0 = box->x0, y0 = box->y0, x1 = box->x1, y1 = box->y1;
+
+    for (int level = 1; level < WORLD_LOD_LEVELS; level++) {
+        const WorldLodCell* below = world->lod[level - 1];
+        int below_width = world_lod_width(world, level - 1);
+        int below_height = world_lod_height(world, level - 1);
+        WorldLodCell* cells = world->lod[level];
+        int width = world_lod_width(world, level);
+        int changed = 0;
+
+        x0 >>= 1;
+        y0 >>= 1;
+        x1 >>= 1;
+        y1 >>= 1;
+        for (int y = y0; y <= y1; y++) {
+            for (int x = x0; x <= x1; x++) {
+                // Highest of the (up to) four cells below
+                WorldLodCell best = { -1, BLOCK_AIR };
+                for (int sy = 2 * y; sy <= 2 * y + 1 && sy < below_height; sy++) {
+                    for (int sx = 2 * x; sx <= 2 * x + 1 && sx < below_width; sx++) {
+                        const WorldLodCell* child = &below[(size_t)sy * below_width + sx];
+                        if (child->top > best.top) best = *child;
                     }
                 }
+
+                WorldLodCell* cell = &cells[(size_t)y * width + x];
+                if (cell->top != best.top || cell->type != best.type) {
+                    *cell = best;
+                    changed = 1;
+                }
             }
         }
+
+        if (!changed) break;
+
+        box->x0 = min_int(box->x0, x0 << level);
+        box->y0 = min_int(box->y0, y0 << level);
+        box->x1 = max_int(box->x1, min_int(((x1 + 1) << level) - 1, world->width - 1));
+        box->y1 = max_int(box->y1, min_int(((y1 + 1) << level) - 1, world->height - 1));
+        box->z0 = 0;
+        box->z1 = world->depth - 1;
     }
+}
+
+// Rebuild the coarser mip levels of the whole world from its columns
+static void world_rebuild_lod(World* world) {
+    WorldEdit box = { 0, 0, 0, world->width - 1, world->height - 1, world->depth - 1 };
+    world_update_lod(world, &box);
+}
 
-    // Build roof
-    for (int y = 0; y < house_length; y++) {
-        for (int x = 0; x < house_width; x++) {
-            world->blocks[house_z + house_height][house_y + y][house_x + x] = BLOCK_WOOD;
+// Thread pool task: surfaces for one row of columns
+static void world_surface_row_task(void* context, int task_index, int thread_index) {
+    World* world = (World*)context;
+    (void)thread_index;
+    for (int x = 0; x < world->width; x++) {
+        world_update_column_surface(world, x, task_index);
+    }
+}
+
+// Rebuild the brick counts and mask of one chunk
+static void world_update_chunk_occupancy(World* world, int chunk) {
+    const uint8_t* blocks = world->chunks[chunk];
+    uint16_t* counts = world->brick_counts + (size_t)chunk * BRICKS_PER_CHUNK;
+    uint64_t mask = 0;
+
+    memset(counts, 0, BRICKS_PER_CHUNK * sizeof(uint16_t));
+
+    for (int offset = 0; offset < CHUNK_VOLUME; offset++) {
+        if (blocks[offset] != BLOCK_AIR) {
+            int brick = world_brick_index(offset & CHUNK_MASK,
+                (offset >> CHUNK_SHIFT) & CHUNK_MASK, offset >> (2 * CHUNK_SHIFT));
+            counts[brick]++;
+            mask |= (uint64_t)1 << brick;
         }
     }
 
-    // Add a window
-    int window_x = house_width - 2;
-    int window_y = house_length - 2;
-    int window_z = house_z + 2;
+    world->chunk_occupancy[chunk] = mask;
+}
 
-    world->blocks[window_z][house_y + window_y][house_x + window_x] = BLOCK_AIR;
+// Thread pool task: occupancy for one chunk
+static void world_occupancy_chunk_task(void* context, int task_index, int thread_index) {
+    (void)thread_index;
+    world_update_chunk_occupancy((World*)context, task_index);
+}
+
+// Record a changed box (inclusive bounds) as the next generation
+static void world_log_edit(World* world, int x0, int y0, int z0, int x1, int y1, int z1) {
+    world->generation++;
+
+    WorldEdit* edit = &world->edit_log[world->generation % WORLD_EDIT_LOG_SIZE];
+    edit->x0 = x0;
+    edit->y0 = y0;
+    edit->z0 = z0;
+    edit->x1 = x1;
+    edit->y1 = y1;
+    edit->z1 = z1;
+}
+
+// Start a new generation after a change too wide to log
+static void world_log_everything(World* world) {
+    world->generation++;
+    world->edit_log_start = world->generation;
+}
+
+// Box changed by a generation, if the log still has it
+const WorldEdit* world_get_edit(const World* world, unsigned int generation) {
+    if (!world || generation <= world->edit_log_start || generation > world->generation ||
+        world->generation - generation >= WORLD_EDIT_LOG_SIZE) {
+        return NULL;
+    }
+    return &world->edit_log[generation % WORLD_EDIT_LOG_SIZE];
+}
+
+// Refresh derived data after bulk writes inside a box (inclusive bounds):
+// occupancy of its chunks and surfaces of their columns, then mips and
+// light. With touched, only the chunks it flags, clearing the flags.
+static void world_refresh_chunks(World* world, const WorldEdit* bounds, uint8_t* touched) {
+    WorldEdit box = *bounds;
+    int surface_changed = 0;
+
+    for (int cy = box.y0 >> CHUNK_SHIFT; cy <= box.y1 >> CHUNK_SHIFT; cy++) {
+        for (int cx = box.x0 >> CHUNK_SHIFT; cx <= box.x1 >> CHUNK_SHIFT; cx++) {
+            int column_touched = 0;
+            for (int cz = box.z0 >> CHUNK_SHIFT; cz <= box.z1 >> CHUNK_SHIFT; cz++) {
+                int chunk = (cz * world->chunks_y + cy) * world->chunks_x + cx;
+                if (touched) {
+                    if (!touched[chunk]) continue;
+                    touched[chunk] = 0;
+                }
+                world_update_chunk_occupancy(world, chunk);
+                column_touched = 1;
+            }
+            if (!column_touched) continue;
+
+            // Surfaces of the box's columns in this chunk column
+            int x1 = min_int(box.x1, (cx << CHUNK_SHIFT) + CHUNK_MASK);
+            int y1 = min_int(box.y1, (cy << CHUNK_SHIFT) + CHUNK_MASK);
+            for (int y = max_int(box.y0, cy << CHUNK_SHIFT); y <= y1; y++) {
+                for (int x = max_int(box.x0, cx << CHUNK_SHIFT); x <= x1; x++) {
+                    surface_changed |= world_update_column_surface(world, x, y);
+                }
+            }
+        }
+    }
+
+    if (surface_changed) world_update_lod(world, &box);
+    world_light_refresh_box(world, &box);
+    world_log_edit(world, box.x0, box.y0, box.z0, box.x1, box.y1, box.z1);
+}
+
+// Refresh derived data after bulk writes inside a box (inclusive bounds)
+void world_refresh_derived_box(World* world, int x0, int y0, int z0, int x1, int y1, int z1) {
+    WorldEdit box = { x0, y0, z0, x1, y1, z1 };
+    world_refresh_chunks(world, &box, NULL);
+}
+
+// Grow the open transaction's bounds to cover a box
+static void world_edit_include(World* world, const WorldEdit* box) {
+    WorldEdit* bounds = &world->edit_bounds;
+    bounds->x0 = min_int(bounds->x0, box->x0);
+    bounds->y0 = min_int(bounds->y0, box->y0);
+    bounds->z0 = min_int(bounds->z0, box->z0);
+    bounds->x1 = max_int(bounds->x1, box->x1);
+    bounds->y1 = max_int(bounds->y1, box->y1);
+    bounds->z1 = max_int(bounds->z1, box->z1);
+}
+
+// Open an edit transaction
+void world_begin_edit(World* world) {
+    if (!world) return;
+    if (world->edit_depth++ == 0) {
+        WorldEdit none = { world->width, world->height, world->depth, -1, -1, -1 };
+        world->edit_bounds = none;
+    }
+}
+
+// Close an edit transaction; the outermost one refreshes what it wrote
+void world_commit_edit(World* world) {
+    if (!world || world->edit_depth == 0 || --world->edit_depth > 0) return;
+    if (world->edit_bounds.x0 > world->edit_bounds.x1) return;
+    world_refresh_chunks(world, &world->edit_bounds, world->chunk_touched);
+}
+
+// Writes the blocks of a bulk edit inside one part of its box, which lies
+// in a single chunk column
+typedef void (*WorldEditWriter)(World* world, const WorldEdit* part, const void* context);
+
+// Run a bulk edit over a box inside a transaction. It goes one chunk column
+// at a time so a paged world needs each column only while it is written.
+static void world_edit_box(World* world, WorldEdit box, WorldEditWriter write, const void* context) {
+    box.x0 = max_int(box.x0, 0);
+    box.y0 = max_int(box.y0, 0);
+    box.z0 = max_int(box.z0, 0);
+    box.x1 = min_int(box.x1, world->width - 1);
+    box.y1 = min_int(box.y1, world->height - 1);
+    box.z1 = min_int(box.z1, world->depth - 1);
+    if (box.x0 > box.x1 || box.y0 > box.y1 || box.z0 > box.z1) return;
+
+    world_begin_edit(world);
+    for (int cy = box.y0 >> CHUNK_SHIFT; cy <= box.y1 >> CHUNK_SHIFT; cy++) {
+        for (int cx = box.x0 >> CHUNK_SHIFT; cx <= box.x1 >> CHUNK_SHIFT; cx++) {
+            // Page the column in and mark it for writeback
+            if (world->pager && !world_pager_require(world, cx, cy, 1)) continue;
+
+            WorldEdit part = {
+                max_int(box.x0, cx << CHUNK_SHIFT), max_int(box.y0, cy << CHUNK_SHIFT), box.z0,
+                min_int(box.x1, (cx << CHUNK_SHIFT) + CHUNK_MASK), min_int(box.y1, (cy << CHUNK_SHIFT) + CHUNK_MASK), box.z1
+            };
+            write(world, &part, context);
+
+            for (int cz = box.z0 >> CHUNK_SHIFT; cz <= box.z1 >> CHUNK_SHIFT; cz++) {
+                world->chunk_touched[(cz * world->chunks_y + cy) * world->chunks_x + cx] = 1;
+            }
+            world_edit_include(world, &part);
+        }
+    }
+    world_commit_edit(world);
+}
+
+// Edit writer: one type over the whole part, a chunk row at a time
+static void world_fill_box_writer(World* world, const WorldEdit* part, const void* context) {
+    uint8_t type = *(const uint8_t*)context;
+    size_t length = (size_t)(part->x1 - part->x0 + 1);
+
+    for (int z = part->z0; z <= part->z1; z++) {
+        for (int y = part->y0; y <= part->y1; y++) {
+            uint8_t* chunk = world->chunks[world_chunk_index(world, part->x0, y, z)];
+            memset(chunk + world_chunk_offset(part->x0, y, z), type, length);
+        }
+    }
+}
+
+// Fill a box with one type
+void world_fill_box(World* world, int x0, int y0, int z0, int x1, int y1, int z1, uint8_t type) {
+    if (!world) return;
+    WorldEdit box = { x0, y0, z0, x1, y1, z1 };
+    world_edit_box(world, box, world_fill_box_writer, &type);
+}
+
+// Ball filled by world_fill_sphere
+typedef struct {
+    float x, y, z;
+    float radius_squared;
+    uint8_t type;
+} WorldSphere;
+
+// Edit writer: one type over the blocks whose centres lie in the ball
+static void world_fill_sphere_writer(World* world, const WorldEdit* part, const void* context) {
+    const WorldSphere* sphere = (const WorldSphere*)context;
+
+    for (int z = part->z0; z <= part->z1; z++) {
+        float dz = (float)z + 0.5f - sphere->z;
+        for (int y = part->y0; y <= part->y1; y++) {
+            float dy = (float)y + 0.5f - sphere->y;
+            for (int x = part->x0; x <= part->x1; x++) {
+                float dx = (float)x + 0.5f - sphere->x;
+                if (dx * dx + dy * dy + dz * dz <= sphere->radius_squared) {
+                    world_set_block_fast(world, x, y, z, sphere->type);
+                }
+            }
+        }
+    }
+}
+
+// Fill a ball with one type
+void world_fill_sphere(World* world, float x, float y, float z, float radius, uint8_t type) {
+    if (!world || !(radius > 0.0f)) return;
+
+    WorldSphere sphere = { x, y, z, radius * radius, type };
+    WorldEdit box = {
+        (int)floorf(x - radius), (int)floorf(y - radius), (int)floorf(z - radius),
+        (int)floorf(x + radius), (int)floorf(y + radius), (int)floorf(z + radius)
+    };
+    world_edit_box(world, box, world_fill_sphere_writer, &sphere);
+}
+
+// Template placed by world_stamp
+typedef struct {
+    int x, y, z;
+    int width, height;
+    const uint8_t* blocks;
+} WorldStamp;
+
+// Edit writer: the template's cells over the part, skipping kept ones
+static void world_stamp_writer(World* world, const WorldEdit* part, const void* context) {
+    const WorldStamp* stamp = (const WorldStamp*)context;
+
+    for (int z = part->z0; z <= part->z1; z++) {
+        for (int y = part->y0; y <= part->y1; y++) {
+            const uint8_t* row = stamp->blocks +
+                ((size_t)(z - stamp->z) * stamp->height + (y - stamp->y)) * stamp->width;
+            for (int x = part->x0; x <= part->x1; x++) {
+                uint8_t type = row[x - stamp->x];
+                if (type != WORLD_STAMP_KEEP) world_set_block_fast(world, x, y, z, type);
+            }
+        }
+    }
+}
+
+// Stamp a template of types
+void world_stamp(World* world, int x, int y, int z, int width, int height, int depth, const uint8_t* blocks) {
+    if (!world || !blocks || width <= 0 || height <= 0 || depth <= 0) return;
+
+    WorldStamp stamp = { x, y, z, width, height, blocks };
+    WorldEdit box = { x, y, z, x + width - 1, y + height - 1, z + depth - 1 };
+    world_edit_box(world, box, world_stamp_writer, &stamp);
+}
+
+// Swap the storage of a chunk column in or out
+void world_attach_chunk_column(World* world, int cx, int cy, uint8_t* storage) {
+    if (!world || cx < 0 || cy < 0 || cx >= world->chunks_x || cy >= world->chunks_y) return;
+
+    uint8_t* light = storage ? storage + (size_t)world->chunks_z * CHUNK_VOLUME : NULL;
+    for (int cz = 0; cz < world->chunks_z; cz++) {
+        int chunk = (cz * world->chunks_y + cy) * world->chunks_x + cx;
+        world->chunks[chunk] = storage ? storage + (size_t)cz * CHUNK_VOLUME : world_absent_chunk;
+        world->light[chunk] = light ? light + (size_t)cz * CHUNK_VOLUME : world_absent_light;
+    }
+
+    int x0 = cx * CHUNK_SIZE;
+    int y0 = cy * CHUNK_SIZE;
+    world_refresh_derived_box(world, x0, y0, 0,
+        min_int(x0 + CHUNK_SIZE, world->width) - 1, min_int(y0 + CHUNK_SIZE, world->height) - 1, world->depth - 1);
+}
+
+// Rebuild light and surfaces for the whole world
+void world_rebuild_skylight(World* world) {
+    if (!world) return;
+    world_log_everything(world);
+    threadpool_run(NULL, world_surface_row_task, world, world->height);
+    world_rebuild_lod(world);
+    world_light_rebuild(world);
+}
+
+// Rebuild brick occupancy for the whole world
+void world_rebuild_occupancy(World* world) {
+    if (!world) return;
+    world_log_everything(world);
+    threadpool_run(NULL, world_occupancy_chunk_task, world, world->chunk_count);
+}
+
+// Rebuild all data derived from blocks on a thread pool
+static void world_rebuild_derived_parallel(World* world, ThreadPool* pool) {
+    if (!world) return;
+    world_log_everything(world);
+    threadpool_run(pool, world_surface_row_task, world, world->height);
+    world_rebuild_lod(world);
+    threadpool_run(pool, world_occupancy_chunk_task, world, world->chunk_count);
+    world_light_rebuild(world);
+}
+
+// Rebuild all data derived from blocks
+void world_rebuild_derived(World* world) {
+    if (!world) return;
+
+    ThreadPool* pool = world_create_gen_pool();
+    world_rebuild_derived_parallel(world, pool);
+    threadpool_destroy(pool);
 }
 
 // Get block at position
@@ -332,7 +992,10 @@ uint8_t world_get_block(World* world, int x, int y, int z) {
         return BLOCK_AIR;
     }
 
-    return world->blocks[z][y][x];
+    // Page the chunk in if needed
+    if (world->pager) world_pager_require(world, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, 0);
+
+    return world_get_block_fast(world, x, y, z);
 }
 
 // Set block at position
@@ -341,7 +1004,46 @@ void world_set_block(World* world, int x, int y, int z, uint8_t type) {
         return;
     }
 
-    world->blocks[z][y][x] = type;
+    // Page the chunk in and mark it for writeback
+    if (world->pager && !world_pager_require(world, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, 1)) {
+        return;
+    }
+
+    // Inside a transaction the commit refreshes derived data
+    WorldEdit box = { x, y, z, x, y, z };
+    if (world->edit_depth > 0) {
+        world_set_block_fast(world, x, y, z, type);
+        world->chunk_touched[world_chunk_index(world, x, y, z)] = 1;
+        world_edit_include(world, &box);
+        return;
+    }
+
+    uint8_t old_type = world_get_block_fast(world, x, y, z);
+    world_set_block_fast(world, x, y, z, type);
+
+    // Keep brick occupancy in sync
+    if ((old_type == BLOCK_AIR) != (type == BLOCK_AIR)) {
+        int chunk = world_chunk_index(world, x, y, z);
+        int brick = world_brick_index(x, y, z);
+        uint16_t* count = world->brick_counts + (size_t)chunk * BRICKS_PER_CHUNK + brick;
+
+        if (type != BLOCK_AIR) {
+            (*count)++;
+            world->chunk_occupancy[chunk] |= (uint64_t)1 << brick;
+        }
+        else if (--(*count) == 0) {
+            world->chunk_occupancy[chunk] &= ~((uint64_t)1 << brick);
+        }
+    }
+
+    // The surface only changes at or above the column's top block
+    if (z >= world->lod[0][(size_t)y * world->width + x].top && world_update_column_surface(world, x, y)) {
+        world_update_lod(world, &box);
+    }
+
+    // Light changes around the block, and below it where it shades the sky
+    world_light_update_block(world, x, y, z, &box);
+    world_log_edit(world, box.x0, box.y0, box.z0, box.x1, box.y1, box.z1);
 }
 
 // Check if a block is solid
@@ -350,13 +1052,10 @@ int world_is_solid(World* world, int x, int y, int z) {
         return 0;
     }
 
-    uint8_t type = world->blocks[z][y][x];
+    // Page the chunk in if needed
+    if (world->pager) world_pager_require(world, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, 0);
 
-    if (type >= world->num_block_types) {
-        return 0;
-    }
-
-    return world->block_types[type].solid;
+    return world_block_flags(world, world_get_block_fast(world, x, y, z)) & BLOCK_FLAG_SOLID;
 }
 
 // Check if a position is valid
@@ -372,40 +1071,32 @@ int world_is_valid_position(World* world, int x, int y, int z) {
 
 // Get brightness at position
 float world_get_brightness(World* world, int x, int y, int z) {
-    if (!world || !world_is_valid_position(world, x, y, z)) {
-        return 0.0f;
-    }
-
-    // Base brightness from sky
-    float brightness = world->sky_brightness;
-
-    // Reduce brightness when underground
-    for (int check_z = z + 1; check_z < world->depth; check_z++) {
-        if (world_is_valid_position(world, x, y, check_z)) {
-            uint8_t block_above = world->blocks[check_z][y][x];
-            if (block_above != BLOCK_AIR && block_above != BLOCK_WATER) {
-                brightness *= 0.7f;
-            }
-        }
-    }
-
-    return clamp(brightness, 0.2f, 1.0f);
+    if (!world || z < 0) return 0.2f;
+
+    // Open sky above and around the world
+    uint8_t light = WORLD_LIGHT_MAX << WORLD_LIGHT_SKY_SHIFT;
+    if (world_is_valid_position(world, x, y, z)) light = world_get_light_fast(world, x, y, z);
+
+    // Each level down dims by 0.8; sky light follows the time of day in
+    // light epochs, so every hit traced or relit in one epoch is lit alike
+    static const float levels[WORLD_LIGHT_MAX + 1] = {
+        0.035f, 0.044f, 0.055f, 0.069f, 0.086f, 0.107f, 0.134f, 0.168f,
+        0.210f, 0.262f, 0.328f, 0.410f, 0.512f, 0.640f, 0.800f, 1.000f
+    };
+    float sky = world->epoch_brightness * levels[(light >> WORLD_LIGHT_SKY_SHIFT) & WORLD_LIGHT_MAX];
+    float block = levels[(light >> WORLD_LIGHT_BLOCK_SHIFT) & WORLD_LIGHT_MAX];
+
+    return clamp(max_float(sky, block), 0.2f, 1.0f);
 }
 
 // Initialize block types
 void world_init_block_types(World* world) {
-    if (!world) return;
+    if (!world || !world->block_types) return;
 
-    if (world->block_types) {
-        free(world->block_types);
-    }
-
-    world->block_types = (BlockType*)malloc(MAX_BLOCK_TYPES * sizeof(BlockType));
-    if (!world->block_types) return;
-
-    // Copy default block types
+    // Copy default block types into the table allocated with the world
     memcpy(world->block_types, default_block_types, MAX_BLOCK_TYPES * sizeof(BlockType));
     world->num_block_types = MAX_BLOCK_TYPES;
+    world_build_block_table(world);
 }
 
 // Get block type information
@@ -425,31 +1116,37 @@ BlockType world_get_block_type(World* world, uint8_t type) {
     return world->block_types[type];
 }
 
+// Replace the definition of a block type (returns 0 on failure)
+int world_set_block_type(World* world, uint8_t type, const BlockType* definition) {
+    if (!world || !world->block_types || !definition || type >= world->num_block_types) return 0;
+
+    int loss = world_block_light_loss(world, type);
+    int emission = world_block_emission(world, type);
+    world->block_types[type] = *definition;
+    world_build_block_table(world);
+
+    // Light depends on how types pass and give off light
+    if (world_block_light_loss(world, type) != loss || world_block_emission(world, type) != emission) {
+        world_rebuild_skylight(world);
+    }
+    return 1;
+}
+
 // Save world to a file
 int world_save(World* world, const char* filename) {
     if (!world || !filename) return 0;
 
+    // A paged world's chunks live in its backing store
+    if (world->pager) return world_pager_save(world, filename);
+
     FILE* file = fopen(filename, "wb");
     if (!file) return 0;
 
-    // Write dimensions
-    fwrite(&world->width, sizeof(int), 1, file);
-    fwrite(&world->height, sizeof(int), 1, file);
-    fwrite(&world->depth, sizeof(int), 1, file);
-
-    // Write blocks
-    for (int z = 0; z < world->depth; z++) {
-        for (int y = 0; y < world->height; y++) {
-            fwrite(world->blocks[z][y], sizeof(uint8_t), world->width, file);
-        }
-    }
-
-    // Write time and sky brightness
-    fwrite(&world->time_of_day, sizeof(float), 1, file);
-    fwrite(&world->sky_brightness, sizeof(float), 1, file);
+    // Chunked, compressed format (see worldfile.h)
+    int ok = worldfile_write(world, file);
 
-    fclose(file);
-    return 1;
+    if (fclose(file) != 0) ok = 0;
+    return ok;
 }
 
 // Load world from a file
@@ -459,6 +1156,19 @@ World* world_load(const char* filename) {
     FILE* file = fopen(filename, "rb");
     if (!file) return NULL;
 
+    // Chunked format, recognized by its magic
+    uint8_t magic[4];
+    size_t magic_length = fread(magic, 1, sizeof(magic), file);
+    if (worldfile_is_chunked(magic, magic_length)) {
+        World* world = worldfile_read(file);
+        fclose(file);
+        if (world) world_rebuild_derived(world);
+        return world;
+    }
+
+    // Legacy format: raw dimensions followed by uncompressed rows
+    rewind(file);
+
     // Read dimensions
     int width, height, depth;
     if (fread(&width, sizeof(int), 1, file) != 1 ||
@@ -475,16 +1185,28 @@ World* world_load(const char* filename) {
         return NULL;
     }
 
-    // Read blocks
+    // Read blocks one row at a time
+    uint8_t* row = (uint8_t*)malloc(world->width * sizeof(uint8_t));
+    if (!row) {
+        world_destroy(world);
+        fclose(file);
+        return NULL;
+    }
+
     for (int z = 0; z < world->depth; z++) {
         for (int y = 0; y < world->height; y++) {
-            if (fread(world->blocks[z][y], sizeof(uint8_t), world->width, file) != world->width) {
+            if (fread(row, sizeof(uint8_t), world->width, file) != (size_t)world->width) {
+                free(row);
                 world_destroy(world);
                 fclose(file);
                 return NULL;
             }
+            for (int x = 0; x < world->width; x++) {
+                world_set_block_fast(world, x, y, z, row[x]);
+            }
         }
     }
+    free(row);
 
     // Read time and sky brightness
     if (fread(&world->time_of_day, sizeof(float), 1, file) != 1 ||
@@ -493,8 +1215,13 @@ World* world_load(const char* filename) {
         fclose(file);
         return NULL;
     }
+    world->epoch_brightness = world->sky_brightness;
 
     fclose(file);
+
+    // Derive light and occupancy from the loaded blocks
+    world_rebuild_derived(world);
+
     return world;
 }
 
@@ -522,6 +1249,12 @@ void world_update_lighting(World* world) {
         // Dusk to night
         world->sky_brightness = (1.0f - smoothstep(0.75f, 1.0f, time)) * 0.8f + 0.2f;
     }
+
+    // Views re-shade cached hits once the change is large enough to matter
+    if (fabsf(world->sky_brightness - world->epoch_brightness) >= WORLD_LIGHT_EPOCH_STEP) {
+        world->epoch_brightness = world->sky_brightness;
+        world->light_epoch++;
+    }
 }
 
 // Set time of day
@@ -5,10 +5,13 @@
 #ifndef WORLD_H
 #define WORLD_H
 
+#include "config.h"
+#include "arena.h"
 #include <stdint.h>
 
- // Forward declaration
+ // Forward declarations
 typedef struct World World;
+typedef struct WorldPager WorldPager;
 
 // Block type definition
 typedef struct {
@@ -18,27 +21,195 @@ typedef struct {
     int solid;               // Whether the block is solid
     float light_absorption;  // How much light this block absorbs
     char* name;              // Name of the block type
+    int light_emission;      // Block light the block gives off (0-15)
 } BlockType;
 
+// Bits of a block type's entry in BlockTable.flags
+#define BLOCK_FLAG_SOLID 0x01    // Stops the player
+#define BLOCK_FLAG_OPAQUE 0x02   // Stops light (every solid block)
+
+// Block type properties laid out flat for the hot paths, one entry per type.
+// Built from the world's block types; types past num_block_types read as air.
+typedef struct {
+    char glyph[MAX_BLOCK_TYPES];
+    uint8_t color[MAX_BLOCK_TYPES];
+    uint8_t flags[MAX_BLOCK_TYPES];
+    float absorption[MAX_BLOCK_TYPES];
+    uint8_t light_loss[MAX_BLOCK_TYPES];     // Light levels lost spreading into the block, 0 = opaque
+    uint8_t light_emission[MAX_BLOCK_TYPES]; // Block light the block gives off
+} BlockTable;
+
+// Chunk layout: blocks are stored in 16x16x16 chunks, x fastest
+#define CHUNK_SHIFT 4
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define CHUNK_VOLUME (CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE)
+
+// Occupancy bricks: each chunk is split into bricks of BRICK_SIZE^3 blocks,
+// one bit per brick in a 64-bit mask (bit set = brick has non-air blocks)
+#define BRICK_SHIFT 3
+#define BRICK_SIZE (1 << BRICK_SHIFT)
+#define BRICKS_PER_AXIS (CHUNK_SIZE >> BRICK_SHIFT)
+#define BRICKS_PER_CHUNK (BRICKS_PER_AXIS * BRICKS_PER_AXIS * BRICKS_PER_AXIS)
+
+// Light levels (see worldlight.h): 0-15 per channel, packed in a byte per
+// block with sky light in the high nibble and block light in the low one
+#define WORLD_LIGHT_MAX 15
+#define WORLD_LIGHT_SKY_SHIFT 4
+#define WORLD_LIGHT_BLOCK_SHIFT 0
+
+// Largest width, height or depth of a world (light queues store 16-bit
+// coordinates)
+#define WORLD_MAX_SIZE 65535
+
+// Blocks each light queue holds; a flood that outgrows it falls back to
+// rescanning the blocks it touched
+#define WORLD_LIGHT_QUEUE_SIZE 65536
+
+// Heightfield mip levels kept for far-field rays: single columns, then
+// 2x2 and 4x4 groups of columns
+#define WORLD_LOD_LEVELS 3
+
+// Block changes remembered for views that redraw only what changed
+#define WORLD_EDIT_LOG_SIZE 16
+
+// Sky brightness change that starts a new lighting epoch
+#define WORLD_LIGHT_EPOCH_STEP (1.0f / 64.0f)
+
+// Template cell of world_stamp that leaves the world's block alone
+#define WORLD_STAMP_KEEP 0xFF
+
+// Box of blocks touched by one change (inclusive bounds)
+typedef struct {
+    int x0, y0, z0;
+    int x1, y1, z1;
+} WorldEdit;
+
+// Block waiting in a light queue
+typedef struct {
+    uint16_t x, y, z;
+    uint8_t level;           // Light it had, for removals
+} WorldLightNode;
+
+// Heightfield mip cell: the highest block over a square of columns
+typedef struct {
+    int16_t top;             // z of the highest non-air block, -1 = none
+    uint8_t type;            // Type of that block
+} WorldLodCell;
+
 // World structure
 struct World {
     int width;               // Width of the world
     int height;              // Height of the world
     int depth;               // Depth of the world
-    uint8_t*** blocks;       // 3D array of block types
+    int chunks_x;            // Chunks along x
+    int chunks_y;            // Chunks along y
+    int chunks_z;            // Chunks along z
+    int chunk_count;         // Total number of chunks
+    Arena arena;             // Backs the chunk table, storage, derived data and block types
+    uint8_t** chunks;        // Chunk table: CHUNK_VOLUME block types per chunk
+    uint8_t* block_storage;  // Contiguous storage backing the chunk table
+    uint64_t* chunk_occupancy; // Per chunk: mask of non-empty bricks
+    uint16_t* brick_counts;  // Per brick: number of non-air blocks
+    uint8_t** light;         // Light table parallel to chunks: CHUNK_VOLUME light bytes per chunk
+    uint8_t* light_storage;  // Contiguous storage backing the light table
+    WorldLightNode* light_queue; // Queues for light floods: WORLD_LIGHT_QUEUE_SIZE adds, then as many removals
+    WorldLodCell* lod[WORLD_LOD_LEVELS]; // Heightfield mips: level l has a cell per 2^l x 2^l columns
     BlockType* block_types;  // Array of block type definitions
     int num_block_types;     // Number of block types
+    BlockTable block_table;  // Flat copy of block_types for lookups per block or pixel
     float time_of_day;       // Time of day (0.0-1.0)
     float sky_brightness;    // Sky brightness (0.0-1.0)
+    WorldPager* pager;       // Paging state (NULL when every chunk is resident)
+    unsigned int generation; // Incremented by every change to blocks
+    unsigned int edit_log_start; // Changes after this generation are all in edit_log
+    WorldEdit edit_log[WORLD_EDIT_LOG_SIZE]; // Change that made generation g, at g % WORLD_EDIT_LOG_SIZE
+    unsigned int light_epoch; // Incremented when sky brightness moves by WORLD_LIGHT_EPOCH_STEP
+    float epoch_brightness;  // Sky brightness when the epoch started, which blocks are lit by
+    int edit_depth;          // Open edit transactions (see world_begin_edit)
+    WorldEdit edit_bounds;   // Blocks written by the open transaction (x0 > x1 = none)
+    uint8_t* chunk_touched;  // Per chunk: written by the open transaction
 };
 
+// Index of the chunk containing a block
+static inline int world_chunk_index(const World* world, int x, int y, int z) {
+    return ((z >> CHUNK_SHIFT) * world->chunks_y + (y >> CHUNK_SHIFT)) * world->chunks_x + (x >> CHUNK_SHIFT);
+}
+
+// Offset of a block inside its chunk
+static inline int world_chunk_offset(int x, int y, int z) {
+    return ((z & CHUNK_MASK) << (2 * CHUNK_SHIFT)) | ((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK);
+}
+
+// Index of a block's brick inside its chunk
+static inline int world_brick_index(int x, int y, int z) {
+    return (((z & CHUNK_MASK) >> BRICK_SHIFT) * BRICKS_PER_AXIS +
+        ((y & CHUNK_MASK) >> BRICK_SHIFT)) * BRICKS_PER_AXIS +
+        ((x & CHUNK_MASK) >> BRICK_SHIFT);
+}
+
+// Unchecked block access for hot paths; the position must be valid
+static inline uint8_t world_get_block_fast(const World* world, int x, int y, int z) {
+    return world->chunks[world_chunk_index(world, x, y, z)][world_chunk_offset(x, y, z)];
+}
+
+static inline void world_set_block_fast(World* world, int x, int y, int z, uint8_t type) {
+    world->chunks[world_chunk_index(world, x, y, z)][world_chunk_offset(x, y, z)] = type;
+}
+
+// Unchecked light byte of a block; the position must be valid
+static inline uint8_t world_get_light_fast(const World* world, int x, int y, int z) {
+    return world->light[world_chunk_index(world, x, y, z)][world_chunk_offset(x, y, z)];
+}
+
+// Cells along x and y of a heightfield mip level
+static inline int world_lod_width(const World* world, int level) {
+    return (world->width + (1 << level) - 1) >> level;
+}
+
+static inline int world_lod_height(const World* world, int level) {
+    return (world->height + (1 << level) - 1) >> level;
+}
+
+// Table slot of a block type; out-of-range types read as air
+static inline int world_block_slot(uint8_t type) {
+    return type < MAX_BLOCK_TYPES ? type : BLOCK_AIR;
+}
+
+// Block type properties for hot paths
+static inline char world_block_glyph(const World* world, uint8_t type) {
+    return world->block_table.glyph[world_block_slot(type)];
+}
+
+static inline int world_block_color(const World* world, uint8_t type) {
+    return world->block_table.color[world_block_slot(type)];
+}
+
+static inline int world_block_flags(const World* world, uint8_t type) {
+    return world->block_table.flags[world_block_slot(type)];
+}
+
+static inline float world_block_absorption(const World* world, uint8_t type) {
+    return world->block_table.absorption[world_block_slot(type)];
+}
+
+static inline int world_block_light_loss(const World* world, uint8_t type) {
+    return world->block_table.light_loss[world_block_slot(type)];
+}
+
+static inline int world_block_emission(const World* world, uint8_t type) {
+    return world->block_table.light_emission[world_block_slot(type)];
+}
+
 // World creation and destruction
 World* world_create(int width, int height, int depth);
+World* world_create_sparse(int width, int height, int depth);
 void world_destroy(World* world);
 
 // World generation
 void world_generate_terrain(World* world, unsigned int seed);
 void world_generate_structures(World* world, unsigned int seed);
+int world_generate_chunk_column(const World* world, unsigned int seed, int cx, int cy, uint8_t* storage);
 
 // Block operations
 uint8_t world_get_block(World* world, int x, int y, int z);
@@ -47,16 +218,51 @@ int world_is_solid(World* world, int x, int y, int z);
 int world_is_valid_position(World* world, int x, int y, int z);
 float world_get_brightness(World* world, int x, int y, int z);
 
+// Batched edits. Writes between world_begin_edit and the matching
+// world_commit_edit (world_set_block and the fills below) only store
+// blocks; the commit rebuilds occupancy once per chunk they touched, then
+// surfaces, mips and light over their bounds, and logs them as one change.
+// Transactions nest; the outermost commit applies them.
+void world_begin_edit(World* world);
+void world_commit_edit(World* world);
+
+// Fill a box (inclusive bounds, clipped to the world) or the blocks whose
+// centres lie in a ball with one type
+void world_fill_box(World* world, int x0, int y0, int z0, int x1, int y1, int z1, uint8_t type);
+void world_fill_sphere(World* world, float x, float y, float z, float radius, uint8_t type);
+
+// Stamp a width x height x depth template of types (x fastest, then y, then
+// z) with its low corner at a position; WORLD_STAMP_KEEP cells are skipped
+void world_stamp(World* world, int x, int y, int z, int width, int height, int depth, const uint8_t* blocks);
+
 // Block type operations
 void world_init_block_types(World* world);
 BlockType world_get_block_type(World* world, uint8_t type);
+int world_set_block_type(World* world, uint8_t type, const BlockType* definition);
 
 // World file operations
 int world_save(World* world, const char* filename);
 World* world_load(const char* filename);
 
-// World lighting
+// World lighting. world_get_brightness is the light of the open block at a
+// position, with sky light scaled by the sky brightness the current light
+// epoch started at; light a face receives is the light of the block in
+// front of it.
 void world_update_lighting(World* world);
+void world_rebuild_skylight(World* world);
 void world_set_time(World* world, float time);
 
+// Derived data (light, occupancy, heightfield mips) after bulk writes through world_set_block_fast
+void world_rebuild_occupancy(World* world);
+void world_rebuild_derived(World* world);
+void world_refresh_derived_box(World* world, int x0, int y0, int z0, int x1, int y1, int z1);
+
+// Box changed by generation g, or NULL when the edit log no longer covers it
+const WorldEdit* world_get_edit(const World* world, unsigned int generation);
+
+// Paged worlds: swap the storage of a chunk column in or out (NULL = absent,
+// reads as air). The storage holds the column's chunks_z chunks of blocks
+// followed by as many chunks of light.
+void world_attach_chunk_column(World* world, int cx, int cy, uint8_t* storage);
+
 #endif /* WORLD_H */
@@ -0,0 +1,550 @@
+/**
+ * @file worldfile.c
+ * @brief Chunked, compressed world file format
+ */
+#include "worldfile.h"
+#include "config.h"
+#include "thread.h"
+#include "threadpool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Header layout:
+ *    0  char[4]  magic "VXWF"
+ *    4  u16      version
+ *    6  u16      header size
+ *    8  u32      byte order mark 0x01020304 (reads back swapped on a bad port)
+ *   12  u32      width, height, depth
+ *   24  u8       chunk shift, 3 bytes reserved
+ *   28  u32      chunk count
+ *   32  u32      time of day, sky brightness (IEEE-754 bits)
+ */
+#define WORLDFILE_BYTE_ORDER 0x01020304u
+#define WORLDFILE_TABLE_ENTRY 8
+
+// Chunk encodings (first byte of every chunk)
+enum {
+    CHUNK_CODEC_UNIFORM,   // [value]
+    CHUNK_CODEC_PALETTE,   // [count - 1][palette...][packed 1/2/4-bit indices, low bits first]
+    CHUNK_CODEC_RUNS,      // [count - 1][palette...][runs...], see chunk_encode_runs
+    CHUNK_CODEC_RAW        // [CHUNK_VOLUME bytes]
+};
+
+// Raw is the fallback, so no encoded chunk is ever larger than this
+#define CHUNK_MAX_ENCODED (1 + CHUNK_VOLUME)
+
+// Palettes larger than this are stored raw
+#define CHUNK_MAX_PALETTE 16
+
+// Little-endian field access
+static void put_u16(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u16(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t float_bits(float f) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// Bits per packed palette index
+static int palette_bits(int palette_count) {
+    return palette_count <= 2 ? 1 : palette_count <= 4 ? 2 : 4;
+}
+
+// Run tokens: one byte holds a palette index (low nibble) and a run length
+// of 1-15 (high nibble). A zero length nibble means the run is 16 or more,
+// stored as a little-endian base-128 count of (run - 16) in the next bytes.
+// Returns the encoded size, or 0 if it would not fit in limit bytes.
+static int chunk_encode_runs(const uint8_t* blocks, const int* palette_index, uint8_t* out, int limit) {
+    uint8_t* p = out;
+    uint8_t* end = out + limit;
+    int i = 0;
+
+    while (i < CHUNK_VOLUME) {
+        int start = i;
+        uint8_t value = blocks[i];
+        while (i < CHUNK_VOLUME && blocks[i] == value) i++;
+
+        int run = i - start;
+        int index = palette_index[value];
+        if (end - p < 3) return 0;
+
+        if (run < 16) {
+            *p++ = (uint8_t)(index | (run << 4));
+        }
+        else {
+            int extra = run - 16;
+            *p++ = (uint8_t)index;
+            while (extra >= 0x80) {
+                *p++ = (uint8_t)(0x80 | (extra & 0x7F));
+                extra >>= 7;
+            }
+            *p++ = (uint8_t)extra;
+        }
+    }
+
+    return (int)(p - out);
+}
+
+// Encode one chunk into out (CHUNK_MAX_ENCODED bytes), returning its size
+static int chunk_encode(const uint8_t* blocks, uint8_t* out) {
+    int palette_index[256];
+    uint8_t palette[256];
+    int palette_count = 0;
+
+    memset(palette_index, 0xFF, sizeof(palette_index));  // -1 = not in the palette
+    for (int i = 0; i < CHUNK_VOLUME; i++) {
+        uint8_t value = blocks[i];
+        if (palette_index[value] < 0) {
+            palette_index[value] = palette_count;
+            palette[palette_count++] = value;
+        }
+    }
+
+    if (palette_count == 1) {
+        out[0] = CHUNK_CODEC_UNIFORM;
+        out[1] = blocks[0];
+        return 2;
+    }
+
+    if (palette_count > CHUNK_MAX_PALETTE) {
+        out[0] = CHUNK_CODEC_RAW;
+        memcpy(out + 1, blocks, CHUNK_VOLUME);
+        return CHUNK_MAX_ENCODED;
+    }
+
+    // Both palette codecs share the palette prefix
+    int prefix = 2 + palette_count;
+    int bits = palette_bits(palette_count);
+    int packed_size = prefix + CHUNK_VOLUME * bits / 8;
+    out[1] = (uint8_t)(palette_count - 1);
+    memcpy(out + 2, palette, palette_count);
+
+    // Runs win on terrain, where layers are mostly one block type
+    int runs_size = chunk_encode_runs(blocks, palette_index, out + prefix, packed_size - prefix);
+    if (runs_size > 0) {
+        out[0] = CHUNK_CODEC_RUNS;
+        return prefix + runs_size;
+    }
+
+    // Bit-packed indices for noisy chunks
+    out[0] = CHUNK_CODEC_PALETTE;
+    uint8_t* packed = out + prefix;
+    int per_byte = 8 / bits;
+    for (int i = 0; i < CHUNK_VOLUME; i += per_byte) {
+        uint8_t byte = 0;
+        for (int j = 0; j < per_byte; j++) {
+            byte |= (uint8_t)(palette_index[blocks[i + j]] << (j * bits));
+        }
+        *packed++ = byte;
+    }
+    return packed_size;
+}
+
+// Decode one chunk, returning 0 if the data is malformed
+static int chunk_decode(const uint8_t* data, uint32_t size, uint8_t* blocks) {
+    if (size < 2) return 0;
+
+    if (data[0] == CHUNK_CODEC_UNIFORM) {
+        memset(blocks, data[1], CHUNK_VOLUME);
+        return size == 2;
+    }
+
+    if (data[0] == CHUNK_CODEC_RAW) {
+        if (size != CHUNK_MAX_ENCODED) return 0;
+        memcpy(blocks, data + 1, CHUNK_VOLUME);
+        return 1;
+    }
+
+    // Palette codecs
+    int palette_count = data[1] + 1;
+    if (palette_count > CHUNK_MAX_PALETTE || size < (uint32_t)(2 + palette_count)) return 0;
+    const uint8_t* palette = data + 2;
+    const uint8_t* p = palette + palette_count;
+    const uint8_t* end = data + size;
+
+    if (data[0] == CHUNK_CODEC_PALETTE) {
+        int bits = palette_bits(palette_count);
+        int per_byte = 8 / bits;
+        int mask = (1 << bits) - 1;
+        if (end - p != CHUNK_VOLUME * bits / 8) return 0;
+
+        for (int i = 0; i < CHUNK_VOLUME; i += per_byte) {
+            uint8_t byte = *p++;
+            for (int j = 0; j < per_byte; j++) {
+                int index = (byte >> (j * bits)) & mask;
+                if (index >= palette_count) return 0;
+                blocks[i + j] = palette[index];
+            }
+        }
+        return 1;
+    }
+
+    if (data[0] == CHUNK_CODEC_RUNS) {
+        int filled = 0;
+        while (p < end) {
+            int index = *p & 0x0F;
+            int run = *p++ >> 4;
+
+            if (run == 0) {
+                int shift = 0;
+                int extra = 0;
+                do {
+                    if (p >= end || shift > 14) return 0;
+                    extra |= (*p & 0x7F) << shift;
+                    shift += 7;
+                } while (*p++ & 0x80);
+                run = 16 + extra;
+            }
+
+            if (index >= palette_count || run > CHUNK_VOLUME - filled) return 0;
+            memset(blocks + filled, palette[index], run);
+            filled += run;
+        }
+        return filled == CHUNK_VOLUME;
+    }
+
+    return 0;
+}
+
+// Worker pool for encoding and decoding
+static ThreadPool* worldfile_create_pool(void) {
+    int thread_count = WORLD_GEN_THREADS > 0 ? WORLD_GEN_THREADS : thread_cpu_count();
+    return threadpool_create(thread_count);
+}
+
+// Shared state for the parallel chunk passes
+typedef struct {
+    World* world;
+    uint8_t* slots;          // Encode: CHUNK_MAX_ENCODED bytes per chunk
+    int* sizes;              // Encode: encoded size per chunk
+    const uint8_t* data;     // Decode: whole file
+    size_t data_size;
+    const uint8_t* table;    // Decode: chunk table
+    uint8_t* status;         // Decode: 1 per chunk that decoded cleanly
+} ChunkJob;
+
+static void worldfile_encode_task(void* context, int task_index, int thread_index) {
+    ChunkJob* job = (ChunkJob*)context;
+    (void)thread_index;
+
+    job->sizes[task_index] = chunk_encode(job->world->chunks[task_index],
+        job->slots + (size_t)task_index * CHUNK_MAX_ENCODED);
+}
+
+static void worldfile_decode_task(void* context, int task_index, int thread_index) {
+    ChunkJob* job = (ChunkJob*)context;
+    (void)thread_index;
+
+    const uint8_t* entry = job->table + (size_t)task_index * WORLDFILE_TABLE_ENTRY;
+    uint32_t offset = get_u32(entry);
+    uint32_t size = get_u32(entry + 4);
+
+    // Chunks a paged world never stored stay air
+    job->status[task_index] = size == 0;
+    if (size == 0 || offset > job->data_size || size > job->data_size - offset) return;
+    job->status[task_index] = (uint8_t)chunk_decode(job->data + offset, size, job->world->chunks[task_index]);
+}
+
+// Check the magic
+int worldfile_is_chunked(const uint8_t* head, size_t length) {
+    return head && length >= 4 && memcmp(head, WORLDFILE_MAGIC, 4) == 0;
+}
+
+// Fill in a header for a world
+static void worldfile_put_header(uint8_t* header, const World* world) {
+    memset(header, 0, WORLDFILE_HEADER_SIZE);
+    memcpy(header, WORLDFILE_MAGIC, 4);
+    put_u16(header + 4, WORLDFILE_VERSION);
+    put_u16(header + 6, WORLDFILE_HEADER_SIZE);
+    put_u32(header + 8, WORLDFILE_BYTE_ORDER);
+    put_u32(header + 12, (uint32_t)world->width);
+    put_u32(header + 16, (uint32_t)world->height);
+    put_u32(header + 20, (uint32_t)world->depth);
+    header[24] = CHUNK_SHIFT;
+    put_u32(header + 28, (uint32_t)world->chunk_count);
+    put_u32(header + 32, float_bits(world->time_of_day));
+    put_u32(header + 36, float_bits(world->sky_brightness));
+}
+
+// Validate a header; length is the file size, which must hold the chunk table
+static int worldfile_parse_header(const uint8_t* header, size_t length,
+                                  int* width, int* height, int* depth, uint32_t* count) {
+    if (length < WORLDFILE_HEADER_SIZE || !worldfile_is_chunked(header, length) ||
+        get_u16(header + 4) != WORLDFILE_VERSION ||
+        get_u16(header + 6) != WORLDFILE_HEADER_SIZE ||
+        get_u32(header + 8) != WORLDFILE_BYTE_ORDER ||
+        header[24] != CHUNK_SHIFT) {
+        return 0;
+    }
+
+    *width = (int)get_u32(header + 12);
+    *height = (int)get_u32(header + 16);
+    *depth = (int)get_u32(header + 20);
+    *count = get_u32(header + 28);
+    return *width > 0 && *height > 0 && *depth > 0 &&
+        *count <= (uint32_t)((length - WORLDFILE_HEADER_SIZE) / WORLDFILE_TABLE_ENTRY);
+}
+
+// Write a world in the chunked format
+int worldfile_write(World* world, FILE* file) {
+    if (!world || !file) return 0;
+
+    int count = world->chunk_count;
+    ChunkJob job = { 0 };
+    job.world = world;
+    job.slots = (uint8_t*)malloc((size_t)count * CHUNK_MAX_ENCODED);
+    job.sizes = (int*)malloc(count * sizeof(int));
+    uint8_t* table = (uint8_t*)malloc((size_t)count * WORLDFILE_TABLE_ENTRY);
+    if (!job.slots || !job.sizes || !table) {
+        free(table);
+        free(job.sizes);
+        free(job.slots);
+        return 0;
+    }
+
+    // Compress every chunk
+    ThreadPool* pool = worldfile_create_pool();
+    threadpool_run(pool, worldfile_encode_task, &job, count);
+    threadpool_destroy(pool);
+
+    // Header
+    uint8_t header[WORLDFILE_HEADER_SIZE];
+    worldfile_put_header(header, world);
+
+    // Chunk table: payloads follow the table in chunk order
+    uint32_t offset = WORLDFILE_HEADER_SIZE + (uint32_t)count * WORLDFILE_TABLE_ENTRY;
+    for (int i = 0; i < count; i++) {
+        put_u32(table + (size_t)i * WORLDFILE_TABLE_ENTRY, offset);
+        put_u32(table + (size_t)i * WORLDFILE_TABLE_ENTRY + 4, (uint32_t)job.sizes[i]);
+        offset += (uint32_t)job.sizes[i];
+    }
+
+    int ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+        fwrite(table, 1, (size_t)count * WORLDFILE_TABLE_ENTRY, file) == (size_t)count * WORLDFILE_TABLE_ENTRY;
+    for (int i = 0; ok && i < count; i++) {
+        ok = fwrite(job.slots + (size_t)i * CHUNK_MAX_ENCODED, 1, job.sizes[i], file) == (size_t)job.sizes[i];
+    }
+
+    free(table);
+    free(job.sizes);
+    free(job.slots);
+    return ok;
+}
+
+// Read a chunked world file
+World* worldfile_read(FILE* file) {
+    if (!file) return NULL;
+
+    // One read for the whole file; decoding then never touches the file again
+    if (fseek(file, 0, SEEK_END) != 0) return NULL;
+    long length = ftell(file);
+    if (length < WORLDFILE_HEADER_SIZE || fseek(file, 0, SEEK_SET) != 0) return NULL;
+
+    uint8_t* data = (uint8_t*)malloc((size_t)length);
+    if (!data) return NULL;
+    if (fread(data, 1, (size_t)length, file) != (size_t)length) {
+        free(data);
+        return NULL;
+    }
+
+    // Validate the header
+    int width, height, depth;
+    uint32_t count;
+    if (!worldfile_parse_header(data, (size_t)length, &width, &height, &depth, &count)) {
+        free(data);
+        return NULL;
+    }
+
+    World* world = world_create(width, height, depth);
+    if (!world || (uint32_t)world->chunk_count != count) {
+        world_destroy(world);
+        free(data);
+        return NULL;
+    }
+    world->time_of_day = bits_float(get_u32(data + 32));
+    world->sky_brightness = bits_float(get_u32(data + 36));
+    world->epoch_brightness = world->sky_brightness;
+
+    // Decompress chunks in parallel, straight into chunk storage
+    ChunkJob job = { 0 };
+    job.world = world;
+    job.data = data;
+    job.data_size = (size_t)length;
+    job.table = data + WORLDFILE_HEADER_SIZE;
+    job.status = (uint8_t*)malloc(count);
+    if (!job.status) {
+        world_destroy(world);
+        free(data);
+        return NULL;
+    }
+
+    ThreadPool* pool = worldfile_create_pool();
+    threadpool_run(pool, worldfile_decode_task, &job, (int)count);
+    threadpool_destroy(pool);
+
+    int ok = 1;
+    for (uint32_t i = 0; i < count; i++) {
+        ok &= job.status[i];
+    }
+
+    free(job.status);
+    free(data);
+    if (!ok) {
+        world_destroy(world);
+        return NULL;
+    }
+
+    return world;
+}
+
+// Open the page store of an existing chunked file
+int worldfile_store_open(WorldFileStore* store, FILE* file, int* width, int* height, int* depth) {
+    if (!store || !file) return 0;
+
+    uint8_t header[WORLDFILE_HEADER_SIZE];
+    if (fseek(file, 0, SEEK_END) != 0) return 0;
+    long length = ftell(file);
+    if (length < WORLDFILE_HEADER_SIZE || fseek(file, 0, SEEK_SET) != 0 ||
+        fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        return 0;
+    }
+
+    uint32_t count;
+    if (!worldfile_parse_header(header, (size_t)length, width, height, depth, &count)) return 0;
+
+    size_t table_size = (size_t)count * WORLDFILE_TABLE_ENTRY;
+    uint8_t* table = (uint8_t*)malloc(table_size > 0 ? table_size : 1);
+    store->offsets = (uint32_t*)malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+    store->sizes = (uint32_t*)malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+    if (!table || !store->offsets || !store->sizes ||
+        fread(table, 1, table_size, file) != table_size) {
+        free(table);
+        worldfile_store_close(store);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        store->offsets[i] = get_u32(table + (size_t)i * WORLDFILE_TABLE_ENTRY);
+        store->sizes[i] = get_u32(table + (size_t)i * WORLDFILE_TABLE_ENTRY + 4);
+    }
+    free(table);
+
+    store->file = file;
+    store->chunk_count = (int)count;
+    store->end = (uint32_t)length;
+    return 1;
+}
+
+// Start an empty page store: header and a table of absent chunks
+int worldfile_store_create(WorldFileStore* store, FILE* file, const World* world) {
+    if (!store || !file || !world) return 0;
+
+    int count = world->chunk_count;
+    size_t table_size = (size_t)count * WORLDFILE_TABLE_ENTRY;
+    uint8_t header[WORLDFILE_HEADER_SIZE];
+    uint8_t* table = (uint8_t*)calloc(table_size > 0 ? table_size : 1, 1);
+    store->offsets = (uint32_t*)calloc(count > 0 ? count : 1, sizeof(uint32_t));
+    store->sizes = (uint32_t*)calloc(count > 0 ? count : 1, sizeof(uint32_t));
+    if (!table || !store->offsets || !store->sizes) {
+        free(table);
+        worldfile_store_close(store);
+        return 0;
+    }
+
+    worldfile_put_header(header, world);
+    int ok = fseek(file, 0, SEEK_SET) == 0 &&
+        fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+        fwrite(table, 1, table_size, file) == table_size &&
+        fflush(file) == 0;
+    free(table);
+    if (!ok) {
+        worldfile_store_close(store);
+        return 0;
+    }
+
+    store->file = file;
+    store->chunk_count = count;
+    store->end = (uint32_t)(WORLDFILE_HEADER_SIZE + table_size);
+    return 1;
+}
+
+// Free the in-memory chunk table (the file stays open)
+void worldfile_store_close(WorldFileStore* store) {
+    if (!store) return;
+
+    free(store->offsets);
+    free(store->sizes);
+    store->offsets = NULL;
+    store->sizes = NULL;
+    store->chunk_count = 0;
+}
+
+// Whether a chunk has ever been written
+int worldfile_store_has_chunk(const WorldFileStore* store, int index) {
+    return store && index >= 0 && index < store->chunk_count && store->sizes[index] > 0;
+}
+
+// Read and decode one stored chunk
+int worldfile_store_read_chunk(WorldFileStore* store, int index, uint8_t* blocks) {
+    if (!worldfile_store_has_chunk(store, index) || !blocks) return 0;
+
+    uint8_t data[CHUNK_MAX_ENCODED];
+    uint32_t size = store->sizes[index];
+    if (size > sizeof(data) ||
+        fseek(store->file, (long)store->offsets[index], SEEK_SET) != 0 ||
+        fread(data, 1, size, store->file) != size) {
+        return 0;
+    }
+
+    return chunk_decode(data, size, blocks);
+}
+
+// Append a new version of a chunk and point its table entry at it. The old
+// payload is left behind, so the file stays valid after every write.
+int worldfile_store_write_chunk(WorldFileStore* store, int index, const uint8_t* blocks) {
+    if (!store || !store->file || !blocks || index < 0 || index >= store->chunk_count) return 0;
+
+    uint8_t data[CHUNK_MAX_ENCODED];
+    uint8_t entry[WORLDFILE_TABLE_ENTRY];
+    int size = chunk_encode(blocks, data);
+    if (store->end > UINT32_MAX - (uint32_t)size) return 0;
+
+    put_u32(entry, store->end);
+    put_u32(entry + 4, (uint32_t)size);
+    if (fseek(store->file, (long)store->end, SEEK_SET) != 0 ||
+        fwrite(data, 1, size, store->file) != (size_t)size ||
+        fseek(store->file, (long)(WORLDFILE_HEADER_SIZE + (size_t)index * WORLDFILE_TABLE_ENTRY), SEEK_SET) != 0 ||
+        fwrite(entry, 1, sizeof(entry), store->file) != sizeof(entry)) {
+        return 0;
+    }
+
+    store->offsets[index] = store->end;
+    store->sizes[index] = (uint32_t)size;
+    store->end += (uint32_t)size;
+    return 1;
+}
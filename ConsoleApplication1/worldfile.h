@@ -0,0 +1,53 @@
+/**
+ * @file worldfile.h
+ * @brief Chunked, compressed world file format
+ *
+ * Layout (all fields little-endian):
+ *   header       WORLDFILE_HEADER_SIZE bytes, see worldfile.c
+ *   chunk table  chunk_count entries of { u32 offset, u32 size }
+ *   chunk data   one encoded chunk per table entry, CHUNK_VOLUME blocks each
+ *
+ * Each chunk is stored with whichever encoding is smallest: a single
+ * block type, runs of palette indices, a 1/2/4-bit packed palette, or
+ * raw bytes. A zero-size table entry marks a chunk that was never stored:
+ * paged worlds generate it on demand, a full load reads it as air.
+ */
+#ifndef WORLDFILE_H
+#define WORLDFILE_H
+
+#include "world.h"
+#include <stdio.h>
+
+#define WORLDFILE_MAGIC "VXWF"
+#define WORLDFILE_VERSION 1
+#define WORLDFILE_HEADER_SIZE 40
+
+// Whether the first bytes of a file carry the chunked-format magic
+int worldfile_is_chunked(const uint8_t* head, size_t length);
+
+// Write a world in the chunked format (returns 0 on failure)
+int worldfile_write(World* world, FILE* file);
+
+// Read a chunked world file (NULL on failure). The whole file is read
+// in one call and chunks decode in parallel.
+World* worldfile_read(FILE* file);
+
+// Random access to the chunks of a file, used as the backing store of a
+// paged world. Rewritten chunks are appended and the table entry updated in
+// place. Not thread-safe; callers serialize access.
+typedef struct {
+    FILE* file;
+    int chunk_count;
+    uint32_t* offsets;       // Per chunk: payload offset
+    uint32_t* sizes;         // Per chunk: payload size (0 = never stored)
+    uint32_t end;            // Where the next payload is appended
+} WorldFileStore;
+
+int worldfile_store_open(WorldFileStore* store, FILE* file, int* width, int* height, int* depth);
+int worldfile_store_create(WorldFileStore* store, FILE* file, const World* world);
+void worldfile_store_close(WorldFileStore* store);
+int worldfile_store_has_chunk(const WorldFileStore* store, int index);
+int worldfile_store_read_chunk(WorldFileStore* store, int index, uint8_t* blocks);
+int worldfile_store_write_chunk(WorldFileStore* store, int index, const uint8_t* blocks);
+
+#endif /* WORLDFILE_H */
@@ -0,0 +1,341 @@
+/**
+ * @file worldlight.c
+ * @brief Flood fill of sky and block light, and incremental relighting
+ */
+#include "worldlight.h"
+#include "utils.h"
+
+uint8_t world_absent_light[CHUNK_VOLUME];
+
+// Neighbours in the order they are visited; the last one is straight down
+static const int light_dirs[6][3] = {
+    { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+};
+#define LIGHT_DIR_DOWN 5
+
+// Ring buffer of blocks for one flood; pushes past capacity are dropped
+// and counted as an overflow
+typedef struct {
+    WorldLightNode* nodes;
+    int head;
+    int count;
+    int overflow;
+} LightQueue;
+
+// State of one relighting: the channel, its queues and the box of blocks
+// whose light it changed
+typedef struct {
+    World* world;
+    int shift;               // WORLD_LIGHT_SKY_SHIFT or WORLD_LIGHT_BLOCK_SHIFT
+    LightQueue add;
+    LightQueue remove;
+    int changed;             // Whether any light changed
+    WorldEdit box;           // Blocks whose light changed
+} LightPass;
+
+static void light_pass_init(LightPass* pass, World* world, int shift) {
+    pass->world = world;
+    pass->shift = shift;
+    pass->add.nodes = world->light_queue;
+    pass->remove.nodes = world->light_queue + WORLD_LIGHT_QUEUE_SIZE;
+    pass->add.head = pass->add.count = pass->add.overflow = 0;
+    pass->remove.head = pass->remove.count = pass->remove.overflow = 0;
+    pass->changed = 0;
+}
+
+static void light_push(LightQueue* queue, int x, int y, int z, int level) {
+    if (queue->count == WORLD_LIGHT_QUEUE_SIZE) {
+        queue->overflow = 1;
+        return;
+    }
+
+    WorldLightNode* node = &queue->nodes[(queue->head + queue->count++) & (WORLD_LIGHT_QUEUE_SIZE - 1)];
+    node->x = (uint16_t)x;
+    node->y = (uint16_t)y;
+    node->z = (uint16_t)z;
+    node->level = (uint8_t)level;
+}
+
+static WorldLightNode light_pop(LightQueue* queue) {
+    WorldLightNode node = queue->nodes[queue->head];
+    queue->head = (queue->head + 1) & (WORLD_LIGHT_QUEUE_SIZE - 1);
+    queue->count--;
+    return node;
+}
+
+// Light byte of a block, or NULL when its chunk is absent
+static inline uint8_t* light_cell(const World* world, int x, int y, int z) {
+    uint8_t* light = world->light[world_chunk_index(world, x, y, z)];
+    return light != world_absent_light ? light + world_chunk_offset(x, y, z) : NULL;
+}
+
+static inline int light_get(const LightPass* pass, const uint8_t* cell) {
+    return (*cell >> pass->shift) & WORLD_LIGHT_MAX;
+}
+
+static inline void light_set(LightPass* pass, uint8_t* cell, int x, int y, int z, int level) {
+    *cell = (uint8_t)((*cell & ~(WORLD_LIGHT_MAX << pass->shift)) | (level << pass->shift));
+
+    if (!pass->changed) {
+        pass->changed = 1;
+        pass->box.x0 = pass->box.x1 = x;
+        pass->box.y0 = pass->box.y1 = y;
+        pass->box.z0 = pass->box.z1 = z;
+        return;
+    }
+    pass->box.x0 = min_int(pass->box.x0, x);
+    pass->box.y0 = min_int(pass->box.y0, y);
+    pass->box.z0 = min_int(pass->box.z0, z);
+    pass->box.x1 = max_int(pass->box.x1, x);
+    pass->box.y1 = max_int(pass->box.y1, y);
+    pass->box.z1 = max_int(pass->box.z1, z);
+}
+
+// Light a block of the given type gets from a neighbour with this level.
+// Full sky light falls straight down through clear blocks undimmed.
+static inline int light_transfer(const LightPass* pass, int level, uint8_t type, int down) {
+    int loss = world_block_light_loss(pass->world, type);
+    if (!loss) return 0;
+    if (down && level == WORLD_LIGHT_MAX && loss == 1 && pass->shift == WORLD_LIGHT_SKY_SHIFT) return level;
+    return level - loss;
+}
+
+// Light a block gives itself: its emission, or the sky above the world
+static int light_source(const LightPass* pass, int z, uint8_t type) {
+    if (pass->shift == WORLD_LIGHT_BLOCK_SHIFT) return world_block_emission(pass->world, type);
+    if (z != pass->world->depth - 1) return 0;
+    return max_int(light_transfer(pass, WORLD_LIGHT_MAX, type, 1), 0);
+}
+
+// Neighbour of a block in a direction; 0 when it is outside the world or absent
+static inline uint8_t* light_neighbour(const World* world, const WorldLightNode* node, int dir,
+                                       int* x, int* y, int* z) {
+    *x = node->x + light_dirs[dir][0];
+    *y = node->y + light_dirs[dir][1];
+    *z = node->z + light_dirs[dir][2];
+    if (*x < 0 || *y < 0 || *z < 0 || *x >= world->width || *y >= world->height || *z >= world->depth) {
+        return NULL;
+    }
+    return light_cell(world, *x, *y, *z);
+}
+
+// Spread light from the blocks in the add queue until nothing brightens
+static void light_spread(LightPass* pass) {
+    World* world = pass->world;
+
+    while (pass->add.count > 0) {
+        WorldLightNode node = light_pop(&pass->add);
+        int level = light_get(pass, light_cell(world, node.x, node.y, node.z));
+        if (level <= 1) continue;
+
+        for (int dir = 0; dir < 6; dir++) {
+            int x, y, z;
+            uint8_t* cell = light_neighbour(world, &node, dir, &x, &y, &z);
+            if (!cell) continue;
+
+            int lit = light_transfer(pass, level, world_get_block_fast(world, x, y, z), dir == LIGHT_DIR_DOWN);
+            if (lit > light_get(pass, cell)) {
+                light_set(pass, cell, x, y, z, lit);
+                light_push(&pass->add, x, y, z, lit);
+            }
+        }
+    }
+}
+
+// Take away the light that came from the blocks in the remove queue. Blocks
+// still lit from elsewhere, and sources, go on the add queue to fill the
+// dark back in. Returns 0 when the queue overflowed.
+static int light_unspread(LightPass* pass) {
+    World* world = pass->world;
+
+    while (pass->remove.count > 0) {
+        WorldLightNode node = light_pop(&pass->remove);
+
+        for (int dir = 0; dir < 6; dir++) {
+            int x, y, z;
+            uint8_t* cell = light_neighbour(world, &node, dir, &x, &y, &z);
+            if (!cell) continue;
+
+            int level = light_get(pass, cell);
+            if (!level) continue;
+
+            uint8_t type = world_get_block_fast(world, x, y, z);
+            if (level > light_transfer(pass, node.level, type, dir == LIGHT_DIR_DOWN)) {
+                // Lit by something else: spread that back over the removal
+                light_push(&pass->add, x, y, z, level);
+                continue;
+            }
+
+            light_set(pass, cell, x, y, z, 0);
+            light_push(&pass->remove, x, y, z, level);
+
+            int source = light_source(pass, z, type);
+            if (source) {
+                light_set(pass, cell, x, y, z, source);
+                light_push(&pass->add, x, y, z, source);
+            }
+        }
+    }
+
+    return !pass->remove.overflow;
+}
+
+// Whether a lit block would brighten one of its neighbours
+static int light_is_frontier(const LightPass* pass, int x, int y, int z, int level) {
+    World* world = pass->world;
+    WorldLightNode node = { (uint16_t)x, (uint16_t)y, (uint16_t)z, (uint8_t)level };
+
+    for (int dir = 0; dir < 6; dir++) {
+        int nx, ny, nz;
+        uint8_t* cell = light_neighbour(world, &node, dir, &nx, &ny, &nz);
+        if (cell && light_transfer(pass, level, world_get_block_fast(world, nx, ny, nz), dir == LIGHT_DIR_DOWN) >
+            light_get(pass, cell)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Grow a box to cover another
+static void light_box_union(WorldEdit* box, const WorldEdit* other) {
+    box->x0 = min_int(box->x0, other->x0);
+    box->y0 = min_int(box->y0, other->y0);
+    box->z0 = min_int(box->z0, other->z0);
+    box->x1 = max_int(box->x1, other->x1);
+    box->y1 = max_int(box->y1, other->y1);
+    box->z1 = max_int(box->z1, other->z1);
+}
+
+// Spread light until settled, rescanning for light that was dropped when
+// the add queue overflowed. A dropped block was lit by the pass, in the box,
+// or next to one of those, so every rescan finds it again.
+static void light_settle(LightPass* pass, const WorldEdit* box) {
+    World* world = pass->world;
+
+    light_spread(pass);
+    while (pass->add.overflow) {
+        pass->add.overflow = 0;
+
+        WorldEdit scan = *box;
+        if (pass->changed) light_box_union(&scan, &pass->box);
+        scan.x0 = max_int(scan.x0 - 1, 0);
+        scan.y0 = max_int(scan.y0 - 1, 0);
+        scan.z0 = max_int(scan.z0 - 1, 0);
+        scan.x1 = min_int(scan.x1 + 1, world->width - 1);
+        scan.y1 = min_int(scan.y1 + 1, world->height - 1);
+        scan.z1 = min_int(scan.z1 + 1, world->depth - 1);
+
+        for (int z = scan.z0; z <= scan.z1; z++) {
+            for (int y = scan.y0; y <= scan.y1; y++) {
+                for (int x = scan.x0; x <= scan.x1; x++) {
+                    const uint8_t* cell = light_cell(world, x, y, z);
+                    if (!cell) continue;
+
+                    int level = light_get(pass, cell);
+                    if (level > 1 && light_is_frontier(pass, x, y, z, level)) {
+                        light_push(&pass->add, x, y, z, level);
+                    }
+                }
+            }
+        }
+        light_spread(pass);
+    }
+}
+
+// Relight one channel of the columns of a box from scratch: clear it, fill
+// in the sources, then spread from them and from the blocks around the box
+static void light_relight_columns(LightPass* pass, const WorldEdit* box) {
+    World* world = pass->world;
+
+    for (int y = box->y0; y <= box->y1; y++) {
+        for (int x = box->x0; x <= box->x1; x++) {
+            int level = WORLD_LIGHT_MAX;
+            for (int z = world->depth - 1; z >= 0; z--) {
+                uint8_t* cell = light_cell(world, x, y, z);
+                if (!cell) break;
+
+                // Sky light straight down the column, block light at emitters
+                uint8_t type = world_get_block_fast(world, x, y, z);
+                if (pass->shift == WORLD_LIGHT_SKY_SHIFT) {
+                    level = max_int(light_transfer(pass, level, type, 1), 0);
+                    *cell = (uint8_t)((*cell & ~(WORLD_LIGHT_MAX << pass->shift)) | (level << pass->shift));
+                }
+                else {
+                    *cell = (uint8_t)((*cell & ~WORLD_LIGHT_MAX) | world_block_emission(world, type));
+                }
+            }
+        }
+    }
+
+    // Spread from the box and the blocks around it, found by a rescan
+    pass->add.overflow = 1;
+    light_settle(pass, box);
+}
+
+void world_light_rebuild(World* world) {
+    if (!world) return;
+
+    WorldEdit box = { 0, 0, 0, world->width - 1, world->height - 1, world->depth - 1 };
+    for (int shift = 0; shift <= WORLD_LIGHT_SKY_SHIFT; shift += WORLD_LIGHT_SKY_SHIFT) {
+        LightPass pass;
+        light_pass_init(&pass, world, shift);
+        light_relight_columns(&pass, &box);
+    }
+}
+
+void world_light_refresh_box(World* world, WorldEdit* box) {
+    if (!world || !box) return;
+
+    // Light from the box reaches WORLD_LIGHT_MAX blocks sideways, and any
+    // distance down
+    WorldEdit columns = {
+        max_int(box->x0 - WORLD_LIGHT_MAX, 0), max_int(box->y0 - WORLD_LIGHT_MAX, 0), 0,
+        min_int(box->x1 + WORLD_LIGHT_MAX, world->width - 1),
+        min_int(box->y1 + WORLD_LIGHT_MAX, world->height - 1), world->depth - 1
+    };
+
+    for (int shift = 0; shift <= WORLD_LIGHT_SKY_SHIFT; shift += WORLD_LIGHT_SKY_SHIFT) {
+        LightPass pass;
+        light_pass_init(&pass, world, shift);
+        light_relight_columns(&pass, &columns);
+        if (pass.changed) light_box_union(box, &pass.box);
+    }
+
+    // Columns that were cleared may have come back the same; the blocks
+    // that changed are somewhere among them
+    light_box_union(box, &columns);
+}
+
+void world_light_update_block(World* world, int x, int y, int z, WorldEdit* box) {
+    if (!world || !box) return;
+
+    uint8_t* cell = light_cell(world, x, y, z);
+    if (!cell) return;
+    uint8_t type = world_get_block_fast(world, x, y, z);
+
+    for (int shift = 0; shift <= WORLD_LIGHT_SKY_SHIFT; shift += WORLD_LIGHT_SKY_SHIFT) {
+        LightPass pass;
+        light_pass_init(&pass, world, shift);
+
+        // Take the block's light away, with everything that came from it and
+        // the sky light the block may now shade, then let its own source and
+        // the surrounding light spread back in
+        int level = light_get(&pass, cell);
+        light_set(&pass, cell, x, y, z, 0);
+        light_push(&pass.remove, x, y, z, level);
+        if (!light_unspread(&pass)) {
+            world_light_refresh_box(world, box);
+            return;
+        }
+
+        int source = light_source(&pass, z, type);
+        if (source > light_get(&pass, cell)) {
+            light_set(&pass, cell, x, y, z, source);
+            light_push(&pass.add, x, y, z, source);
+        }
+
+        WorldEdit edit = { x, y, z, x, y, z };
+        light_settle(&pass, &edit);
+        light_box_union(box, &pass.box);
+    }
+}
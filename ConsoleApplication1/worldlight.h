@@ -0,0 +1,36 @@
+/**
+ * @file worldlight.h
+ * @brief Flood-filled sky and block light for every voxel
+ *
+ * Each block has a light byte beside it (see World.light): sky light in the
+ * high nibble and block light from emitters such as torches in the low one,
+ * both 0-15. Light loses one level per block it spreads into (more through
+ * absorbing blocks such as water) and never enters opaque blocks; full sky
+ * light falls straight down through clear blocks without losing any. The
+ * volume is built by a breadth-first flood fill and kept up to date on
+ * block edits by removing and re-spreading only the light the edit touched.
+ * Sky light is stored at full strength and scaled by the time of day when
+ * it is read, so day and night never re-propagate it.
+ */
+#ifndef WORLDLIGHT_H
+#define WORLDLIGHT_H
+
+#include "world.h"
+
+// Light of every absent chunk of a paged world: open sky. Light never
+// spreads into or out of absent chunks.
+extern uint8_t world_absent_light[CHUNK_VOLUME];
+
+// Flood fill the whole light volume from the blocks
+void world_light_rebuild(World* world);
+
+// Relight the columns of a box, and the columns WORLD_LIGHT_MAX around it
+// that its light reaches, after bulk writes inside it. The box grows to
+// cover every block whose light changed.
+void world_light_refresh_box(World* world, WorldEdit* box);
+
+// Update the light around one block after world_set_block_fast changed it.
+// The box grows to cover every block whose light changed.
+void world_light_update_block(World* world, int x, int y, int z, WorldEdit* box);
+
+#endif /* WORLDLIGHT_H */
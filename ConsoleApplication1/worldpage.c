@@ -0,0 +1,591 @@
+/**
+ * @file worldpage.c
+ * @brief On-demand chunk paging for worlds larger than memory
+ */
+#include "worldpage.h"
+#include "worldfile.h"
+#include "config.h"
+#include "thread.h"
+#include "utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Page life cycle. Only the main thread moves pages into or out of
+// PAGE_RESIDENT; every other transition happens under the pager lock.
+enum {
+    PAGE_ABSENT,             // Not in memory
+    PAGE_QUEUED,             // Waiting for the loader
+    PAGE_READY,              // Loaded, waiting to be attached by the main thread
+    PAGE_RESIDENT,           // Attached to the world
+    PAGE_WRITING             // Evicted dirty, storage owned by the loader until written
+};
+
+// One chunk column
+typedef struct {
+    uint8_t* storage;        // chunks_z chunks, or NULL
+    unsigned int last_used;  // Access clock at the last touch
+    uint8_t state;
+    uint8_t attached;        // PAGE_RESIDENT, readable without the lock (main thread only)
+    uint8_t dirty;           // Modified since it was loaded or flushed
+    uint8_t in_queue;        // Has an entry in the load queue (possibly stale)
+    uint8_t reload;          // Requested again while being written
+    uint8_t failed;          // The last load failed
+    uint8_t failures;        // Loads failed in a row
+    unsigned int retry_frame; // Paging frame before which a failed load is not retried
+} WorldPage;
+
+// Paging state
+struct WorldPager {
+    World* world;
+    unsigned int seed;
+    char* path;              // Backing file name (NULL = temporary file)
+    FILE* file;
+    WorldFileStore store;
+    Mutex store_lock;        // Serializes backing file access
+
+    size_t page_bytes;       // A column of chunks, then as much room for their light
+    int page_count;
+    int max_resident;        // Pages that fit in the memory budget
+    WorldPage* pages;
+
+    // Main thread only
+    int* resident;           // Resident page indices
+    int resident_count;
+    int* installing;         // Scratch list for attaching ready pages
+    unsigned int clock;      // Incremented on every page touch
+    unsigned int frame_start; // Clock when the current frame's update began
+    int deferred;            // world_pager_require only requests pages
+
+    // Protected by lock
+    Mutex lock;
+    unsigned int frame;      // Incremented by every world_update_paging
+    CondVar work;            // Signalled when the loader has something to do
+    CondVar changed;         // Broadcast when a page changes state
+    int* load_queue;         // Ring of pages to load
+    int load_head;
+    int load_count;
+    int urgent;              // Page the main thread is blocked on (-1 = none)
+    int* write_queue;        // Ring of pages to write back
+    int write_head;
+    int write_count;
+    int* ready;              // Pages in PAGE_READY
+    int ready_count;
+    int writing;             // A writeback is in progress
+    int shutdown;
+
+    Thread thread;
+    int thread_started;
+};
+
+// Ring helpers (capacity page_count; a page is in each ring at most once)
+static void ring_push(int* ring, int capacity, int head, int* count, int page) {
+    ring[(head + *count) % capacity] = page;
+    (*count)++;
+}
+
+static int ring_pop(int* ring, int capacity, int* head, int* count) {
+    int page = ring[*head];
+    *head = (*head + 1) % capacity;
+    (*count)--;
+    return page;
+}
+
+// Index of the first chunk of a page's column at height cz
+static int world_pager_chunk(const World* world, int page, int cz) {
+    return cz * world->chunks_x * world->chunks_y + page;
+}
+
+// Produce a page: read it from the backing store, or generate it
+static uint8_t* world_pager_load_page(WorldPager* pager, int page) {
+    World* world = pager->world;
+    uint8_t* storage = (uint8_t*)calloc(pager->page_bytes, 1);
+    if (!storage) return NULL;
+
+    int stored = 0;
+    int ok = 1;
+    mutex_lock(&pager->store_lock);
+    for (int cz = 0; cz < world->chunks_z; cz++) {
+        int chunk = world_pager_chunk(world, page, cz);
+        if (worldfile_store_has_chunk(&pager->store, chunk)) {
+            stored = 1;
+            ok &= worldfile_store_read_chunk(&pager->store, chunk, storage + (size_t)cz * CHUNK_VOLUME);
+        }
+    }
+    mutex_unlock(&pager->store_lock);
+
+    if (!ok) {
+        log_message(LOG_ERROR, "world page %d: backing store read failed", page);
+        free(storage);
+        return NULL;
+    }
+
+    if (!stored) {
+        world_generate_chunk_column(world, pager->seed, page % world->chunks_x, page / world->chunks_x, storage);
+    }
+    return storage;
+}
+
+// Write a page to the backing store
+static int world_pager_write_page(WorldPager* pager, int page, const uint8_t* storage) {
+    World* world = pager->world;
+    int ok = 1;
+
+    mutex_lock(&pager->store_lock);
+    for (int cz = 0; cz < world->chunks_z; cz++) {
+        ok &= worldfile_store_write_chunk(&pager->store, world_pager_chunk(world, page, cz),
+            storage + (size_t)cz * CHUNK_VOLUME);
+    }
+    mutex_unlock(&pager->store_lock);
+
+    if (!ok) {
+        log_message(LOG_ERROR, "world page %d: backing store write failed", page);
+    }
+    return ok;
+}
+
+// Loader thread: urgent loads first, then writebacks, then queued loads
+static void world_pager_thread(void* arg) {
+    WorldPager* pager = (WorldPager*)arg;
+
+    mutex_lock(&pager->lock);
+    while (1) {
+        while (!pager->shutdown && pager->urgent < 0 && pager->write_count == 0 && pager->load_count == 0) {
+            condvar_wait(&pager->work, &pager->lock);
+        }
+
+        int page;
+        if (pager->write_count > 0 && (pager->urgent < 0 || pager->shutdown)) {
+            // Write back an evicted page, then release it
+            page = ring_pop(pager->write_queue, pager->page_count, &pager->write_head, &pager->write_count);
+            WorldPage* p = &pager->pages[page];
+            uint8_t* storage = p->storage;
+            pager->writing = 1;
+            mutex_unlock(&pager->lock);
+
+            world_pager_write_page(pager, page, storage);
+            free(storage);
+
+            mutex_lock(&pager->lock);
+            pager->writing = 0;
+            p->storage = NULL;
+            p->dirty = 0;
+            p->state = PAGE_ABSENT;
+            if (p->reload) {
+                p->reload = 0;
+                p->state = PAGE_QUEUED;
+                if (!p->in_queue) {
+                    p->in_queue = 1;
+                    ring_push(pager->load_queue, pager->page_count, pager->load_head, &pager->load_count, page);
+                }
+            }
+            condvar_broadcast(&pager->changed);
+            continue;
+        }
+
+        if (pager->shutdown) break;
+
+        if (pager->urgent >= 0) {
+            page = pager->urgent;
+            pager->urgent = -1;
+        }
+        else {
+            page = ring_pop(pager->load_queue, pager->page_count, &pager->load_head, &pager->load_count);
+            pager->pages[page].in_queue = 0;
+        }
+
+        // Stale queue entry (the page was loaded another way)
+        WorldPage* p = &pager->pages[page];
+        if (p->state != PAGE_QUEUED) continue;
+
+        mutex_unlock(&pager->lock);
+        uint8_t* storage = world_pager_load_page(pager, page);
+        mutex_lock(&pager->lock);
+
+        if (storage) {
+            p->storage = storage;
+            p->state = PAGE_READY;
+            p->failures = 0;
+            pager->ready[pager->ready_count++] = page;
+        }
+        else {
+            // Back off before loading it again, longer after each failure
+            p->state = PAGE_ABSENT;
+            p->failed = 1;
+            p->retry_frame = pager->frame + (WORLD_PAGE_RETRY_FRAMES << min_int(p->failures, 8));
+            if (p->failures < 255) p->failures++;
+        }
+        condvar_broadcast(&pager->changed);
+    }
+    mutex_unlock(&pager->lock);
+}
+
+// Attach every page the loader finished (main thread)
+static void world_pager_install_ready(WorldPager* pager) {
+    mutex_lock(&pager->lock);
+    int count = pager->ready_count;
+    for (int i = 0; i < count; i++) {
+        int page = pager->ready[i];
+        pager->installing[i] = page;
+        pager->pages[page].state = PAGE_RESIDENT;
+        pager->pages[page].last_used = ++pager->clock;
+    }
+    pager->ready_count = 0;
+    mutex_unlock(&pager->lock);
+
+    World* world = pager->world;
+    for (int i = 0; i < count; i++) {
+        int page = pager->installing[i];
+        world_attach_chunk_column(world, page % world->chunks_x, page / world->chunks_x, pager->pages[page].storage);
+        pager->pages[page].attached = 1;
+        pager->resident[pager->resident_count++] = page;
+    }
+}
+
+// Detach a resident page; dirty pages go to the writeback queue (main thread)
+static void world_pager_evict(WorldPager* pager, int resident_index) {
+    World* world = pager->world;
+    int page = pager->resident[resident_index];
+    WorldPage* p = &pager->pages[page];
+
+    pager->resident[resident_index] = pager->resident[--pager->resident_count];
+    p->attached = 0;
+    world_attach_chunk_column(world, page % world->chunks_x, page / world->chunks_x, NULL);
+
+    mutex_lock(&pager->lock);
+    if (p->dirty) {
+        p->state = PAGE_WRITING;
+        ring_push(pager->write_queue, pager->page_count, pager->write_head, &pager->write_count, page);
+        condvar_signal(&pager->work);
+    }
+    else {
+        free(p->storage);
+        p->storage = NULL;
+        p->state = PAGE_ABSENT;
+    }
+    mutex_unlock(&pager->lock);
+}
+
+// Evict least recently used pages until the budget holds. Pages touched
+// after 'keep_from', and the page 'keep', stay.
+static void world_pager_trim(WorldPager* pager, unsigned int keep_from, int keep) {
+    while (pager->resident_count > pager->max_resident) {
+        int oldest = -1;
+        for (int i = 0; i < pager->resident_count; i++) {
+            int page = pager->resident[i];
+            unsigned int used = pager->pages[page].last_used;
+            if (page != keep && used <= keep_from &&
+                (oldest < 0 || used < pager->pages[pager->resident[oldest]].last_used)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) break;
+        world_pager_evict(pager, oldest);
+    }
+}
+
+// Whether a page's last load failed too recently to retry; the caller
+// holds the lock
+static int world_pager_backing_off(const WorldPager* pager, const WorldPage* p) {
+    return p->failures > 0 && (int)(p->retry_frame - pager->frame) > 0;
+}
+
+// Queue a page for loading; the caller holds the lock
+static void world_pager_request(WorldPager* pager, int page) {
+    WorldPage* p = &pager->pages[page];
+
+    if (p->state == PAGE_ABSENT) {
+        if (world_pager_backing_off(pager, p)) return;
+
+        p->state = PAGE_QUEUED;
+        if (!p->in_queue) {
+            p->in_queue = 1;
+            ring_push(pager->load_queue, pager->page_count, pager->load_head, &pager->load_count, page);
+        }
+        condvar_signal(&pager->work);
+    }
+    else if (p->state == PAGE_WRITING) {
+        p->reload = 1;
+    }
+}
+
+// Make a page resident, waiting for the loader if necessary (main thread)
+int world_pager_require(World* world, int cx, int cy, int write) {
+    WorldPager* pager = world->pager;
+    int page = cy * world->chunks_x + cx;
+    WorldPage* p = &pager->pages[page];
+
+    if (!p->attached) {
+        mutex_lock(&pager->lock);
+
+        // Leave installing the page to world_update_paging
+        if (pager->deferred) {
+            world_pager_request(pager, page);
+            mutex_unlock(&pager->lock);
+            return 0;
+        }
+
+        if (p->state == PAGE_ABSENT && world_pager_backing_off(pager, p)) {
+            mutex_unlock(&pager->lock);
+            return 0;
+        }
+
+        p->failed = 0;
+        while (p->state != PAGE_READY && p->state != PAGE_RESIDENT) {
+            world_pager_request(pager, page);
+            if (p->state == PAGE_QUEUED) {
+                pager->urgent = page;
+                condvar_signal(&pager->work);
+            }
+
+            condvar_wait(&pager->changed, &pager->lock);
+            if (p->failed) {
+                mutex_unlock(&pager->lock);
+                return 0;
+            }
+        }
+        mutex_unlock(&pager->lock);
+
+        world_pager_install_ready(pager);
+        p->last_used = ++pager->clock;
+        world_pager_trim(pager, pager->clock, page);
+    }
+
+    p->last_used = ++pager->clock;
+    if (write) p->dirty = 1;
+    return 1;
+}
+
+// Per-frame paging work
+void world_update_paging(World* world, float x, float y, float radius) {
+    if (!world || !world->pager) return;
+
+    WorldPager* pager = world->pager;
+    pager->frame_start = pager->clock;
+    world_pager_install_ready(pager);
+
+    // Request pages within radius, nearest rings first, up to the budget
+    int center_x = (int)floorf(x) >> CHUNK_SHIFT;
+    int center_y = (int)floorf(y) >> CHUNK_SHIFT;
+    int rings = (int)(radius / CHUNK_SIZE) + 1;
+    int wanted = 0;
+
+    mutex_lock(&pager->lock);
+    pager->frame++;
+    for (int d = 0; d <= rings && wanted < pager->max_resident; d++) {
+        for (int cy = center_y - d; cy <= center_y + d; cy++) {
+            for (int cx = center_x - d; cx <= center_x + d; cx++) {
+                if (abs(cx - center_x) != d && abs(cy - center_y) != d) continue;
+                if (cx < 0 || cy < 0 || cx >= world->chunks_x || cy >= world->chunks_y) continue;
+                if (wanted >= pager->max_resident) continue;
+
+                // Distance from (x, y) to the page's footprint
+                float dx = fmaxf(fmaxf(cx * (float)CHUNK_SIZE - x, x - (cx + 1) * (float)CHUNK_SIZE), 0.0f);
+                float dy = fmaxf(fmaxf(cy * (float)CHUNK_SIZE - y, y - (cy + 1) * (float)CHUNK_SIZE), 0.0f);
+                if (dx * dx + dy * dy > radius * radius) continue;
+
+                int page = cy * world->chunks_x + cx;
+                wanted++;
+                if (pager->pages[page].state == PAGE_RESIDENT) {
+                    pager->pages[page].last_used = ++pager->clock;
+                }
+                else {
+                    world_pager_request(pager, page);
+                }
+            }
+        }
+    }
+    mutex_unlock(&pager->lock);
+
+    // Evict least recently used pages; pages wanted this frame stay
+    world_pager_trim(pager, pager->frame_start, -1);
+}
+
+// Defer page installs and evictions to world_update_paging
+void world_set_paging_deferred(World* world, int deferred) {
+    if (world && world->pager) world->pager->deferred = deferred;
+}
+
+// Write all dirty pages and wait for queued writebacks
+int world_flush_pages(World* world) {
+    if (!world || !world->pager) return 1;
+
+    WorldPager* pager = world->pager;
+    int ok = 1;
+
+    // Resident pages are only modified on this thread, so write them directly
+    for (int i = 0; i < pager->resident_count; i++) {
+        WorldPage* p = &pager->pages[pager->resident[i]];
+        if (p->dirty && world_pager_write_page(pager, pager->resident[i], p->storage)) {
+            p->dirty = 0;
+        }
+        ok &= !p->dirty;
+    }
+
+    mutex_lock(&pager->lock);
+    while (pager->write_count > 0 || pager->writing) {
+        condvar_wait(&pager->changed, &pager->lock);
+    }
+    mutex_unlock(&pager->lock);
+
+    mutex_lock(&pager->store_lock);
+    ok &= fflush(pager->file) == 0;
+    mutex_unlock(&pager->store_lock);
+    return ok;
+}
+
+// Number of resident pages
+int world_resident_pages(World* world) {
+    return world && world->pager ? world->pager->resident_count : 0;
+}
+
+// Save a paged world: flush, then copy the backing file unless it is the target
+int world_pager_save(World* world, const char* filename) {
+    WorldPager* pager = world->pager;
+    int ok = world_flush_pages(world);
+
+    if (pager->path && strcmp(pager->path, filename) == 0) {
+        return ok;
+    }
+
+    FILE* out = fopen(filename, "wb");
+    if (!out) return 0;
+
+    char buffer[65536];
+    mutex_lock(&pager->store_lock);
+    ok &= fseek(pager->file, 0, SEEK_SET) == 0;
+    size_t length;
+    while (ok && (length = fread(buffer, 1, sizeof(buffer), pager->file)) > 0) {
+        ok = fwrite(buffer, 1, length, out) == length;
+    }
+    mutex_unlock(&pager->store_lock);
+
+    if (fclose(out) != 0) ok = 0;
+    return ok;
+}
+
+// Release pager state (the loader thread must not be running)
+static void world_pager_free(WorldPager* pager) {
+    if (!pager) return;
+
+    if (pager->pages) {
+        for (int i = 0; i < pager->page_count; i++) {
+            free(pager->pages[i].storage);
+        }
+    }
+
+    worldfile_store_close(&pager->store);
+    if (pager->file) fclose(pager->file);
+
+    condvar_destroy(&pager->changed);
+    condvar_destroy(&pager->work);
+    mutex_destroy(&pager->lock);
+    mutex_destroy(&pager->store_lock);
+
+    free(pager->ready);
+    free(pager->write_queue);
+    free(pager->load_queue);
+    free(pager->installing);
+    free(pager->resident);
+    free(pager->pages);
+    free(pager->path);
+    free(pager);
+}
+
+// Write back, stop the loader and free every page
+void world_pager_destroy(World* world) {
+    WorldPager* pager = world->pager;
+
+    world_flush_pages(world);
+
+    mutex_lock(&pager->lock);
+    pager->shutdown = 1;
+    condvar_broadcast(&pager->work);
+    mutex_unlock(&pager->lock);
+    if (pager->thread_started) thread_join(pager->thread);
+
+    world_pager_free(pager);
+    world->pager = NULL;
+}
+
+// Create a paged world
+World* world_create_paged(int width, int height, int depth, unsigned int seed,
+                          const char* filename, size_t memory_budget) {
+    WorldFileStore store = { 0 };
+    FILE* file = NULL;
+    int existing = 0;
+
+    // An existing file decides the dimensions
+    if (filename) {
+        file = fopen(filename, "r+b");
+        if (file) {
+            if (!worldfile_store_open(&store, file, &width, &height, &depth)) {
+                fclose(file);
+                return NULL;
+            }
+            existing = 1;
+        }
+        else {
+            file = fopen(filename, "w+b");
+        }
+    }
+    else {
+        file = tmpfile();
+    }
+    if (!file) return NULL;
+
+    World* world = world_create_sparse(width, height, depth);
+    if (!world || (existing && store.chunk_count != world->chunk_count) ||
+        (!existing && !worldfile_store_create(&store, file, world))) {
+        worldfile_store_close(&store);
+        fclose(file);
+        world_destroy(world);
+        return NULL;
+    }
+
+    WorldPager* pager = (WorldPager*)calloc(1, sizeof(WorldPager));
+    if (!pager) {
+        worldfile_store_close(&store);
+        fclose(file);
+        world_destroy(world);
+        return NULL;
+    }
+
+    mutex_init(&pager->store_lock);
+    mutex_init(&pager->lock);
+    condvar_init(&pager->work);
+    condvar_init(&pager->changed);
+
+    size_t budget = memory_budget > 0 ? memory_budget : (size_t)WORLD_PAGE_BUDGET_MB * 1024 * 1024;
+    pager->world = world;
+    pager->seed = seed;
+    pager->path = filename ? str_duplicate(filename) : NULL;
+    pager->file = file;
+    pager->store = store;
+    pager->page_bytes = 2 * (size_t)world->chunks_z * CHUNK_VOLUME;
+    pager->page_count = world->chunks_x * world->chunks_y;
+    size_t fit = budget / pager->page_bytes;
+    pager->max_resident = fit < (size_t)pager->page_count ? (int)fit : pager->page_count;
+    if (pager->max_resident < 1) pager->max_resident = 1;
+    pager->urgent = -1;
+
+    pager->pages = (WorldPage*)calloc(pager->page_count, sizeof(WorldPage));
+    pager->resident = (int*)malloc(pager->page_count * sizeof(int));
+    pager->installing = (int*)malloc(pager->page_count * sizeof(int));
+    pager->load_queue = (int*)malloc(pager->page_count * sizeof(int));
+    pager->write_queue = (int*)malloc(pager->page_count * sizeof(int));
+    pager->ready = (int*)malloc(pager->page_count * sizeof(int));
+    if (!pager->pages || !pager->resident || !pager->installing ||
+        !pager->load_queue || !pager->write_queue || !pager->ready ||
+        (filename && !pager->path) ||
+        !thread_create(&pager->thread, world_pager_thread, pager)) {
+        world_pager_free(pager);
+        world_destroy(world);
+        return NULL;
+    }
+    pager->thread_started = 1;
+
+    world->pager = pager;
+    return world;
+}
@@ -0,0 +1,48 @@
+/**
+ * @file worldpage.h
+ * @brief On-demand chunk paging for worlds larger than memory
+ *
+ * A paged world keeps only some chunk columns ("pages") resident. The rest
+ * point at a shared air chunk with no occupied bricks, so rays pass through
+ * them without blocking. A loader thread generates pages, or reads them from
+ * a chunked world file that doubles as the backing store, and writes dirty
+ * pages back after they are evicted. Pages are evicted least recently used
+ * first once the resident set exceeds the memory budget.
+ */
+#ifndef WORLDPAGE_H
+#define WORLDPAGE_H
+
+#include "world.h"
+#include <stddef.h>
+
+// Create a paged world backed by filename. An existing chunked file supplies
+// the dimensions and any stored chunks; pages it lacks are generated from
+// seed (terrain and trees; structures need the whole world). A NULL
+// filename backs the world with a temporary file. memory_budget is in bytes
+// (0 = WORLD_PAGE_BUDGET_MB).
+World* world_create_paged(int width, int height, int depth, unsigned int seed,
+                          const char* filename, size_t memory_budget);
+
+// Once per frame from the main thread: install pages the loader finished,
+// request pages within radius of (x, y), nearest first, and evict over budget.
+// Does nothing for a fully resident world.
+void world_update_paging(World* world, float x, float y, float radius);
+
+// While deferred, world_pager_require never waits, attaches or evicts: a
+// page that is not resident is requested and the read fails, and the next
+// world_update_paging installs it. Lets one thread read the world while
+// another draws it.
+void world_set_paging_deferred(World* world, int deferred);
+
+// Write every dirty page to the backing store and wait for pending writes
+int world_flush_pages(World* world);
+
+// Number of resident pages
+int world_resident_pages(World* world);
+
+// Internal hooks used by world.c
+int world_pager_require(World* world, int cx, int cy, int write);
+int world_pager_save(World* world, const char* filename);
+void world_pager_destroy(World* world);
+
+#endif /* WORLDPAGE_H */